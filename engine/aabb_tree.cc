@@ -0,0 +1,334 @@
+#include "aabb_tree.h"
+#include <glm.hpp>
+
+namespace Engine
+{
+	bool AabbTree::Node::IsLeaf() const
+	{
+		return child1 == nullNode;
+	}
+
+	AabbTree::AabbTree() :
+		root(nullNode),
+		freeList(nullNode),
+		aabbMargin(0.2f),
+		displacementMultiplier(4.f)
+	{}
+
+	int32_t AabbTree::AllocateNode()
+	{
+		if (freeList == nullNode)
+		{
+			nodes.push_back(Node());
+			freeList = int32_t(nodes.size()) - 1;
+			nodes[freeList].parent = nullNode;
+		}
+
+		int32_t nodeId = freeList;
+		Node& node = nodes[nodeId];
+		freeList = node.parent;
+
+		node.parent = nullNode;
+		node.child1 = nullNode;
+		node.child2 = nullNode;
+		node.height = 0;
+		node.userId = 0;
+
+		return nodeId;
+	}
+
+	void AabbTree::FreeNode(int32_t nodeId)
+	{
+		nodes[nodeId].parent = freeList;
+		nodes[nodeId].height = -1;
+		freeList = nodeId;
+	}
+
+	void AabbTree::InsertLeaf(int32_t leafId)
+	{
+		if (root == nullNode)
+		{
+			root = leafId;
+			nodes[root].parent = nullNode;
+			return;
+		}
+
+		// find the best sibling by descending along the cheapest surface area increase
+		AABB leafAabb = nodes[leafId].aabb;
+		int32_t index = root;
+
+		while (!nodes[index].IsLeaf())
+		{
+			int32_t child1 = nodes[index].child1;
+			int32_t child2 = nodes[index].child2;
+
+			float area = AabbSurfaceArea(nodes[index].aabb);
+			float combinedArea = AabbSurfaceArea(AabbUnion(nodes[index].aabb, leafAabb));
+
+			// cost of creating a new parent for this node and the new leaf
+			float cost = 2.f * combinedArea;
+
+			// minimum cost of pushing the leaf further down the tree
+			float inheritanceCost = 2.f * (combinedArea - area);
+
+			float cost1 = AabbSurfaceArea(AabbUnion(leafAabb, nodes[child1].aabb)) + inheritanceCost;
+			if (!nodes[child1].IsLeaf())
+				cost1 -= AabbSurfaceArea(nodes[child1].aabb);
+
+			float cost2 = AabbSurfaceArea(AabbUnion(leafAabb, nodes[child2].aabb)) + inheritanceCost;
+			if (!nodes[child2].IsLeaf())
+				cost2 -= AabbSurfaceArea(nodes[child2].aabb);
+
+			if (cost < cost1 && cost < cost2)
+				break;
+
+			index = (cost1 < cost2) ? child1 : child2;
+		}
+
+		int32_t sibling = index;
+		int32_t oldParent = nodes[sibling].parent;
+		int32_t newParent = AllocateNode();
+
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].aabb = AabbUnion(leafAabb, nodes[sibling].aabb);
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].child1 = sibling;
+		nodes[newParent].child2 = leafId;
+
+		if (oldParent != nullNode)
+		{
+			if (nodes[oldParent].child1 == sibling)
+				nodes[oldParent].child1 = newParent;
+			else
+				nodes[oldParent].child2 = newParent;
+		}
+		else
+			root = newParent;
+
+		nodes[sibling].parent = newParent;
+		nodes[leafId].parent = newParent;
+
+		RefitAncestors(newParent);
+	}
+
+	void AabbTree::RemoveLeaf(int32_t leafId)
+	{
+		if (leafId == root)
+		{
+			root = nullNode;
+			return;
+		}
+
+		int32_t parent = nodes[leafId].parent;
+		int32_t grandParent = nodes[parent].parent;
+		int32_t sibling = (nodes[parent].child1 == leafId) ? nodes[parent].child2 : nodes[parent].child1;
+
+		// the sibling takes the place of the parent
+		if (grandParent != nullNode)
+		{
+			if (nodes[grandParent].child1 == parent)
+				nodes[grandParent].child1 = sibling;
+			else
+				nodes[grandParent].child2 = sibling;
+
+			nodes[sibling].parent = grandParent;
+			FreeNode(parent);
+			RefitAncestors(grandParent);
+		}
+		else
+		{
+			root = sibling;
+			nodes[sibling].parent = nullNode;
+			FreeNode(parent);
+		}
+	}
+
+	void AabbTree::RefitAncestors(int32_t nodeId)
+	{
+		while (nodeId != nullNode)
+		{
+			nodeId = Balance(nodeId);
+
+			Node& node = nodes[nodeId];
+			const Node& child1 = nodes[node.child1];
+			const Node& child2 = nodes[node.child2];
+
+			node.height = 1 + glm::max(child1.height, child2.height);
+			node.aabb = AabbUnion(child1.aabb, child2.aabb);
+
+			nodeId = node.parent;
+		}
+	}
+
+	int32_t AabbTree::Balance(int32_t nodeIdA)
+	{
+		// rotates the taller grandchild up if node A is unbalanced, returns the new root of the subtree
+		Node& a = nodes[nodeIdA];
+		if (a.IsLeaf() || a.height < 2)
+			return nodeIdA;
+
+		int32_t nodeIdB = a.child1;
+		int32_t nodeIdC = a.child2;
+		Node& b = nodes[nodeIdB];
+		Node& c = nodes[nodeIdC];
+
+		int32_t balance = c.height - b.height;
+
+		if (balance > 1)
+		{
+			// rotate c up
+			int32_t nodeIdF = c.child1;
+			int32_t nodeIdG = c.child2;
+			Node& f = nodes[nodeIdF];
+			Node& g = nodes[nodeIdG];
+
+			c.child1 = nodeIdA;
+			c.parent = a.parent;
+			a.parent = nodeIdC;
+
+			if (c.parent != nullNode)
+			{
+				if (nodes[c.parent].child1 == nodeIdA)
+					nodes[c.parent].child1 = nodeIdC;
+				else
+					nodes[c.parent].child2 = nodeIdC;
+			}
+			else
+				root = nodeIdC;
+
+			if (f.height > g.height)
+			{
+				c.child2 = nodeIdF;
+				a.child2 = nodeIdG;
+				g.parent = nodeIdA;
+				a.aabb = AabbUnion(b.aabb, g.aabb);
+				c.aabb = AabbUnion(a.aabb, f.aabb);
+				a.height = 1 + glm::max(b.height, g.height);
+				c.height = 1 + glm::max(a.height, f.height);
+			}
+			else
+			{
+				c.child2 = nodeIdG;
+				a.child2 = nodeIdF;
+				f.parent = nodeIdA;
+				a.aabb = AabbUnion(b.aabb, f.aabb);
+				c.aabb = AabbUnion(a.aabb, g.aabb);
+				a.height = 1 + glm::max(b.height, f.height);
+				c.height = 1 + glm::max(a.height, g.height);
+			}
+
+			return nodeIdC;
+		}
+
+		if (balance < -1)
+		{
+			// rotate b up
+			int32_t nodeIdD = b.child1;
+			int32_t nodeIdE = b.child2;
+			Node& d = nodes[nodeIdD];
+			Node& e = nodes[nodeIdE];
+
+			b.child1 = nodeIdA;
+			b.parent = a.parent;
+			a.parent = nodeIdB;
+
+			if (b.parent != nullNode)
+			{
+				if (nodes[b.parent].child1 == nodeIdA)
+					nodes[b.parent].child1 = nodeIdB;
+				else
+					nodes[b.parent].child2 = nodeIdB;
+			}
+			else
+				root = nodeIdB;
+
+			if (d.height > e.height)
+			{
+				b.child2 = nodeIdD;
+				a.child1 = nodeIdE;
+				e.parent = nodeIdA;
+				a.aabb = AabbUnion(c.aabb, e.aabb);
+				b.aabb = AabbUnion(a.aabb, d.aabb);
+				a.height = 1 + glm::max(c.height, e.height);
+				b.height = 1 + glm::max(a.height, d.height);
+			}
+			else
+			{
+				b.child2 = nodeIdE;
+				a.child1 = nodeIdD;
+				d.parent = nodeIdA;
+				a.aabb = AabbUnion(c.aabb, d.aabb);
+				b.aabb = AabbUnion(a.aabb, e.aabb);
+				a.height = 1 + glm::max(c.height, d.height);
+				b.height = 1 + glm::max(a.height, e.height);
+			}
+
+			return nodeIdB;
+		}
+
+		return nodeIdA;
+	}
+
+	int32_t AabbTree::CreateProxy(const AABB& aabb, uint32_t userId)
+	{
+		int32_t proxyId = AllocateNode();
+
+		nodes[proxyId].aabb.min = aabb.min - glm::vec3(aabbMargin);
+		nodes[proxyId].aabb.max = aabb.max + glm::vec3(aabbMargin);
+		nodes[proxyId].userId = userId;
+		InsertLeaf(proxyId);
+
+		return proxyId;
+	}
+
+	void AabbTree::DestroyProxy(int32_t proxyId)
+	{
+		RemoveLeaf(proxyId);
+		FreeNode(proxyId);
+	}
+
+	bool AabbTree::MoveProxy(int32_t proxyId, const AABB& aabb, const glm::vec3& displacement)
+	{
+		// predict the motion so the proxy can stay in its fat aabb for a few steps
+		AABB fatAabb;
+		fatAabb.min = aabb.min - glm::vec3(aabbMargin);
+		fatAabb.max = aabb.max + glm::vec3(aabbMargin);
+
+		glm::vec3 predicted = displacement * displacementMultiplier;
+		fatAabb.min += glm::min(predicted, glm::vec3(0.f));
+		fatAabb.max += glm::max(predicted, glm::vec3(0.f));
+
+		const AABB& treeAabb = nodes[proxyId].aabb;
+		if (AabbContains(treeAabb, aabb))
+		{
+			// also reinsert when the fat aabb has grown far larger than needed, e.g. after a fast throw
+			AABB largeAabb;
+			largeAabb.min = fatAabb.min - glm::vec3(4.f * aabbMargin);
+			largeAabb.max = fatAabb.max + glm::vec3(4.f * aabbMargin);
+
+			if (AabbContains(largeAabb, treeAabb))
+				return false;
+		}
+
+		RemoveLeaf(proxyId);
+		nodes[proxyId].aabb = fatAabb;
+		InsertLeaf(proxyId);
+
+		return true;
+	}
+
+	const AABB& AabbTree::GetFatAABB(int32_t proxyId) const
+	{
+		return nodes[proxyId].aabb;
+	}
+
+	uint32_t AabbTree::GetUserId(int32_t proxyId) const
+	{
+		return nodes[proxyId].userId;
+	}
+
+	int32_t AabbTree::GetHeight() const
+	{
+		return root == nullNode ? 0 : nodes[root].height;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+#include "collider.h"
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+namespace Engine
+{
+	// dynamic bounding volume hierarchy over enlarged ("fat") aabbs, a proxy only has to be
+	// reinserted when its tight aabb leaves the fat one, after which the path to the root is
+	// refitted and rotated to keep the tree balanced
+	class AabbTree final
+	{
+	private:
+		struct Node
+		{
+			AABB aabb;
+			int32_t parent;// next free node when the node is unused
+			int32_t child1;
+			int32_t child2;
+			int32_t height;// 0 for leaves, -1 for unused nodes
+			uint32_t userId;
+
+			bool IsLeaf() const;
+		};
+
+		std::vector<Node> nodes;
+		int32_t root;
+		int32_t freeList;
+
+		int32_t AllocateNode();
+		void FreeNode(int32_t nodeId);
+		void InsertLeaf(int32_t leafId);
+		void RemoveLeaf(int32_t leafId);
+		void RefitAncestors(int32_t nodeId);
+		int32_t Balance(int32_t nodeId);
+
+	public:
+		static constexpr int32_t nullNode = -1;
+		static constexpr size_t maxTraversalDepth = 256;// the tree is kept balanced so this is never reached
+
+		float aabbMargin;
+		float displacementMultiplier;
+
+		AabbTree();
+
+		int32_t CreateProxy(const AABB& aabb, uint32_t userId);
+		void DestroyProxy(int32_t proxyId);
+		bool MoveProxy(int32_t proxyId, const AABB& aabb, const glm::vec3& displacement);
+
+		const AABB& GetFatAABB(int32_t proxyId) const;
+		uint32_t GetUserId(int32_t proxyId) const;
+		int32_t GetHeight() const;
+
+		// calls callback(userId) for every proxy whose fat aabb overlaps the given aabb
+		template<typename CALLBACK>
+		void Query(const AABB& aabb, CALLBACK callback) const;
+
+		// calls callback(userId, maxDistance) for every proxy whose fat aabb the ray enters before maxDistance,
+		// the callback returns the new max distance which is used to prune the rest of the traversal
+		template<typename CALLBACK>
+		void Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, CALLBACK callback) const;
+
+		// same for an aabb moving along the direction, the ray from its center is tested against the fat aabbs
+		// grown by its half extent
+		template<typename CALLBACK>
+		void Sweep(const AABB& aabb, const glm::vec3& direction, float maxDistance, CALLBACK callback) const;
+	};
+
+	template<typename CALLBACK>
+	void AabbTree::Query(const AABB& aabb, CALLBACK callback) const
+	{
+		if (root == nullNode)
+			return;
+
+		int32_t stack[maxTraversalDepth];
+		size_t stackSize = 0;
+		stack[stackSize++] = root;
+
+		while (stackSize > 0)
+		{
+			int32_t nodeId = stack[--stackSize];
+
+			const Node& node = nodes[nodeId];
+			if (!AabbOverlaps(node.aabb, aabb))
+				continue;
+
+			if (node.IsLeaf())
+				callback(node.userId);
+			else
+			{
+				assert(stackSize + 2 <= maxTraversalDepth);
+				stack[stackSize++] = node.child1;
+				stack[stackSize++] = node.child2;
+			}
+		}
+	}
+
+	template<typename CALLBACK>
+	void AabbTree::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, CALLBACK callback) const
+	{
+		if (root == nullNode)
+			return;
+
+		glm::vec3 inverseDirection = 1.f / direction;
+
+		int32_t stack[maxTraversalDepth];
+		size_t stackSize = 0;
+		stack[stackSize++] = root;
+
+		while (stackSize > 0)
+		{
+			int32_t nodeId = stack[--stackSize];
+
+			const Node& node = nodes[nodeId];
+			if (!RayIntersectsAabb(origin, inverseDirection, node.aabb, maxDistance))
+				continue;
+
+			if (node.IsLeaf())
+				maxDistance = callback(node.userId, maxDistance);
+			else
+			{
+				assert(stackSize + 2 <= maxTraversalDepth);
+				stack[stackSize++] = node.child1;
+				stack[stackSize++] = node.child2;
+			}
+		}
+	}
+
+	template<typename CALLBACK>
+	void AabbTree::Sweep(const AABB& aabb, const glm::vec3& direction, float maxDistance, CALLBACK callback) const
+	{
+		if (root == nullNode)
+			return;
+
+		glm::vec3 center = 0.5f * (aabb.min + aabb.max);
+		glm::vec3 halfExtent = 0.5f * (aabb.max - aabb.min);
+		glm::vec3 inverseDirection = 1.f / direction;
+
+		int32_t stack[maxTraversalDepth];
+		size_t stackSize = 0;
+		stack[stackSize++] = root;
+
+		while (stackSize > 0)
+		{
+			int32_t nodeId = stack[--stackSize];
+
+			const Node& node = nodes[nodeId];
+			AABB grown;
+			grown.min = node.aabb.min - halfExtent;
+			grown.max = node.aabb.max + halfExtent;
+
+			if (!RayIntersectsAabb(center, inverseDirection, grown, maxDistance))
+				continue;
+
+			if (node.IsLeaf())
+				maxDistance = callback(node.userId, maxDistance);
+			else
+			{
+				assert(stackSize + 2 <= maxTraversalDepth);
+				stack[stackSize++] = node.child1;
+				stack[stackSize++] = node.child2;
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -9,19 +9,93 @@ namespace Engine
 		max(-std::numeric_limits<float>::max())
 	{}
 
-	Collider::Collider() :
+	bool AabbOverlaps(const AABB& a, const AABB& b)
+	{
+		return
+			a.min.x <= b.max.x && a.max.x >= b.min.x &&
+			a.min.y <= b.max.y && a.max.y >= b.min.y &&
+			a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	bool AabbContains(const AABB& outer, const AABB& inner)
+	{
+		return
+			outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+			outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+	}
+
+	AABB AabbUnion(const AABB& a, const AABB& b)
+	{
+		AABB result;
+		result.min = glm::min(a.min, b.min);
+		result.max = glm::max(a.max, b.max);
+		return result;
+	}
+
+	float AabbSurfaceArea(const AABB& aabb)
+	{
+		glm::vec3 size = aabb.max - aabb.min;
+		return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	bool RayIntersectsAabb(const glm::vec3& origin, const glm::vec3& inverseDirection, const AABB& aabb, float maxDistance)
+	{
+		// slab test
+		glm::vec3 t1 = (aabb.min - origin) * inverseDirection;
+		glm::vec3 t2 = (aabb.max - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t1, t2);
+		glm::vec3 tFar = glm::max(t1, t2);
+
+		float tEnter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.f));
+		float tExit = glm::min(glm::min(tFar.x, tFar.y), tFar.z);
+
+		return tEnter <= tExit && tEnter <= maxDistance;
+	}
+
+	Collider::Collider(ColliderType _type) :
+		type(_type),
 		localMatrix(1.f),
 		worldMatrix(1.f)
 	{}
 
+	ColliderType Collider::GetType() const
+	{
+		return type;
+	}
+
+	size_t Collider::ContactsWithSDF(const SDF& otherSDF, HitResult* p_outHitResults, size_t maxHitCount, size_t* p_outEvaluationCount) const
+	{
+		if (maxHitCount == 0)
+		{
+			if (p_outEvaluationCount != nullptr)
+				*p_outEvaluationCount = 0;
+
+			return 0;
+		}
+
+		return IntersectsSDF(otherSDF, p_outHitResults[0], p_outEvaluationCount) ? 1 : 0;
+	}
+
 	SphereCollider::SphereCollider() :
+		Collider(ColliderType::E_Sphere),
 		radius(1.f)
+	{}
+
+	float SphereCollider::Distance(const glm::vec3& p) const
 	{
-		sdf = [this](const glm::vec3& p)
-		{
-			glm::vec3 position = this->worldMatrix[3];
-			return glm::distance(p, position) - this->radius;
-		};
+		glm::vec3 position = this->worldMatrix[3];
+		return glm::distance(p, position) - this->radius;
+	}
+
+	Dual SphereCollider::DualDistance(const DualVec3& p) const
+	{
+		glm::vec3 position = this->worldMatrix[3];
+		return Length(p - position) - this->radius;
+	}
+
+	SDF SphereCollider::GetSDF() const
+	{
+		return SDF::Bind<SphereCollider, &SphereCollider::Distance, &SphereCollider::DualDistance>(*this);
 	}
 
 	void SphereCollider::UpdateWorldAABB()
@@ -31,11 +105,14 @@ namespace Engine
 		worldAABB.max = position + glm::vec3(radius);
 	}
 
-	bool SphereCollider::IntersectsSDF(const SDF& otherSDF, HitResult& outHitReslut) const
+	bool SphereCollider::IntersectsSDF(const SDF& otherSDF, HitResult& outHitReslut, size_t* p_outEvaluationCount) const
 	{
 		glm::vec3 position = worldMatrix[3];
 		float dist = otherSDF(position);
 
+		if (p_outEvaluationCount != nullptr)
+			*p_outEvaluationCount = dist > radius ? 1 : 1 + NormalEvaluationCount(otherSDF);
+
 		if (dist > radius)
 			return false;
 
@@ -70,79 +147,197 @@ namespace Engine
 		return true;
 	}
 
+	float SphereCollider::BoundingRadius() const
+	{
+		return radius;
+	}
+
+	float SphereCollider::DistanceToSDF(const SDF& otherSDF, glm::vec3& outClosestPoint, float) const
+	{
+		outClosestPoint = worldMatrix[3];
+		return otherSDF(outClosestPoint) - radius;
+	}
+
+	size_t SphereCollider::GetSdfQueryPointCount() const
+	{
+		return 1;
+	}
+
+	void SphereCollider::GetSdfQueryPoints(glm::vec3* p_outPoints) const
+	{
+		p_outPoints[0] = worldMatrix[3];
+	}
+
+	float SphereCollider::GetSdfQueryRadius() const
+	{
+		return radius;
+	}
+
 
 	CapsuleCollider::CapsuleCollider() :
+		Collider(ColliderType::E_Capsule),
 		radius(1.f),
 		height(2.f)
+	{}
+
+	void CapsuleCollider::GetSegment(glm::vec3& outA, glm::vec3& outB) const
 	{
-		sdf = [this](const glm::vec3& p)
-		{
-			float h0 = height * 0.5f;
-			glm::vec3 a = this->worldMatrix * glm::vec4(0.f, h0, 0.f, 1.f);
-			glm::vec3 b = this->worldMatrix * glm::vec4(0.f, -h0, 0.f, 1.f);
-			glm::vec3 pa = p - a;
-			glm::vec3 ba = b - a;
-			float h = glm::clamp(glm::dot(pa, ba) / glm::dot(ba, ba), 0.f, 1.f);
-			return glm::length(pa - ba * h) - this->radius;
-		};
+		// the axis is the local y axis, so the transform reduces to the second and fourth column
+		glm::vec3 center = worldMatrix[3];
+		glm::vec3 axis = glm::vec3(worldMatrix[1]) * (height * 0.5f);
+		outA = center + axis;
+		outB = center - axis;
 	}
 
-	void CapsuleCollider::UpdateWorldAABB()
+	float CapsuleCollider::Distance(const glm::vec3& p) const
 	{
 		float h0 = height * 0.5f;
 		glm::vec3 a = this->worldMatrix * glm::vec4(0.f, h0, 0.f, 1.f);
 		glm::vec3 b = this->worldMatrix * glm::vec4(0.f, -h0, 0.f, 1.f);
-		worldAABB.min = glm::min(a, b) - glm::vec3(radius);
-		worldAABB.max = glm::max(a, b) + glm::vec3(radius);
+		glm::vec3 pa = p - a;
+		glm::vec3 ba = b - a;
+		float h = glm::clamp(glm::dot(pa, ba) / glm::dot(ba, ba), 0.f, 1.f);
+		return glm::length(pa - ba * h) - this->radius;
 	}
 
-	bool CapsuleCollider::IntersectsSDF(const SDF& otherSDF, HitResult& outHitReslut) const
+	Dual CapsuleCollider::DualDistance(const DualVec3& p) const
 	{
 		float h0 = height * 0.5f;
 		glm::vec3 a = this->worldMatrix * glm::vec4(0.f, h0, 0.f, 1.f);
 		glm::vec3 b = this->worldMatrix * glm::vec4(0.f, -h0, 0.f, 1.f);
-		glm::vec3 ab = b - a;
+		DualVec3 pa = p - a;
+		glm::vec3 ba = b - a;
+		Dual h = Clamp(Dot(pa, ba) / glm::dot(ba, ba), 0.f, 1.f);
+		return Length(pa - ba * h) - this->radius;
+	}
 
-		float t = 0.f;
-		const float alpha = 0.25f;
-		const float step = alpha * height / (2.f * radius);
-		glm::vec3 closestPoint(0.f);
-		float closestDist = radius;
-		bool hit = false;
+	SDF CapsuleCollider::GetSDF() const
+	{
+		return SDF::Bind<CapsuleCollider, &CapsuleCollider::Distance, &CapsuleCollider::DualDistance>(*this);
+	}
 
-		while (true)
+	void CapsuleCollider::UpdateWorldAABB()
+	{
+		float h0 = height * 0.5f;
+		glm::vec3 a = this->worldMatrix * glm::vec4(0.f, h0, 0.f, 1.f);
+		glm::vec3 b = this->worldMatrix * glm::vec4(0.f, -h0, 0.f, 1.f);
+		worldAABB.min = glm::min(a, b) - glm::vec3(radius);
+		worldAABB.max = glm::max(a, b) + glm::vec3(radius);
+	}
+
+	bool CapsuleCollider::IntersectsSDF(const SDF& otherSDF, HitResult& outHitReslut, size_t* p_outEvaluationCount) const
+	{
+		return ContactsWithSDF(otherSDF, &outHitReslut, 1, p_outEvaluationCount) != 0;
+	}
+
+	size_t CapsuleCollider::ContactsWithSDF(const SDF& otherSDF, HitResult* p_outHitResults, size_t maxHitCount, size_t* p_outEvaluationCount) const
+	{
+		if (maxHitCount == 0)
+			return Collider::ContactsWithSDF(otherSDF, p_outHitResults, maxHitCount, p_outEvaluationCount);
+
+		glm::vec3 a, b;
+		GetSegment(a, b);
+		float length = glm::distance(a, b);
+		glm::vec3 direction = length > 0.f ? (b - a) / length : glm::vec3(0.f);
+
+		// the sdf changes no faster than the distance along the segment, so the middle sample bounds the
+		// whole segment and rejects a capsule clear of the surface with one evaluation
+		float halfLength = 0.5f * length;
+		glm::vec3 middle = a + direction * halfLength;
+		float middleDist = otherSDF(middle);
+		size_t evaluationCount = 1;
+
+		float closestS = halfLength;
+		float closestDist = glm::min(middleDist, radius);
+		bool hit = middleDist <= radius;
+
+		// the samples closest to the ends, kept for the manifold
+		float firstS = halfLength;
+		float firstDist = middleDist;
+		float lastS = halfLength;
+		float lastDist = middleDist;
+
+		if (middleDist - halfLength <= radius)
 		{
-			glm::vec3 point = a + ab * glm::min(t, 1.f);
-			
-			float dist = otherSDF(point);
-			if (dist < closestDist)
+			// march from a, a sample clears the points closer to it than its distance minus the closest distance
+			// found so far, which starts at the radius, so samples are spaced by how far the surface is and the
+			// march stops once the rest of the segment can not get any closer
+			// close to the surface the samples are a radius apart, like the query points of the world test
+			const float minStep = glm::max(radius, length / 64.f);
+			float s = 0.f;
+
+			while (true)
 			{
-				closestPoint = point;
-				closestDist = dist;
-				hit = true;
+				float middleClearance = middleDist - closestDist;
+				if (glm::abs(s - halfLength) < middleClearance)
+				{
+					s = halfLength + middleClearance;
+					if (s >= length)
+						break;
+				}
+
+				glm::vec3 point = a + direction * s;
+				float dist = otherSDF(point);
+				evaluationCount++;
+
+				if (dist < closestDist || (!hit && dist <= radius))
+				{
+					closestS = s;
+					closestDist = dist;
+					hit = true;
+				}
+
+				if (s < firstS)
+				{
+					firstS = s;
+					firstDist = dist;
+				}
+
+				if (s > lastS)
+				{
+					lastS = s;
+					lastDist = dist;
+				}
+
+				if (s >= length || dist - (length - s) >= closestDist)
+					break;
+
+				s = glm::min(s + glm::max(dist - closestDist, minStep), length);
 			}
+		}
 
-			if (t >= 1.f)
-				break;
+		if (hit)
+			evaluationCount += NormalEvaluationCount(otherSDF);
 
-			t += glm::max(step, dist);
-		}
+		if (p_outEvaluationCount != nullptr)
+			*p_outEvaluationCount = evaluationCount;
 
 		if (!hit)
-			return false;
+			return 0;
 
-		glm::vec3 normal = CalcNormal(otherSDF, closestPoint);
-		glm::vec3 point = closestPoint - normal * closestDist;
+		glm::vec3 normal = CalcNormal(otherSDF, a + direction * closestS);
 
-		//if (otherSDF(point) > 0.1f)
-		//	return false;
+		p_outHitResults[0].normal = normal;
+		p_outHitResults[0].point = a + direction * closestS - normal * closestDist;
+		p_outHitResults[0].distance = radius - closestDist;// distance = overlap
+		size_t hitCount = 1;
 
-		outHitReslut.normal = normal;
-		outHitReslut.point = point;
+		// samples within a radius of the deepest one add nothing to the manifold
+		const float endS[2] = { firstS, lastS };
+		const float endDist[2] = { firstDist, lastDist };
 
-		outHitReslut.distance = -sdf(outHitReslut.point);// distance = overlap
+		for (size_t i = 0; i < 2 && hitCount < maxHitCount; i++)
+		{
+			if (endDist[i] > radius || glm::abs(endS[i] - closestS) < radius)
+				continue;
 
-		return true;
+			HitResult& endHit = p_outHitResults[hitCount++];
+			endHit.normal = normal;
+			endHit.point = a + direction * endS[i] - normal * endDist[i];
+			endHit.distance = radius - endDist[i];
+		}
+
+		return hitCount;
 	}
 
 	bool CapsuleCollider::IntersectsRay(const glm::vec3& origin, const glm::vec3& direction, HitResult& outHitResult) const
@@ -201,4 +396,70 @@ namespace Engine
 
 		return true;
 	}
+
+	float CapsuleCollider::BoundingRadius() const
+	{
+		return radius + height * 0.5f;
+	}
+
+	float CapsuleCollider::DistanceToSDF(const SDF& otherSDF, glm::vec3& outClosestPoint, float lipschitzBound) const
+	{
+		float h0 = height * 0.5f;
+		glm::vec3 a = this->worldMatrix * glm::vec4(0.f, h0, 0.f, 1.f);
+		glm::vec3 b = this->worldMatrix * glm::vec4(0.f, -h0, 0.f, 1.f);
+		float length = glm::distance(a, b);
+		glm::vec3 direction = length > 0.f ? (b - a) / length : glm::vec3(0.f);
+
+		// march along the segment, between two samples the sdf can not drop below the point where
+		// the two distance bounds meet, (d0 + d1 - lipschitzBound * step) / 2
+		const float minStep = glm::max(0.5f * radius, length / 64.f);
+		float s = 0.f;
+		float dist = otherSDF(a);
+		float bound = dist;
+		float closestDist = dist;
+		outClosestPoint = a;
+
+		while (s < length)
+		{
+			float step = glm::min(glm::max(dist, minStep), length - s);
+			s += step;
+
+			glm::vec3 point = a + direction * s;
+			float nextDist = otherSDF(point);
+			bound = glm::min(bound, 0.5f * (dist + nextDist - lipschitzBound * step));
+
+			if (nextDist < closestDist)
+			{
+				outClosestPoint = point;
+				closestDist = nextDist;
+			}
+
+			dist = nextDist;
+		}
+
+		return bound - radius;
+	}
+
+	size_t CapsuleCollider::GetSdfQueryPointCount() const
+	{
+		// samples at most a radius apart, both ends included, so the spheres around them overlap
+		size_t intervalCount = size_t(glm::ceil(height / radius));
+		return glm::max(intervalCount, size_t(1)) + 1;
+	}
+
+	void CapsuleCollider::GetSdfQueryPoints(glm::vec3* p_outPoints) const
+	{
+		float h0 = height * 0.5f;
+		glm::vec3 a = this->worldMatrix * glm::vec4(0.f, h0, 0.f, 1.f);
+		glm::vec3 b = this->worldMatrix * glm::vec4(0.f, -h0, 0.f, 1.f);
+
+		size_t count = GetSdfQueryPointCount();
+		for (size_t i = 0; i < count; i++)
+			p_outPoints[i] = glm::mix(a, b, float(i) / float(count - 1));
+	}
+
+	float CapsuleCollider::GetSdfQueryRadius() const
+	{
+		return radius;
+	}
 }
\ No newline at end of file
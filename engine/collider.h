@@ -13,19 +13,56 @@ namespace Engine
 		AABB();
 	};
 
+	bool AabbOverlaps(const AABB& a, const AABB& b);
+	bool AabbContains(const AABB& outer, const AABB& inner);
+	AABB AabbUnion(const AABB& a, const AABB& b);
+	float AabbSurfaceArea(const AABB& aabb);
+	bool RayIntersectsAabb(const glm::vec3& origin, const glm::vec3& inverseDirection, const AABB& aabb, float maxDistance);
+
+	enum class ColliderType : char
+	{
+		E_Sphere,
+		E_Capsule,
+		E_Count
+	};
+
 	class Collider
 	{
+	private:
+		ColliderType type;
+
 	public:
-		Collider();
+		Collider(ColliderType _type);
 
 		AABB worldAABB;
 		glm::mat4 localMatrix;
 		glm::mat4 worldMatrix;
-		SDF sdf;
 
+		// picks the contact function for a pair of colliders, see narrowphase.h
+		ColliderType GetType() const;
+
+		// refers to this collider, so it is only valid while the collider exists
+		virtual SDF GetSDF() const = 0;
 		virtual void UpdateWorldAABB() = 0;
-		virtual bool IntersectsSDF(const SDF& otherSDF, HitResult& outHitResult) const = 0;
+		// the number of sdf evaluations the query took is written to p_outEvaluationCount when given
+		virtual bool IntersectsSDF(const SDF& otherSDF, HitResult& outHitResult, size_t* p_outEvaluationCount = nullptr) const = 0;
+		// up to maxHitCount contacts found by the same walk as IntersectsSDF, the deepest one first, the others
+		// share its normal so they cost no extra evaluations, returns how many were written
+		virtual size_t ContactsWithSDF(const SDF& otherSDF, HitResult* p_outHitResults, size_t maxHitCount, size_t* p_outEvaluationCount = nullptr) const;
 		virtual bool IntersectsRay(const glm::vec3& origin, const glm::vec3& direction, HitResult& outHitResult) const = 0;
+
+		// radius of a sphere around the collider origin that contains the collider
+		virtual float BoundingRadius() const = 0;
+		// lower bound of the distance between the collider surface and the sdf surface, negative when overlapping,
+		// outClosestPoint is the point inside the collider where the sdf was smallest, the lipschitz bound is how
+		// fast the sdf can change per unit moved
+		virtual float DistanceToSDF(const SDF& otherSDF, glm::vec3& outClosestPoint, float lipschitzBound = 1.f) const = 0;
+
+		// the collider is the polyline through its query points grown by the query radius, testing
+		// these points lets many colliders share one batched sdf evaluation
+		virtual size_t GetSdfQueryPointCount() const = 0;
+		virtual void GetSdfQueryPoints(glm::vec3* p_outPoints) const = 0;
+		virtual float GetSdfQueryRadius() const = 0;
 	};
 
 	class SphereCollider final : public Collider
@@ -35,9 +72,18 @@ namespace Engine
 
 		SphereCollider();
 
+		float Distance(const glm::vec3& p) const;
+		Dual DualDistance(const DualVec3& p) const;
+
+		virtual SDF GetSDF() const override;
 		virtual void UpdateWorldAABB() override;
-		virtual bool IntersectsSDF(const SDF& otherSDF, HitResult& outHitReslut) const override;
+		virtual bool IntersectsSDF(const SDF& otherSDF, HitResult& outHitReslut, size_t* p_outEvaluationCount = nullptr) const override;
 		virtual bool IntersectsRay(const glm::vec3& origin, const glm::vec3& direction, HitResult& outHitResult) const override;
+		virtual float BoundingRadius() const override;
+		virtual float DistanceToSDF(const SDF& otherSDF, glm::vec3& outClosestPoint, float lipschitzBound = 1.f) const override;
+		virtual size_t GetSdfQueryPointCount() const override;
+		virtual void GetSdfQueryPoints(glm::vec3* p_outPoints) const override;
+		virtual float GetSdfQueryRadius() const override;
 	};
 
 	class CapsuleCollider final : public Collider
@@ -48,8 +94,22 @@ namespace Engine
 
 		CapsuleCollider();
 
+		// end points of the capsule axis in world space
+		void GetSegment(glm::vec3& outA, glm::vec3& outB) const;
+		float Distance(const glm::vec3& p) const;
+		Dual DualDistance(const DualVec3& p) const;
+
+		virtual SDF GetSDF() const override;
 		virtual void UpdateWorldAABB() override;
-		virtual bool IntersectsSDF(const SDF& otherSDF, HitResult& outHitReslut) const override;
+		virtual bool IntersectsSDF(const SDF& otherSDF, HitResult& outHitReslut, size_t* p_outEvaluationCount = nullptr) const override;
+		// the deepest point of the walk and the first and last samples, which are the end caps unless the
+		// middle sample cleared them
+		virtual size_t ContactsWithSDF(const SDF& otherSDF, HitResult* p_outHitResults, size_t maxHitCount, size_t* p_outEvaluationCount = nullptr) const override;
 		virtual bool IntersectsRay(const glm::vec3& origin, const glm::vec3& direction, HitResult& outHitResult) const override;
+		virtual float BoundingRadius() const override;
+		virtual float DistanceToSDF(const SDF& otherSDF, glm::vec3& outClosestPoint, float lipschitzBound = 1.f) const override;
+		virtual size_t GetSdfQueryPointCount() const override;
+		virtual void GetSdfQueryPoints(glm::vec3* p_outPoints) const override;
+		virtual float GetSdfQueryRadius() const override;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include "contact_solver.h"
+#include <algorithm>
+
+namespace Engine
+{
+	glm::mat3 MakeContactMatrix(const glm::vec3& hitNormal)
+	{
+		glm::vec3 tangent1, tangent2;
+
+		if (glm::abs(hitNormal.x) > glm::abs(hitNormal.y))
+		{
+			float scale = 1.f / glm::sqrt(hitNormal.z * hitNormal.z + hitNormal.x * hitNormal.x);
+
+			tangent1.x = hitNormal.z * scale;
+			tangent1.y = 0.f;
+			tangent1.z = -hitNormal.x * scale;
+
+			tangent2.x = hitNormal.y * tangent1.x;
+			tangent2.y = hitNormal.z * tangent1.x - hitNormal.x * tangent1.z;
+			tangent2.z = -hitNormal.y * tangent1.x;
+		}
+		else
+		{
+			float scale = 1.f / glm::sqrt(hitNormal.z * hitNormal.z + hitNormal.y * hitNormal.y);
+
+			tangent1.x = 0.f;
+			tangent1.y = -hitNormal.z * scale;
+			tangent1.z = hitNormal.y * scale;
+
+			tangent2.x = hitNormal.y * tangent1.z - hitNormal.z * tangent1.y;
+			tangent2.y = -hitNormal.x * tangent1.z;
+			tangent2.z = hitNormal.x * tangent1.y;
+		}
+
+		return glm::mat3(
+			hitNormal,
+			tangent1,
+			tangent2
+		);
+	}
+
+	bool ContactSolver::CachedImpulseLess(const CachedImpulse& lhs, const CachedImpulse& rhs)
+	{
+		return lhs.key < rhs.key || (lhs.key == rhs.key && lhs.feature < rhs.feature);
+	}
+
+	ContactSolver::ContactSolver() :
+		iterationCount(10),
+		warmStarting(true),
+		restitutionThreshold(1.f),
+		contactSlop(0.01f),
+		positionCorrection(0.4f)
+	{}
+
+	uint32_t ContactSolver::AddBody(const Rigidbody& rigidbody)
+	{
+		if (!rigidbody.IsValid())
+			return 0;
+
+		uint32_t id = rigidbody.GetId();
+		if (id >= bodyIndexOfId.size())
+			bodyIndexOfId.resize(id + 1, 0);
+
+		if (bodyIndexOfId[id] != 0)
+			return bodyIndexOfId[id];
+
+		// locked axes, static and kinematic bodies behave as if the mass or inertia was infinite
+		bool isDynamic = rigidbody.GetBodyType() == BodyType::E_Dynamic;
+
+		SolverBody body;
+		body.rigidbody = rigidbody;
+		body.linearVelocity = rigidbody.GetLinearVelocity();
+		body.angularVelocity = rigidbody.GetAngularVelocity();
+		body.centerOfMass = rigidbody.GetCenterOfMass();
+		body.inverseMass = (isDynamic && !rigidbody.IsPositionLocked()) ? rigidbody.GetInverseMass() : 0.f;
+		body.inverseInertia = (isDynamic && !rigidbody.IsRotationLocked()) ? rigidbody.GetWorldInverseInertiaTensor() : glm::mat3(0.f);
+
+		bodyIndexOfId[id] = uint32_t(bodies.size());
+		bodies.push_back(body);
+
+		return bodyIndexOfId[id];
+	}
+
+	void ContactSolver::PrepareContacts(const std::vector<Contact>& contacts)
+	{
+		solverContacts.resize(contacts.size());
+
+		for (size_t i = 0; i < contacts.size(); i++)
+		{
+			const Contact& contact = contacts[i];
+			SolverContact& solverContact = solverContacts[i];
+
+			solverContact.firstBody = AddBody(contact.firstBody);
+			solverContact.secondBody = AddBody(contact.secondBody);
+
+			const SolverBody& first = bodies[solverContact.firstBody];
+			const SolverBody& second = bodies[solverContact.secondBody];
+
+			glm::mat3 contactToWorld(MakeContactMatrix(contact.normal));
+			solverContact.normal = contactToWorld[0];
+			solverContact.tangent1 = contactToWorld[1];
+			solverContact.tangent2 = contactToWorld[2];
+			solverContact.firstArm = contact.point - first.centerOfMass;
+			solverContact.secondArm = contact.point - second.centerOfMass;
+			solverContact.friction = contact.friction;
+
+			// effective mass along a direction, 1 / (J * M^-1 * J^T)
+			auto effectiveMass = [&](const glm::vec3& direction)
+			{
+				glm::vec3 firstTorque = glm::cross(solverContact.firstArm, direction);
+				glm::vec3 secondTorque = glm::cross(solverContact.secondArm, direction);
+
+				float inverseMass = first.inverseMass + second.inverseMass +
+					glm::dot(firstTorque, first.inverseInertia * firstTorque) +
+					glm::dot(secondTorque, second.inverseInertia * secondTorque);
+
+				return inverseMass > 0.f ? 1.f / inverseMass : 0.f;
+			};
+
+			solverContact.normalMass = effectiveMass(solverContact.normal);
+			solverContact.tangentMass1 = effectiveMass(solverContact.tangent1);
+			solverContact.tangentMass2 = effectiveMass(solverContact.tangent2);
+
+			// bounce relative to the closing speed before any impulse is applied
+			float normalVelocity = glm::dot(RelativeVelocity(solverContact), solverContact.normal);
+			solverContact.velocityBias = (normalVelocity < -restitutionThreshold) ? -contact.restitution * normalVelocity : 0.f;
+
+			solverContact.normalImpulse = 0.f;
+			solverContact.tangentImpulse1 = 0.f;
+			solverContact.tangentImpulse2 = 0.f;
+		}
+	}
+
+	void ContactSolver::WarmStart(const std::vector<Contact>& contacts)
+	{
+		for (size_t i = 0; i < contacts.size(); i++)
+		{
+			CachedImpulse search{ contacts[i].key, contacts[i].feature, glm::vec3(0.f) };
+			auto it = std::lower_bound(cachedImpulses.begin(), cachedImpulses.end(), search, CachedImpulseLess);
+			if (it == cachedImpulses.end() || it->key != contacts[i].key || it->feature != contacts[i].feature)
+				continue;
+
+			// the previous impulse is projected onto this step's contact frame, the normal may have turned a bit
+			SolverContact& contact = solverContacts[i];
+			contact.normalImpulse = glm::max(glm::dot(it->impulse, contact.normal), 0.f);
+			float maxFriction = contact.friction * contact.normalImpulse;
+			contact.tangentImpulse1 = glm::clamp(glm::dot(it->impulse, contact.tangent1), -maxFriction, maxFriction);
+			contact.tangentImpulse2 = glm::clamp(glm::dot(it->impulse, contact.tangent2), -maxFriction, maxFriction);
+
+			ApplyImpulse(contact,
+				contact.normal * contact.normalImpulse +
+				contact.tangent1 * contact.tangentImpulse1 +
+				contact.tangent2 * contact.tangentImpulse2);
+		}
+	}
+
+	glm::vec3 ContactSolver::RelativeVelocity(const SolverContact& contact) const
+	{
+		const SolverBody& first = bodies[contact.firstBody];
+		const SolverBody& second = bodies[contact.secondBody];
+
+		return
+			first.linearVelocity + glm::cross(first.angularVelocity, contact.firstArm) -
+			second.linearVelocity - glm::cross(second.angularVelocity, contact.secondArm);
+	}
+
+	void ContactSolver::ApplyImpulse(SolverContact& contact, const glm::vec3& impulse)
+	{
+		SolverBody& first = bodies[contact.firstBody];
+		SolverBody& second = bodies[contact.secondBody];
+
+		first.linearVelocity += impulse * first.inverseMass;
+		first.angularVelocity += first.inverseInertia * glm::cross(contact.firstArm, impulse);
+		second.linearVelocity -= impulse * second.inverseMass;
+		second.angularVelocity -= second.inverseInertia * glm::cross(contact.secondArm, impulse);
+	}
+
+	void ContactSolver::SolveVelocities()
+	{
+		for (size_t iteration = 0; iteration < iterationCount; iteration++)
+		{
+			for (SolverContact& contact : solverContacts)
+			{
+				// friction first, limited by the normal impulse of the previous iteration
+				float maxFriction = contact.friction * contact.normalImpulse;
+				glm::vec3 relativeVelocity = RelativeVelocity(contact);
+
+				float oldImpulse = contact.tangentImpulse1;
+				contact.tangentImpulse1 = glm::clamp(oldImpulse - contact.tangentMass1 * glm::dot(relativeVelocity, contact.tangent1), -maxFriction, maxFriction);
+				glm::vec3 impulse = contact.tangent1 * (contact.tangentImpulse1 - oldImpulse);
+
+				oldImpulse = contact.tangentImpulse2;
+				contact.tangentImpulse2 = glm::clamp(oldImpulse - contact.tangentMass2 * glm::dot(relativeVelocity, contact.tangent2), -maxFriction, maxFriction);
+				impulse += contact.tangent2 * (contact.tangentImpulse2 - oldImpulse);
+
+				ApplyImpulse(contact, impulse);
+
+				// the accumulated normal impulse may only push
+				float normalVelocity = glm::dot(RelativeVelocity(contact), contact.normal);
+
+				oldImpulse = contact.normalImpulse;
+				contact.normalImpulse = glm::max(oldImpulse - contact.normalMass * (normalVelocity - contact.velocityBias), 0.f);
+
+				ApplyImpulse(contact, contact.normal * (contact.normalImpulse - oldImpulse));
+			}
+		}
+	}
+
+	void ContactSolver::Solve(std::vector<Contact>& contacts)
+	{
+		bodies.clear();
+		bodies.push_back({ Rigidbody(), glm::vec3(0.f), glm::vec3(0.f), glm::vec3(0.f), glm::mat3(0.f), 0.f });
+
+		PrepareContacts(contacts);
+
+		if (warmStarting)
+			WarmStart(contacts);
+
+		SolveVelocities();
+
+		nextCachedImpulses.clear();
+
+		size_t manifoldEnd = 0;
+		size_t deepestContact = 0;
+
+		for (size_t i = 0; i < contacts.size(); i++)
+		{
+			Contact& contact = contacts[i];
+
+			// the contacts of a pair come one after another, each sees its own penetration, the pair is
+			// corrected once through its deepest contact so a manifold does not push the bodies apart once
+			// per contact and its deepest point does not keep sinking
+			if (i == manifoldEnd)
+			{
+				deepestContact = i;
+				while (manifoldEnd < contacts.size() && contacts[manifoldEnd].key == contact.key)
+				{
+					if (contacts[manifoldEnd].penetration > contacts[deepestContact].penetration)
+						deepestContact = manifoldEnd;
+
+					manifoldEnd++;
+				}
+			}
+
+			const SolverContact& solverContact = solverContacts[i];
+			const SolverBody& first = bodies[solverContact.firstBody];
+			const SolverBody& second = bodies[solverContact.secondBody];
+
+			contact.impulse =
+				solverContact.normal * solverContact.normalImpulse +
+				solverContact.tangent1 * solverContact.tangentImpulse1 +
+				solverContact.tangent2 * solverContact.tangentImpulse2;
+
+			nextCachedImpulses.push_back({ contact.key, contact.feature, contact.impulse });
+
+			// push the bodies apart by a part of the penetration, split by inverse mass
+			float totalInverseMass = first.inverseMass + second.inverseMass;
+			float depth = i == deepestContact ? glm::max(contact.penetration - contactSlop, 0.f) * positionCorrection : 0.f;
+			contact.firstCorrection = glm::vec3(0.f);
+			contact.secondCorrection = glm::vec3(0.f);
+
+			if (totalInverseMass > 0.f && depth > 0.f)
+			{
+				glm::vec3 correction = contact.normal * (depth / totalInverseMass);
+				contact.firstCorrection = correction * first.inverseMass;
+				contact.secondCorrection = -correction * second.inverseMass;
+
+				if (first.inverseMass > 0.f)
+					contact.firstBody.AddCollisionResponseTranslation(contact.firstCorrection);
+
+				if (second.inverseMass > 0.f)
+					contact.secondBody.AddCollisionResponseTranslation(contact.secondCorrection);
+			}
+		}
+
+		std::sort(nextCachedImpulses.begin(), nextCachedImpulses.end(), CachedImpulseLess);
+		cachedImpulses.swap(nextCachedImpulses);
+
+		// write the velocities back, body 0 is the static world
+		for (size_t i = 1; i < bodies.size(); i++)
+		{
+			if (bodies[i].rigidbody.GetBodyType() == BodyType::E_Dynamic)
+			{
+				bodies[i].rigidbody.SetLinearVelocity(bodies[i].linearVelocity);
+				bodies[i].rigidbody.SetAngularVelocity(bodies[i].angularVelocity);
+			}
+
+			bodyIndexOfId[bodies[i].rigidbody.GetId()] = 0;
+		}
+	}
+}
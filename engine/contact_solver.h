@@ -0,0 +1,96 @@
+#pragma once
+#include "rigidbody.h"
+#include <vector>
+#include <cstdint>
+
+namespace Engine
+{
+	struct Contact
+	{
+		Rigidbody firstBody;
+		Rigidbody secondBody;// invalid handle when the first body touches the static world
+		uint32_t firstUserId;
+		uint32_t secondUserId;
+		uint64_t key;// identifies the pair of bodies across steps for warm starting
+		uint32_t feature;// tells the contacts of one pair apart, like the collider point they were found at
+		glm::vec3 point;
+		glm::vec3 normal;// points from the second body towards the first
+		float penetration;
+		float friction;
+		float restitution;
+
+		glm::vec3 impulse;// total impulse applied to the first body, written by the solver
+		glm::vec3 firstCorrection;// positional corrections applied to the bodies, written by the solver
+		glm::vec3 secondCorrection;
+	};
+
+	// sequential impulse solver, the effective masses are computed once per contact and the impulses
+	// are then refined over a number of iterations, accumulated impulses are kept per contact key and
+	// applied up front in the next step so resting contacts start close to their final solution
+	// the contacts of one pair have to be next to each other, the pair is corrected once through its deepest contact
+	class ContactSolver final
+	{
+	private:
+		struct SolverBody
+		{
+			Rigidbody rigidbody;
+			glm::vec3 linearVelocity;
+			glm::vec3 angularVelocity;
+			glm::vec3 centerOfMass;
+			glm::mat3 inverseInertia;
+			float inverseMass;
+		};
+
+		struct SolverContact
+		{
+			uint32_t firstBody;
+			uint32_t secondBody;
+			glm::vec3 firstArm;// contact point relative to the centers of mass
+			glm::vec3 secondArm;
+			glm::vec3 normal;
+			glm::vec3 tangent1;
+			glm::vec3 tangent2;
+			float normalMass;
+			float tangentMass1;
+			float tangentMass2;
+			float velocityBias;
+			float friction;
+			float normalImpulse;
+			float tangentImpulse1;
+			float tangentImpulse2;
+		};
+
+		struct CachedImpulse
+		{
+			uint64_t key;
+			uint32_t feature;
+			glm::vec3 impulse;
+		};
+
+		std::vector<SolverBody> bodies;// body 0 is the static world
+		std::vector<uint32_t> bodyIndexOfId;
+		std::vector<SolverContact> solverContacts;
+		std::vector<CachedImpulse> cachedImpulses;
+		std::vector<CachedImpulse> nextCachedImpulses;
+
+		static bool CachedImpulseLess(const CachedImpulse& lhs, const CachedImpulse& rhs);
+
+		uint32_t AddBody(const Rigidbody& rigidbody);
+		void PrepareContacts(const std::vector<Contact>& contacts);
+		void WarmStart(const std::vector<Contact>& contacts);
+		void SolveVelocities();
+		void ApplyImpulse(SolverContact& contact, const glm::vec3& impulse);
+		glm::vec3 RelativeVelocity(const SolverContact& contact) const;
+
+	public:
+		size_t iterationCount;
+		bool warmStarting;
+		float restitutionThreshold;// closing speeds below this do not bounce, keeps resting stacks quiet
+		float contactSlop;// penetration that is allowed to remain, avoids contacts flickering on and off
+		float positionCorrection;// fraction of the remaining penetration resolved per step
+
+		ContactSolver();
+
+		void Solve(std::vector<Contact>& contacts);
+	};
+}
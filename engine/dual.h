@@ -0,0 +1,85 @@
+#pragma once
+#include <glm.hpp>
+
+namespace Engine
+{
+	// forward mode automatic differentiation, a value together with its gradient with respect to the
+	// query point, so one evaluation of an sdf written with Dual gives the distance and the normal
+	struct Dual
+	{
+		float value;
+		glm::vec3 gradient;
+
+		static Dual Constant(float value);
+	};
+
+	// a query point whose components are the variables of the gradient
+	struct DualVec3
+	{
+		Dual x;
+		Dual y;
+		Dual z;
+
+		static DualVec3 Variable(const glm::vec3& p);
+	};
+
+	inline Dual Dual::Constant(float value) { return { value, glm::vec3(0.f) }; }
+
+	inline Dual operator+(const Dual& a, const Dual& b) { return { a.value + b.value, a.gradient + b.gradient }; }
+	inline Dual operator-(const Dual& a, const Dual& b) { return { a.value - b.value, a.gradient - b.gradient }; }
+	inline Dual operator*(const Dual& a, const Dual& b) { return { a.value * b.value, a.gradient * b.value + b.gradient * a.value }; }
+	inline Dual operator/(const Dual& a, const Dual& b) { return { a.value / b.value, (a.gradient * b.value - b.gradient * a.value) / (b.value * b.value) }; }
+	inline Dual operator-(const Dual& a) { return { -a.value, -a.gradient }; }
+
+	inline Dual operator+(const Dual& a, float b) { return { a.value + b, a.gradient }; }
+	inline Dual operator-(const Dual& a, float b) { return { a.value - b, a.gradient }; }
+	inline Dual operator*(const Dual& a, float b) { return { a.value * b, a.gradient * b }; }
+	inline Dual operator/(const Dual& a, float b) { return { a.value / b, a.gradient / b }; }
+	inline Dual operator+(float a, const Dual& b) { return b + a; }
+	inline Dual operator-(float a, const Dual& b) { return { a - b.value, -b.gradient }; }
+	inline Dual operator*(float a, const Dual& b) { return b * a; }
+
+	// the derivative is unbounded at zero, the gradient is dropped there
+	inline Dual Sqrt(const Dual& a)
+	{
+		float s = glm::sqrt(a.value);
+		return { s, s > 0.f ? a.gradient * (0.5f / s) : glm::vec3(0.f) };
+	}
+
+	inline Dual Abs(const Dual& a) { return a.value < 0.f ? -a : a; }
+	inline Dual Min(const Dual& a, const Dual& b) { return a.value < b.value ? a : b; }
+	inline Dual Max(const Dual& a, const Dual& b) { return a.value > b.value ? a : b; }
+	inline Dual Clamp(const Dual& a, float low, float high) { return a.value < low ? Dual::Constant(low) : a.value > high ? Dual::Constant(high) : a; }
+	inline Dual Sin(const Dual& a) { return { glm::sin(a.value), a.gradient * glm::cos(a.value) }; }
+	inline Dual Cos(const Dual& a) { return { glm::cos(a.value), a.gradient * -glm::sin(a.value) }; }
+
+	// same as for sqrt, the angle has no gradient at the origin
+	inline Dual Atan2(const Dual& y, const Dual& x)
+	{
+		float lengthSquared = x.value * x.value + y.value * y.value;
+		glm::vec3 gradient = lengthSquared > 0.f ? (y.gradient * x.value - x.gradient * y.value) / lengthSquared : glm::vec3(0.f);
+		return { glm::atan(y.value, x.value), gradient };
+	}
+
+	inline DualVec3 DualVec3::Variable(const glm::vec3& p)
+	{
+		return {
+			{ p.x, glm::vec3(1.f, 0.f, 0.f) },
+			{ p.y, glm::vec3(0.f, 1.f, 0.f) },
+			{ p.z, glm::vec3(0.f, 0.f, 1.f) }
+		};
+	}
+
+	inline DualVec3 operator+(const DualVec3& a, const DualVec3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline DualVec3 operator-(const DualVec3& a, const DualVec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline DualVec3 operator+(const DualVec3& a, const glm::vec3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline DualVec3 operator-(const DualVec3& a, const glm::vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline DualVec3 operator-(const DualVec3& a) { return { -a.x, -a.y, -a.z }; }
+	inline DualVec3 operator*(const DualVec3& a, const Dual& b) { return { a.x * b, a.y * b, a.z * b }; }
+	inline DualVec3 operator*(const glm::vec3& a, const Dual& b) { return { a.x * b, a.y * b, a.z * b }; }
+	inline DualVec3 operator*(const DualVec3& a, float b) { return { a.x * b, a.y * b, a.z * b }; }
+
+	inline Dual Dot(const DualVec3& a, const DualVec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline Dual Dot(const DualVec3& a, const glm::vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline Dual Length(const DualVec3& a) { return Sqrt(Dot(a, a)); }
+}
\ No newline at end of file
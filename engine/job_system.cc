@@ -0,0 +1,245 @@
+#include "job_system.h"
+
+namespace Engine
+{
+	// queue owned by the current thread, threads the job system did not start use queue 0
+	static thread_local const JobSystem* p_currentJobSystem = nullptr;
+	static thread_local size_t currentQueueIndex = 0;
+
+	JobCounter::JobCounter() :
+		value(0)
+	{}
+
+	bool JobCounter::IsDone() const
+	{
+		return value.load(std::memory_order_acquire) == 0;
+	}
+
+	JobSystem::JobSystem() :
+		queuedJobs(0),
+		sleepingWorkers(0),
+		quit(false)
+	{
+		queues.push_back(std::make_unique<WorkQueue>());
+	}
+
+	JobSystem::~JobSystem()
+	{
+		Deinit();
+	}
+
+	void JobSystem::Init(size_t workerCount)
+	{
+		Deinit();
+
+		quit = false;
+
+		queues.clear();
+		for (size_t i = 0; i < workerCount + 1; i++)
+			queues.push_back(std::make_unique<WorkQueue>());
+
+		p_currentJobSystem = this;
+		currentQueueIndex = 0;
+
+		for (size_t i = 0; i < workerCount; i++)
+			workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+	}
+
+	void JobSystem::Deinit()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			quit = true;
+		}
+		sleepCondition.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		workers.clear();
+	}
+
+	size_t JobSystem::GetThreadCount() const
+	{
+		return workers.size() + 1;
+	}
+
+	size_t JobSystem::CurrentQueueIndex() const
+	{
+		return p_currentJobSystem == this ? currentQueueIndex : 0;
+	}
+
+	void JobSystem::Push(Job&& job)
+	{
+		WorkQueue& queue = *queues[CurrentQueueIndex()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(std::move(job));
+		}
+
+		queuedJobs.fetch_add(1);
+
+		// a worker going to sleep increments sleepingWorkers before it checks queuedJobs, so one of the two sides sees the other
+		if (sleepingWorkers.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			sleepCondition.notify_one();
+		}
+	}
+
+	bool JobSystem::Pop(size_t queueIndex, Job& outJob)
+	{
+		WorkQueue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.jobs.empty())
+			return false;
+
+		// newest first, it is the most likely to still be in cache
+		outJob = std::move(queue.jobs.back());
+		queue.jobs.pop_back();
+		queuedJobs.fetch_sub(1);
+		return true;
+	}
+
+	bool JobSystem::Steal(size_t thiefIndex, Job& outJob)
+	{
+		for (size_t i = 1; i < queues.size(); i++)
+		{
+			WorkQueue& queue = *queues[(thiefIndex + i) % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+
+			if (queue.jobs.empty())
+				continue;
+
+			// oldest first, it tends to be the largest chunk of remaining work
+			outJob = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			queuedJobs.fetch_sub(1);
+			return true;
+		}
+
+		return false;
+	}
+
+	bool JobSystem::TryRunJob(size_t queueIndex)
+	{
+		Job job;
+		if (!Pop(queueIndex, job) && !Steal(queueIndex, job))
+			return false;
+
+		job.function();
+		Finish(job.p_counter);
+		return true;
+	}
+
+	void JobSystem::Finish(JobCounter* p_counter)
+	{
+		if (p_counter == nullptr)
+			return;
+
+		// decrements that can not be the last one skip the lock
+		uint32_t value = p_counter->value.load(std::memory_order_relaxed);
+		while (value > 1)
+		{
+			if (p_counter->value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel))
+				return;
+		}
+
+		// the last decrement happens under the lock, Wait takes the same lock before it returns so
+		// the counter is not destroyed while it is still held here
+		std::vector<JobCounter::Continuation> released;
+		{
+			std::lock_guard<std::mutex> lock(p_counter->mutex);
+			if (p_counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				released.swap(p_counter->continuations);
+		}
+
+		for (JobCounter::Continuation& continuation : released)
+			Push({ std::move(continuation.function), continuation.p_counter });
+	}
+
+	void JobSystem::WorkerLoop(size_t queueIndex)
+	{
+		p_currentJobSystem = this;
+		currentQueueIndex = queueIndex;
+
+		while (!quit)
+		{
+			if (TryRunJob(queueIndex))
+				continue;
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepingWorkers.fetch_add(1);
+			sleepCondition.wait(lock, [&]() { return quit || queuedJobs.load() > 0; });
+			sleepingWorkers.fetch_sub(1);
+		}
+	}
+
+	void JobSystem::Run(std::function<void()> function, JobCounter* p_counter)
+	{
+		if (p_counter != nullptr)
+			p_counter->value.fetch_add(1, std::memory_order_relaxed);
+
+		Push({ std::move(function), p_counter });
+	}
+
+	void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> function, JobCounter* p_counter)
+	{
+		if (p_counter != nullptr)
+			p_counter->value.fetch_add(1, std::memory_order_relaxed);
+
+		{
+			// the counter is checked under its lock so the job can not miss the release in Finish
+			std::lock_guard<std::mutex> lock(dependency.mutex);
+			if (!dependency.IsDone())
+			{
+				dependency.continuations.push_back({ std::move(function), p_counter });
+				return;
+			}
+		}
+
+		Push({ std::move(function), p_counter });
+	}
+
+	void JobSystem::Wait(JobCounter& counter)
+	{
+		size_t queueIndex = CurrentQueueIndex();
+
+		while (!counter.IsDone())
+		{
+			if (!TryRunJob(queueIndex))
+				std::this_thread::yield();
+		}
+
+		std::lock_guard<std::mutex> lock(counter.mutex);
+	}
+
+	void JobSystem::ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t)>& function)
+	{
+		if (batchSize == 0)
+			batchSize = 1;
+
+		if (workers.empty() || count <= batchSize)
+		{
+			for (size_t i = 0; i < count; i++)
+				function(i);
+
+			return;
+		}
+
+		JobCounter counter;
+		for (size_t begin = 0; begin < count; begin += batchSize)
+		{
+			size_t end = begin + batchSize < count ? begin + batchSize : count;
+
+			Run([&function, begin, end]()
+			{
+				for (size_t i = begin; i < end; i++)
+					function(i);
+			}, &counter);
+		}
+
+		Wait(counter);
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+namespace Engine
+{
+	class JobSystem;
+
+	// counts unfinished jobs, jobs can be made to wait for a counter to reach zero before they start
+	class JobCounter final
+	{
+	private:
+		friend class JobSystem;
+
+		struct Continuation
+		{
+			std::function<void()> function;
+			JobCounter* p_counter;
+		};
+
+		std::atomic<uint32_t> value;
+		std::mutex mutex;
+		std::vector<Continuation> continuations;// jobs waiting for the counter to reach zero
+
+	public:
+		JobCounter();
+
+		bool IsDone() const;
+	};
+
+	// work stealing job system, every thread owns a queue that it pushes and pops at the back while
+	// idle threads steal from the front of the other queues
+	// the thread that calls Init counts as thread 0 and runs jobs while it waits for a counter
+	class JobSystem final
+	{
+	private:
+		struct Job
+		{
+			std::function<void()> function;
+			JobCounter* p_counter;
+		};
+
+		struct WorkQueue
+		{
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		std::vector<std::unique_ptr<WorkQueue>> queues;
+		std::vector<std::thread> workers;
+
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		std::atomic<size_t> queuedJobs;
+		std::atomic<size_t> sleepingWorkers;
+		std::atomic<bool> quit;
+
+		size_t CurrentQueueIndex() const;
+		void Push(Job&& job);
+		bool Pop(size_t queueIndex, Job& outJob);
+		bool Steal(size_t thiefIndex, Job& outJob);
+		bool TryRunJob(size_t queueIndex);
+		void Finish(JobCounter* p_counter);
+		void WorkerLoop(size_t queueIndex);
+
+	public:
+		JobSystem();
+		~JobSystem();
+
+		// a worker count of zero runs every job on the thread that waits for it
+		void Init(size_t workerCount);
+		void Deinit();
+
+		size_t GetThreadCount() const;
+
+		// the counter is incremented now and decremented when the job has run
+		void Run(std::function<void()> function, JobCounter* p_counter = nullptr);
+
+		// the job is held back until the dependency counter reaches zero
+		void RunAfter(JobCounter& dependency, std::function<void()> function, JobCounter* p_counter = nullptr);
+
+		// runs other jobs on the calling thread until the counter reaches zero, a counter must not be
+		// destroyed before a Wait on it has returned
+		void Wait(JobCounter& counter);
+
+		// calls function(i) for every i in [0, count), batchSize indices per job, and waits for all of them
+		void ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t)>& function);
+	};
+}
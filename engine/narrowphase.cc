@@ -0,0 +1,252 @@
+#include "narrowphase.h"
+
+namespace Engine
+{
+	static constexpr size_t colliderTypeCount = size_t(ColliderType::E_Count);
+
+	// a new collider type needs a row and a column here, a null entry sends its pairs to CollideBySDF
+	static_assert(colliderTypeCount == 2, "pairFunctions does not cover every collider type");
+
+	static const CollidePairFunction pairFunctions[colliderTypeCount][colliderTypeCount] =
+	{
+		// second:       sphere                capsule
+		/* sphere  */ { CollideSpheres,       CollideSphereCapsule },
+		/* capsule */ { CollideCapsuleSphere, CollideCapsules }
+	};
+
+	// contact between two spheres grown around the closest points of the collider cores
+	static bool CollideCores(
+		const glm::vec3& firstCore,
+		float firstRadius,
+		const glm::vec3& secondCore,
+		float secondRadius,
+		HitResult& outHitResult)
+	{
+		glm::vec3 delta = firstCore - secondCore;
+		float distanceSquared = glm::dot(delta, delta);
+		float radiusSum = firstRadius + secondRadius;
+
+		if (distanceSquared > radiusSum * radiusSum)
+			return false;
+
+		// cores on top of each other have no direction between them, push up
+		float distance = glm::sqrt(distanceSquared);
+		glm::vec3 normal = distance > 1e-6f ? delta / distance : glm::vec3(0.f, 1.f, 0.f);
+
+		outHitResult.normal = normal;
+		outHitResult.point = secondCore + normal * secondRadius;
+		outHitResult.distance = radiusSum - distance;
+
+		return true;
+	}
+
+	static glm::vec3 ClosestPointOnSegment(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b)
+	{
+		glm::vec3 ab = b - a;
+		float abab = glm::dot(ab, ab);
+		float t = abab > 0.f ? glm::clamp(glm::dot(p - a, ab) / abab, 0.f, 1.f) : 0.f;
+		return a + ab * t;
+	}
+
+	void ClosestPointsOnSegments(
+		const glm::vec3& p1,
+		const glm::vec3& q1,
+		const glm::vec3& p2,
+		const glm::vec3& q2,
+		glm::vec3& outPoint1,
+		glm::vec3& outPoint2)
+	{
+		// minimizes |p1 + d1 * s - p2 - d2 * t| over s and t in [0, 1], Real-Time Collision Detection 5.1.9
+		const float epsilon = 1e-12f;
+		glm::vec3 d1 = q1 - p1;
+		glm::vec3 d2 = q2 - p2;
+		glm::vec3 r = p1 - p2;
+		float a = glm::dot(d1, d1);
+		float e = glm::dot(d2, d2);
+		float f = glm::dot(d2, r);
+		float s = 0.f;
+		float t = 0.f;
+
+		if (a <= epsilon && e <= epsilon)
+		{
+			outPoint1 = p1;
+			outPoint2 = p2;
+			return;
+		}
+
+		if (a <= epsilon)
+			t = glm::clamp(f / e, 0.f, 1.f);
+		else
+		{
+			float c = glm::dot(d1, r);
+
+			if (e <= epsilon)
+				s = glm::clamp(-c / a, 0.f, 1.f);
+			else
+			{
+				float b = glm::dot(d1, d2);
+				float denominator = a * e - b * b;
+
+				// parallel segments have a line of closest points, the middle of their overlap keeps a capsule
+				// lying on another one from being pushed at one end, nearly parallel ones are treated the same
+				// since the division below loses its precision there
+				if (denominator > 1e-4f * a * e)
+					s = glm::clamp((b * f - c * e) / denominator, 0.f, 1.f);
+				else
+				{
+					float sp = -c / a;
+					float sq = (b - c) / a;
+					float overlapStart = glm::clamp(glm::min(sp, sq), 0.f, 1.f);
+					float overlapEnd = glm::clamp(glm::max(sp, sq), 0.f, 1.f);
+					s = 0.5f * (overlapStart + overlapEnd);
+				}
+
+				t = (b * s + f) / e;
+
+				if (t < 0.f)
+				{
+					t = 0.f;
+					s = glm::clamp(-c / a, 0.f, 1.f);
+				}
+				else if (t > 1.f)
+				{
+					t = 1.f;
+					s = glm::clamp((b - c) / a, 0.f, 1.f);
+				}
+			}
+		}
+
+		outPoint1 = p1 + d1 * s;
+		outPoint2 = p2 + d2 * t;
+	}
+
+	bool CollideSpheres(const Collider& first, const Collider& second, HitResult& outHitResult)
+	{
+		const SphereCollider& firstSphere = static_cast<const SphereCollider&>(first);
+		const SphereCollider& secondSphere = static_cast<const SphereCollider&>(second);
+
+		return CollideCores(
+			glm::vec3(firstSphere.worldMatrix[3]), firstSphere.radius,
+			glm::vec3(secondSphere.worldMatrix[3]), secondSphere.radius,
+			outHitResult);
+	}
+
+	bool CollideSphereCapsule(const Collider& first, const Collider& second, HitResult& outHitResult)
+	{
+		const SphereCollider& sphere = static_cast<const SphereCollider&>(first);
+		const CapsuleCollider& capsule = static_cast<const CapsuleCollider&>(second);
+
+		glm::vec3 a, b;
+		capsule.GetSegment(a, b);
+		glm::vec3 center = sphere.worldMatrix[3];
+
+		return CollideCores(center, sphere.radius, ClosestPointOnSegment(center, a, b), capsule.radius, outHitResult);
+	}
+
+	bool CollideCapsuleSphere(const Collider& first, const Collider& second, HitResult& outHitResult)
+	{
+		const CapsuleCollider& capsule = static_cast<const CapsuleCollider&>(first);
+		const SphereCollider& sphere = static_cast<const SphereCollider&>(second);
+
+		glm::vec3 a, b;
+		capsule.GetSegment(a, b);
+		glm::vec3 center = sphere.worldMatrix[3];
+
+		return CollideCores(ClosestPointOnSegment(center, a, b), capsule.radius, center, sphere.radius, outHitResult);
+	}
+
+	bool CollideCapsules(const Collider& first, const Collider& second, HitResult& outHitResult)
+	{
+		const CapsuleCollider& firstCapsule = static_cast<const CapsuleCollider&>(first);
+		const CapsuleCollider& secondCapsule = static_cast<const CapsuleCollider&>(second);
+
+		glm::vec3 a1, b1, a2, b2;
+		firstCapsule.GetSegment(a1, b1);
+		secondCapsule.GetSegment(a2, b2);
+
+		glm::vec3 firstCore, secondCore;
+		ClosestPointsOnSegments(a1, b1, a2, b2, firstCore, secondCore);
+
+		return CollideCores(firstCore, firstCapsule.radius, secondCore, secondCapsule.radius, outHitResult);
+	}
+
+	bool CollideBySDF(const Collider& first, const Collider& second, HitResult& outHitResult)
+	{
+		return first.IntersectsSDF(second.GetSDF(), outHitResult);
+	}
+
+	// the segment and radius a sphere or capsule is grown from
+	static bool GetCore(const Collider& collider, glm::vec3& outA, glm::vec3& outB, float& outRadius)
+	{
+		switch (collider.GetType())
+		{
+		case ColliderType::E_Sphere:
+		{
+			const SphereCollider& sphere = static_cast<const SphereCollider&>(collider);
+			outA = outB = glm::vec3(sphere.worldMatrix[3]);
+			outRadius = sphere.radius;
+			return true;
+		}
+		case ColliderType::E_Capsule:
+		{
+			const CapsuleCollider& capsule = static_cast<const CapsuleCollider&>(collider);
+			capsule.GetSegment(outA, outB);
+			outRadius = capsule.radius;
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	bool ShapeCastCollider(const ShapeCast& cast, const Collider& collider, HitResult& outHitResult, const RaycastOptions& options)
+	{
+		glm::vec3 a, b;
+		float radius;
+		if (!GetCore(collider, a, b, radius))
+			return ShapeCastSDF(collider.GetSDF(), cast, outHitResult, options);
+
+		// the distance between the two cores shrinks no faster than the cast moves, so stepping by the gap
+		// never passes through the collider
+		float t = 0.f;
+
+		for (size_t i = 0; i < options.maxIterations && t < cast.maxDistance; i++)
+		{
+			glm::vec3 shift = cast.direction * t;
+			glm::vec3 castCore, colliderCore;
+			ClosestPointsOnSegments(cast.a + shift, cast.b + shift, a, b, castCore, colliderCore);
+
+			glm::vec3 delta = castCore - colliderCore;
+			float distance = glm::length(delta);
+			float gap = distance - cast.radius - radius;
+
+			if (gap < options.hitDistance + options.hitDistanceScale * t)
+			{
+				// cores on top of each other have no direction between them, push against the cast
+				outHitResult.normal = distance > 1e-6f ? delta / distance : -cast.direction;
+				outHitResult.point = colliderCore + outHitResult.normal * radius;
+				outHitResult.distance = t;
+				return true;
+			}
+
+			t += gap;
+		}
+
+		return false;
+	}
+
+	bool CollideColliders(const Collider& first, const Collider& second, HitResult& outHitResult)
+	{
+		size_t firstType = size_t(first.GetType());
+		size_t secondType = size_t(second.GetType());
+
+		CollidePairFunction p_function = nullptr;
+		if (firstType < colliderTypeCount && secondType < colliderTypeCount)
+			p_function = pairFunctions[firstType][secondType];
+
+		if (p_function != nullptr)
+			return p_function(first, second, outHitResult);
+
+		return CollideBySDF(first, second, outHitResult);
+	}
+}
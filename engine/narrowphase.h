@@ -0,0 +1,35 @@
+#pragma once
+#include "collider.h"
+#include "sdf_raycast.h"
+
+namespace Engine
+{
+	// contact between two colliders in the convention of Collider::IntersectsSDF, the normal points from the
+	// second collider towards the first, the point lies on the surface of the second and the distance is the
+	// overlap
+	typedef bool (*CollidePairFunction)(const Collider& first, const Collider& second, HitResult& outHitResult);
+
+	// closed form contacts for the pairs of shapes with a known solution
+	bool CollideSpheres(const Collider& first, const Collider& second, HitResult& outHitResult);
+	bool CollideSphereCapsule(const Collider& first, const Collider& second, HitResult& outHitResult);
+	bool CollideCapsuleSphere(const Collider& first, const Collider& second, HitResult& outHitResult);
+	bool CollideCapsules(const Collider& first, const Collider& second, HitResult& outHitResult);
+	// marches the first collider through the sdf of the second, works for any pair
+	bool CollideBySDF(const Collider& first, const Collider& second, HitResult& outHitResult);
+
+	// looks the pair up in a table by collider type, pairs without a closed form use CollideBySDF
+	bool CollideColliders(const Collider& first, const Collider& second, HitResult& outHitResult);
+
+	// sweeps the cast against the collider with the result of ShapeCastSDF, spheres and capsules step by the
+	// exact distance between the cast and their core, other colliders are traced through their sdf
+	bool ShapeCastCollider(const ShapeCast& cast, const Collider& collider, HitResult& outHitResult, const RaycastOptions& options = RaycastOptions());
+
+	// closest points between the segments p1 q1 and p2 q2
+	void ClosestPointsOnSegments(
+		const glm::vec3& p1,
+		const glm::vec3& q1,
+		const glm::vec3& p2,
+		const glm::vec3& q2,
+		glm::vec3& outPoint1,
+		glm::vec3& outPoint2);
+}
@@ -1,360 +1,1108 @@
 #include "physics_world.h"
-#include <map>
-#include <gtx/matrix_cross_product.hpp>
+#include "narrowphase.h"
+#include <algorithm>
 
 namespace Engine
 {
+	bool ShouldCollide(const CollisionFilter& a, const CollisionFilter& b)
+	{
+		return (a.category & b.mask) != 0 && (b.category & a.mask) != 0;
+	}
+
+	// distance from the center of mass to the furthest point of the collider
+	static float ColliderReach(const Collider& collider)
+	{
+		return glm::length(glm::vec3(collider.localMatrix[3])) + collider.BoundingRadius();
+	}
+
+	static float RotationAngle(const glm::quat& from, const glm::quat& to)
+	{
+		return 2.f * glm::acos(glm::min(glm::abs(glm::dot(from, to)), 1.f));
+	}
+
+	// bodies that do not move this step, pairs of them are skipped
+	static bool IsResting(const Rigidbody& rigidbody)
+	{
+		switch (rigidbody.GetBodyType())
+		{
+		case BodyType::E_Static:
+			return true;
+		case BodyType::E_Kinematic:
+			return rigidbody.GetLinearVelocity() == glm::vec3(0.f) && rigidbody.GetAngularVelocity() == glm::vec3(0.f);
+		default:
+			return rigidbody.IsSleeping();
+		}
+	}
+
+	// awake dynamic bodies, the only ones that are integrated, touch the world and take part in islands
+	static bool IsSimulated(const Rigidbody& rigidbody)
+	{
+		return rigidbody.GetBodyType() == BodyType::E_Dynamic && !rigidbody.IsSleeping();
+	}
+
+	// kinematic bodies can also be moved by hand, so they are refreshed even without velocity
+	static bool CanMove(const Rigidbody& rigidbody)
+	{
+		return rigidbody.GetBodyType() != BodyType::E_Static && !rigidbody.IsSleeping();
+	}
+
+	// pairs of static and kinematic bodies can not push each other
+	static bool CanPush(const Rigidbody& first, const Rigidbody& second)
+	{
+		return first.GetBodyType() == BodyType::E_Dynamic || second.GetBodyType() == BodyType::E_Dynamic;
+	}
+
 	PhysicsWorld::PhysicsWorld() :
-		worldSDF(nullptr),
+		worldSDF(),
 		worldPhysicsMaterial({0.f, 0.f}),
-		gravity(0.f)
+		staticRevision(0),
+		p_jobSystem(nullptr),
+		simulationTime(0.0),
+		gravity(0.f),
+		broadphaseType(BroadphaseType::E_SweepAndPrune),
+		gridCellSize(0.f),
+		narrowphaseChunkSize(16),
+		worldQueryBatchSize(256),
+		raycastBatchSize(256),
+		solverIterationCount(10),
+		worldManifoldSize(3),
+		allowSleeping(true),
+		sleepLinearVelocity(0.05f),
+		sleepAngularVelocity(0.05f),
+		timeToSleep(0.5f),
+		cacheWorldDistances(true),
+		worldSurfaceSpeed(0.f),
+		worldLipschitzBound(1.f),
+		ccdMotionThreshold(0.5f),
+		ccdTolerance(0.01f),
+		ccdMaxIterations(32)
 	{}
 
-	void PhysicsWorld::FindAabbIntersections()
+	PhysicsObjectHandle PhysicsWorld::HandleOfSlot(uint32_t slot) const
 	{
-		aabbIntersections.clear();
+		return { slot, slotGenerations[slot] };
+	}
 
-		constexpr size_t sweepAxis = 0;
-		constexpr size_t secondaryAxis1 = 1;
-		constexpr size_t secondaryAxis2 = 2;
+	void PhysicsWorld::UpdateColliderTransform(PhysicsObject& object)
+	{
+		glm::mat4 rbWorldMatrix = glm::mat4_cast(object.rigidbody.GetRotation());
+		rbWorldMatrix[3] = glm::vec4(object.rigidbody.GetCenterOfMass(), 1.f);
 
-		std::multimap<float, EventPoint> events;
-		std::unordered_map<size_t, EventPoint*> activeSet;// key = event point's pair-id
+		object.p_collider->worldMatrix = rbWorldMatrix * object.p_collider->localMatrix;
+		object.p_collider->UpdateWorldAABB();
+	}
 
-		// sort "events" (where an aabb has a min or max value on the axis)
-		// inserting into map based on distance on axis grants sorted order
-		// insertion should be log(N)
-		size_t pairId = 0;
-		for (PhysicsObject& object : objects)
+	void PhysicsWorld::AddBroadphaseProxy(uint32_t slot)
+	{
+		const PhysicsObject& object = objects[slotToDense[slot]];
+		const AABB& aabb = object.p_collider->worldAABB;
+		slotIsStatic[slot] = object.rigidbody.GetBodyType() == BodyType::E_Static;
+
+		if (slotIsStatic[slot])
+		{
+			treeProxyIds[slot] = staticTree.CreateProxy(aabb, slot);
+			return;
+		}
+
+		broadphase.AddProxy(slot, aabb);
+		hashGrid.AddProxy(slot, aabb);
+		treeProxyIds[slot] = aabbTree.CreateProxy(aabb, slot);
+	}
+
+	void PhysicsWorld::RemoveBroadphaseProxy(uint32_t slot)
+	{
+		if (slotIsStatic[slot])
+			staticTree.DestroyProxy(treeProxyIds[slot]);
+		else
 		{
-			events.insert({ object.p_collider->worldAABB.min[sweepAxis], {EventPoint::Type::E_Start, pairId, &object} });
-			events.insert({ object.p_collider->worldAABB.max[sweepAxis], {EventPoint::Type::E_End, pairId, &object} });
-			pairId++;
+			broadphase.RemoveProxy(slot);
+			hashGrid.RemoveProxy(slot);
+			aabbTree.DestroyProxy(treeProxyIds[slot]);
 		}
 
-		// move plane from min to max and find overlaps in the axis direction
-		for (auto eventItr = events.begin(); eventItr != events.end(); eventItr++)
+		treeProxyIds[slot] = AabbTree::nullNode;
+	}
+
+	void PhysicsWorld::SyncStaticObjects()
+	{
+		if (rigidbodies.GetStaticRevision() == staticRevision)
+			return;
+
+		staticRevision = rigidbodies.GetStaticRevision();
+
+		// some static body moved or a body changed type, this is rare so all static objects are refreshed
+		for (size_t i = 0; i < objects.size(); i++)
 		{
-			size_t nextPairId = eventItr->second.pairId;
-			EventPoint* p_nextEvent = &eventItr->second;
+			uint32_t slot = denseToSlot[i];
+			bool isStatic = objects[i].rigidbody.GetBodyType() == BodyType::E_Static;
+
+			if (!isStatic && !slotIsStatic[slot])
+				continue;
+
+			UpdateColliderTransform(objects[i]);
 
-			if (p_nextEvent->type == EventPoint::Type::E_End)
-				activeSet.erase(nextPairId);
+			if (isStatic != slotIsStatic[slot])
+			{
+				RemoveBroadphaseProxy(slot);
+				AddBroadphaseProxy(slot);
+			}
 			else
+				staticTree.MoveProxy(treeProxyIds[slot], objects[i].p_collider->worldAABB, glm::vec3(0.f));
+		}
+	}
+
+	void PhysicsWorld::UpdateBroadphaseProxies(float deltaTime)
+	{
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			// sleeping and static bodies have not moved
+			if (!CanMove(objects[i].rigidbody))
+				continue;
+
+			uint32_t slot = denseToSlot[i];
+			const AABB& aabb = objects[i].p_collider->worldAABB;
+			broadphase.UpdateProxy(slot, aabb);
+			hashGrid.UpdateProxy(slot, aabb);
+
+			// the tree is kept up to date in every mode since scene queries walk it
+			aabbTree.MoveProxy(treeProxyIds[slot], aabb, objects[i].rigidbody.GetLinearVelocity() * deltaTime);
+		}
+	}
+
+	void PhysicsWorld::FindAabbIntersections()
+	{
+		aabbIntersections.clear();
+
+		if (broadphaseType == BroadphaseType::E_AabbTree)
+		{
+			for (size_t i = 0; i < objects.size(); i++)
 			{
-				for (auto& active : activeSet)
+				// resting bodies can not touch each other, their pairs with moving bodies are found from the moving side
+				if (IsResting(objects[i].rigidbody))
+					continue;
+
+				const AABB& aabb = objects[i].p_collider->worldAABB;
+
+				aabbTree.Query(aabb, [&](uint32_t otherSlot)
 				{
-					EventPoint* p_activeEvent = active.second;
-
-					if (p_activeEvent->p_object == p_nextEvent->p_object)
-						continue;// ignore self
-
-					// perform aabb vs aabb check along the remaining axis
-					const AABB& aabb1 = p_activeEvent->p_object->p_collider->worldAABB;
-					const AABB& aabb2 = p_nextEvent->p_object->p_collider->worldAABB;
-					if (aabb1.min[secondaryAxis1] <= aabb2.max[secondaryAxis1] && aabb1.max[secondaryAxis1] >= aabb2.min[secondaryAxis1] &&
-						aabb1.min[secondaryAxis2] <= aabb2.max[secondaryAxis2] && aabb1.max[secondaryAxis2] >= aabb2.min[secondaryAxis2])
-					{
-						aabbIntersections.push_back({
-							p_activeEvent->p_object,
-							p_nextEvent->p_object,
-						});
-					}
-				}
-
-				activeSet.insert({ p_nextEvent->pairId, p_nextEvent });
+					// only report each pair once, and only when the tight aabbs overlap
+					uint32_t otherIndex = slotToDense[otherSlot];
+					const PhysicsObject& other = objects[otherIndex];
+					bool reportHere = otherIndex > i || IsResting(other.rigidbody);
+					if (!reportHere || otherIndex == i || !ShouldCollide(objects[i].collisionFilter, other.collisionFilter))
+						return;
+
+					if (CanPush(objects[i].rigidbody, other.rigidbody) && AabbOverlaps(aabb, other.p_collider->worldAABB))
+						aabbIntersections.push_back({ uint32_t(i), otherIndex });
+				});
 			}
+
+			FindStaticIntersections();
+			return;
+		}
+
+		const std::vector<BroadphasePair>* p_pairs = nullptr;
+
+		if (broadphaseType == BroadphaseType::E_SpatialHashGrid)
+		{
+			hashGrid.cellSize = gridCellSize;
+			hashGrid.Update();
+			p_pairs = &hashGrid.GetPairs();
+		}
+		else
+		{
+			// the broadphase keeps its sorted endpoints between steps, the pairs are swept again
+			broadphase.Update();
+			p_pairs = &broadphase.GetPairs();
+		}
+
+		for (const BroadphasePair& pair : *p_pairs)
+		{
+			uint32_t firstIndex = slotToDense[pair.firstId];
+			uint32_t secondIndex = slotToDense[pair.secondId];
+
+			const PhysicsObject& first = objects[firstIndex];
+			const PhysicsObject& second = objects[secondIndex];
+
+			if (ShouldCollide(first.collisionFilter, second.collisionFilter) && CanPush(first.rigidbody, second.rigidbody))
+				aabbIntersections.push_back({ firstIndex, secondIndex });
 		}
+
+		FindStaticIntersections();
 	}
 
-	glm::mat3 MakeContactMatrix(const glm::vec3& hitNormal)
+	void PhysicsWorld::FindStaticIntersections()
 	{
-		glm::vec3 tangent1, tangent2;
-
-		if (glm::abs(hitNormal.x) > glm::abs(hitNormal.y))
+		// static objects are only tested against awake dynamic ones, so they never pair among themselves
+		for (size_t i = 0; i < objects.size(); i++)
 		{
-			float scale = 1.f / glm::sqrt(hitNormal.z * hitNormal.z + hitNormal.x * hitNormal.x);
+			if (!IsSimulated(objects[i].rigidbody))
+				continue;
 
-			tangent1.x = hitNormal.z * scale;
-			tangent1.y = 0.f;
-			tangent1.z = -hitNormal.x * scale;
+			const AABB& aabb = objects[i].p_collider->worldAABB;
 
-			tangent2.x = hitNormal.y * tangent1.x;
-			tangent2.y = hitNormal.z * tangent1.x - hitNormal.x * tangent1.z;
-			tangent2.z = -hitNormal.y * tangent1.x;
+			staticTree.Query(aabb, [&](uint32_t staticSlot)
+			{
+				uint32_t staticIndex = slotToDense[staticSlot];
+				const PhysicsObject& other = objects[staticIndex];
+
+				if (ShouldCollide(objects[i].collisionFilter, other.collisionFilter) && AabbOverlaps(aabb, other.p_collider->worldAABB))
+					aabbIntersections.push_back({ uint32_t(i), staticIndex });
+			});
+		}
+	}
+
+	void PhysicsWorld::Init(const SDF& _worldSDF, const PhysicsMaterial& _worldPhysicsMaterial, JobSystem* _p_jobSystem)
+	{
+		worldSDF = _worldSDF;
+		worldPhysicsMaterial = _worldPhysicsMaterial;
+
+		// the world sdf is evaluated from job threads, so it has to be safe to call concurrently
+		p_jobSystem = _p_jobSystem;
+	}
+
+	Rigidbody PhysicsWorld::CreateRigidbody()
+	{
+		return rigidbodies.Create();
+	}
+
+	void PhysicsWorld::DestroyRigidbody(const Rigidbody& rigidbody)
+	{
+		rigidbodies.Destroy(rigidbody);
+	}
+
+	PhysicsObjectHandle PhysicsWorld::AddObject(
+		Collider* p_collider,
+		const Rigidbody& rigidbody,
+		const PhysicsMaterial& physicsMaterial,
+		const CollisionFilter& collisionFilter)
+	{
+		uint32_t slot;
+		if (!freeSlots.empty())
+		{
+			slot = freeSlots.back();
+			freeSlots.pop_back();
 		}
 		else
 		{
-			float scale = 1.f / glm::sqrt(hitNormal.z * hitNormal.z + hitNormal.y * hitNormal.y);
+			slot = uint32_t(slotToDense.size());
+			slotToDense.push_back(0);
+			slotGenerations.push_back(1);
+			treeProxyIds.push_back(AabbTree::nullNode);
+			slotIsStatic.push_back(false);
+			worldDistances.emplace_back();
+		}
+
+		slotToDense[slot] = uint32_t(objects.size());
+		denseToSlot.push_back(slot);
+		objects.push_back({ p_collider, rigidbody, physicsMaterial, collisionFilter });
+
+		// objects added after Start need their collider placed before the first step
+		UpdateColliderTransform(objects.back());
 
-			tangent1.x = 0.f;
-			tangent1.y = -hitNormal.z * scale;
-			tangent1.z = hitNormal.y * scale;
+		AddBroadphaseProxy(slot);
+		worldDistances[slot] = { 0.f, glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), 0.0, false };
 
-			tangent2.x = hitNormal.y * tangent1.z - hitNormal.z * tangent1.y;
-			tangent2.y = -hitNormal.x * tangent1.z;
-			tangent2.z = hitNormal.x * tangent1.y;
+		return HandleOfSlot(slot);
+	}
+
+	void PhysicsWorld::AddObjects(const PhysicsObject* p_objects, size_t objectCount, PhysicsObjectHandle* p_outHandles)
+	{
+		ReserveObjects(objects.size() + objectCount);
+
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			const PhysicsObject& object = p_objects[i];
+			p_outHandles[i] = AddObject(object.p_collider, object.rigidbody, object.physicsMaterial, object.collisionFilter);
 		}
+	}
+
+	void PhysicsWorld::RemoveObject(const PhysicsObjectHandle& handle)
+	{
+		if (!IsValid(handle))
+			return;
+
+		uint32_t slot = handle.slot;
+		RemoveBroadphaseProxy(slot);
+
+		// swap and pop
+		uint32_t index = slotToDense[slot];
+		uint32_t lastSlot = denseToSlot.back();
+		objects[index] = objects.back();
+		denseToSlot[index] = lastSlot;
+		slotToDense[lastSlot] = index;
+		objects.pop_back();
+		denseToSlot.pop_back();
+
+		// stale handles no longer match, zero is skipped when the generation wraps
+		slotGenerations[slot]++;
+		if (slotGenerations[slot] == 0)
+			slotGenerations[slot] = 1;
+
+		releasedSlots.push_back(slot);
+	}
+
+	void PhysicsWorld::RemoveObjects(const PhysicsObjectHandle* p_handles, size_t handleCount)
+	{
+		for (size_t i = 0; i < handleCount; i++)
+			RemoveObject(p_handles[i]);
+	}
 
-		return glm::mat3(
-			hitNormal,
-			tangent1,
-			tangent2
-		);
+	void PhysicsWorld::ReserveObjects(size_t objectCount)
+	{
+		objects.reserve(objectCount);
+		denseToSlot.reserve(objectCount);
+		slotToDense.reserve(objectCount);
+		slotGenerations.reserve(objectCount);
+		slotIsStatic.reserve(objectCount);
+		treeProxyIds.reserve(objectCount);
+		worldDistances.reserve(objectCount);
+	}
+
+	bool PhysicsWorld::IsValid(const PhysicsObjectHandle& handle) const
+	{
+		return handle.generation != 0 && handle.slot < slotGenerations.size() && slotGenerations[handle.slot] == handle.generation;
 	}
 
-	glm::vec3 PhysicsWorld::CalculateImpulseResponse(
-		const glm::vec3& hitPoint,
-		const glm::vec3& hitNormal,
-		const Rigidbody* p_firstRb,
-		const Rigidbody* p_optionalSecondRb,
-		const PhysicsMaterial& firstPhysicsMat,
-		const PhysicsMaterial& secondPhysicsMat
-	)
+	PhysicsObject* PhysicsWorld::GetPhysicsObject(const PhysicsObjectHandle& handle)
 	{
-		float restitution = firstPhysicsMat.restitution * secondPhysicsMat.restitution;
-		float friction = 0.5f * (firstPhysicsMat.friction + secondPhysicsMat.friction);
+		return IsValid(handle) ? &objects[slotToDense[handle.slot]] : nullptr;
+	}
 
-		glm::mat3 contactToWorld(MakeContactMatrix(hitNormal));
-		glm::mat3 worldToContact(glm::transpose(contactToWorld));
-		glm::vec3 relativePoint[2]{
-			hitPoint - p_firstRb->centerOfMass,
-			glm::vec3(0.f)
+	size_t PhysicsWorld::GetObjectCount() const
+	{
+		return objects.size();
+	}
+
+	PhysicsObjectHandle PhysicsWorld::RaycastObjects(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitResult& outHitResult, Collider* p_ignore)
+	{
+		PhysicsObjectHandle closestObject = { 0, 0 };
+		float closestDistance = maxDistance;
+
+		auto testObject = [&](uint32_t slot, float)
+		{
+			PhysicsObject& object = objects[slotToDense[slot]];
+			if (object.p_collider == p_ignore)
+				return closestDistance;
+
+			HitResult hit;
+			if (object.p_collider->IntersectsRay(origin, direction, hit) && hit.distance < closestDistance)
+			{
+				outHitResult = hit;
+				closestObject = HandleOfSlot(slot);
+				closestDistance = hit.distance;
+			}
+
+			return closestDistance;
 		};
-		glm::vec3 angularVel[2]{
-			p_firstRb->angularVelocity,
-			glm::vec3(0.f)
+
+		aabbTree.Raycast(origin, direction, maxDistance, testObject);
+		staticTree.Raycast(origin, direction, closestDistance, testObject);
+
+		return closestObject;
+	}
+
+	bool PhysicsWorld::RaycastWorld(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		HitResult& outHitResult,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		return RaycastSDF(worldSDF, origin, direction, maxDistance, outHitResult, options, p_outStats);
+	}
+
+	size_t PhysicsWorld::RaycastWorld(
+		const glm::vec3* p_origins,
+		const glm::vec3* p_directions,
+		const float* p_maxDistances,
+		size_t rayCount,
+		HitResult* p_outHitResults,
+		bool* p_outHits,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		RunQueryBatches(rayCount, [&](size_t begin, size_t count)
+		{
+			RaycastSDF(
+				worldSDF,
+				p_origins + begin,
+				p_directions + begin,
+				p_maxDistances + begin,
+				count,
+				p_outHitResults + begin,
+				p_outHits + begin,
+				options,
+				p_outStats != nullptr ? p_outStats + begin : nullptr);
+		});
+
+		size_t hitCount = 0;
+		for (size_t i = 0; i < rayCount; i++)
+			hitCount += p_outHits[i] ? 1 : 0;
+
+		return hitCount;
+	}
+
+	bool PhysicsWorld::ShapeCastWorld(
+		const ShapeCast& cast,
+		HitResult& outHitResult,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		return ShapeCastSDF(worldSDF, cast, outHitResult, options, p_outStats);
+	}
+
+	size_t PhysicsWorld::ShapeCastWorld(
+		const ShapeCast* p_casts,
+		size_t castCount,
+		HitResult* p_outHitResults,
+		bool* p_outHits,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		RunQueryBatches(castCount, [&](size_t begin, size_t count)
+		{
+			ShapeCastSDF(
+				worldSDF,
+				p_casts + begin,
+				count,
+				p_outHitResults + begin,
+				p_outHits + begin,
+				options,
+				p_outStats != nullptr ? p_outStats + begin : nullptr);
+		});
+
+		size_t hitCount = 0;
+		for (size_t i = 0; i < castCount; i++)
+			hitCount += p_outHits[i] ? 1 : 0;
+
+		return hitCount;
+	}
+
+	PhysicsObjectHandle PhysicsWorld::ShapeCastObjects(
+		const ShapeCast& cast,
+		HitResult& outHitResult,
+		Collider* p_ignore,
+		const RaycastOptions& options)
+	{
+		PhysicsObjectHandle closestObject = { 0, 0 };
+		float closestDistance = cast.maxDistance;
+
+		AABB castAABB;
+		castAABB.min = glm::min(cast.a, cast.b) - glm::vec3(cast.radius);
+		castAABB.max = glm::max(cast.a, cast.b) + glm::vec3(cast.radius);
+
+		auto testObject = [&](uint32_t slot, float)
+		{
+			const PhysicsObject& object = objects[slotToDense[slot]];
+			if (object.p_collider == p_ignore)
+				return closestDistance;
+
+			ShapeCast shortenedCast = cast;
+			shortenedCast.maxDistance = closestDistance;
+
+			HitResult hit;
+			if (ShapeCastCollider(shortenedCast, *object.p_collider, hit, options) && hit.distance < closestDistance)
+			{
+				outHitResult = hit;
+				closestObject = HandleOfSlot(slot);
+				closestDistance = hit.distance;
+			}
+
+			return closestDistance;
 		};
-		glm::vec3 pointVel[2]{
-			(p_firstRb->linearVelocity + glm::cross(angularVel[0], relativePoint[0])),
-			glm::vec3(0.f)
+
+		aabbTree.Sweep(castAABB, cast.direction, closestDistance, testObject);
+		staticTree.Sweep(castAABB, cast.direction, closestDistance, testObject);
+
+		return closestObject;
+	}
+
+	void PhysicsWorld::ShapeCastObjects(
+		const ShapeCast* p_casts,
+		size_t castCount,
+		PhysicsObjectHandle* p_outObjects,
+		HitResult* p_outHitResults,
+		Collider* p_ignore,
+		const RaycastOptions& options)
+	{
+		RunQueryBatches(castCount, [&](size_t begin, size_t count)
+		{
+			for (size_t i = begin; i < begin + count; i++)
+				p_outObjects[i] = ShapeCastObjects(p_casts[i], p_outHitResults[i], p_ignore, options);
+		});
+	}
+
+	void PhysicsWorld::RunQueryBatches(size_t queryCount, const std::function<void(size_t begin, size_t count)>& function)
+	{
+		const size_t batchCount = (queryCount + raycastBatchSize - 1) / raycastBatchSize;
+
+		auto runBatch = [&](size_t batch)
+		{
+			size_t begin = batch * raycastBatchSize;
+			function(begin, std::min(begin + raycastBatchSize, queryCount) - begin);
 		};
-		glm::vec3 relativeVel(pointVel[0]);
 
-		if (p_optionalSecondRb != nullptr)
+		if (p_jobSystem != nullptr && batchCount > 1)
+			p_jobSystem->ParallelFor(batchCount, 1, runBatch);
+		else
+		{
+			for (size_t batch = 0; batch < batchCount; batch++)
+				runBatch(batch);
+		}
+	}
+
+	void PhysicsWorld::InvalidateWorldDistances()
+	{
+		for (WorldDistanceCache& cache : worldDistances)
+			cache.valid = false;
+	}
+
+	void PhysicsWorld::InvalidateWorldDistances(const AABB& region)
+	{
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			// the cached distance can only reach into the region if the aabb grown by it overlaps
+			AABB reach = objects[i].p_collider->worldAABB;
+			WorldDistanceCache& cache = worldDistances[denseToSlot[i]];
+			reach.min -= glm::vec3(cache.distance);
+			reach.max += glm::vec3(cache.distance);
+
+			if (AabbOverlaps(reach, region))
+				cache.valid = false;
+		}
+	}
+
+	void PhysicsWorld::CollideObjects(size_t begin, size_t end, std::vector<Contact>& outContacts)
+	{
+		// object vs object
+		for (size_t i = begin; i < end; i++)
 		{
-			relativePoint[1] = hitPoint - p_optionalSecondRb->centerOfMass;
-			angularVel[1] = p_optionalSecondRb->angularVelocity;
-			pointVel[1] = p_optionalSecondRb->linearVelocity + glm::cross(angularVel[1], relativePoint[1]);
-			relativeVel = pointVel[0] - pointVel[1];
+			const AabbIntersection& intersection = aabbIntersections[i];
+			const PhysicsObject& first = objects[intersection.firstIndex];
+			const PhysicsObject& second = objects[intersection.secondIndex];
+
+			if (IsResting(first.rigidbody) && IsResting(second.rigidbody))
+				continue;
+
+			HitResult hit;
+			if (CollideColliders(*first.p_collider, *second.p_collider, hit))
+			{
+				uint32_t firstSlot = denseToSlot[intersection.firstIndex];
+				uint32_t secondSlot = denseToSlot[intersection.secondIndex];
+
+				outContacts.push_back(MakeContact(first, second.rigidbody, second.physicsMaterial, firstSlot, secondSlot, hit));
+			}
 		}
+	}
 
-		// transform relative velocity to contact space
-		glm::vec3 contactVel = worldToContact * relativeVel;
-		float desiredNormalVelocity = -contactVel.x * (1.f + restitution);
+	void PhysicsWorld::QueueWorldTest(size_t objectIndex)
+	{
+		const PhysicsObject& object = objects[objectIndex];
+		if (!IsSimulated(object.rigidbody) || (object.collisionFilter.mask & CollisionFilter::E_World) == 0)
+			return;
 
-		float totalInverseMass = p_firstRb->inverseMass;
+		if (cacheWorldDistances && IsClearOfWorld(objectIndex))
+			return;
 
-		// build matrix that converts a unit of impulse to a unit of torque
-		glm::mat3 impulseToTorque(glm::matrixCross3(relativePoint[0]));
+		worldQueryObjects.push_back(uint32_t(objectIndex));
+	}
 
-		// build a matrix that converts an impulse in contact-space to a change in velocity in world-space
-		glm::mat3 deltaVelWorld(impulseToTorque);
-		deltaVelWorld *= p_firstRb->worldInverseInertiaTensor;
-		deltaVelWorld *= impulseToTorque;
-		deltaVelWorld *= -1.f;
+	void PhysicsWorld::CollideWithWorld(std::vector<Contact>& outContacts)
+	{
+		// object vs world for all queued objects at once, the points of every collider are gathered so
+		// the world sdf is evaluated in large batches, once for the colliders and once for the normals
+		worldQueries.clear();
+		worldQueryPoints.clear();
 
-		if (p_optionalSecondRb != nullptr)
+		for (uint32_t objectIndex : worldQueryObjects)
 		{
-			// do the same procedure for the second rigidbody and add result to deltaVelWorld
-			impulseToTorque = glm::matrixCross3(relativePoint[1]);
-			glm::mat3 deltaVelWorld2(impulseToTorque);
-			deltaVelWorld2 *= p_optionalSecondRb->worldInverseInertiaTensor;
-			deltaVelWorld2 *= impulseToTorque;
-			deltaVelWorld2 *= -1.f;
+			const Collider& collider = *objects[objectIndex].p_collider;
+			uint32_t firstPoint = uint32_t(worldQueryPoints.size());
+			uint32_t pointCount = uint32_t(collider.GetSdfQueryPointCount());
 
-			deltaVelWorld += deltaVelWorld2;
-			totalInverseMass += p_optionalSecondRb->inverseMass;
+			worldQueryPoints.resize(firstPoint + pointCount);
+			collider.GetSdfQueryPoints(&worldQueryPoints[firstPoint]);
+
+			WorldQuery query;
+			query.objectIndex = objectIndex;
+			query.firstPoint = firstPoint;
+			query.pointCount = pointCount;
+			query.endCount = 0;
+			worldQueries.push_back(query);
 		}
 
-		// create a contact-space version of the deltaVelWorld
-		glm::mat3 deltaVelContact(worldToContact);
-		deltaVelContact *= deltaVelWorld;
-		deltaVelContact *= contactToWorld;
+		EvaluateWorldQueries(false);
+
+		// every measured distance refreshes the cache, the objects touching the world are kept
+		size_t hitCount = 0;
+		for (const WorldQuery& query : worldQueries)
+		{
+			const PhysicsObject& object = objects[query.objectIndex];
+			const glm::vec3* p_points = &worldQueryPoints[query.firstPoint];
+			const float* p_distances = &worldQueryDistances[query.firstPoint];
+
+			// between two neighbouring points the sdf can not drop below the point where their distance
+			// bounds meet, which the lipschitz bound brings closer
+			size_t closest = 0;
+			float bound = p_distances[0];
+
+			for (size_t k = 1; k < query.pointCount; k++)
+			{
+				float step = glm::distance(p_points[k - 1], p_points[k]);
+				bound = glm::min(bound, glm::min(p_distances[k], 0.5f * (p_distances[k - 1] + p_distances[k] - worldLipschitzBound * step)));
+
+				if (p_distances[k] < p_distances[closest])
+					closest = k;
+			}
+
+			float radius = object.p_collider->GetSdfQueryRadius();
+			worldDistances[denseToSlot[query.objectIndex]] = {
+				glm::max(bound - radius, 0.f),
+				object.rigidbody.GetCenterOfMass(),
+				object.rigidbody.GetRotation(),
+				simulationTime,
+				true
+			};
+
+			if (p_distances[closest] > radius)
+				continue;
 
-		// the change in linear velocity for a unit impulse is the sum of the inverse masses
-		deltaVelContact[0][0] += totalInverseMass;
-		deltaVelContact[1][1] += totalInverseMass;
-		deltaVelContact[2][2] += totalInverseMass;
+			WorldQuery& hitQuery = worldQueries[hitCount++];
+			hitQuery = query;
+			hitQuery.closestIndex = uint32_t(closest);
+			hitQuery.closestPoint = p_points[closest];
+			hitQuery.closestDistance = p_distances[closest];
 
-		// inverting gives matrix that converts from unit velocity to impulse in contact-space
-		glm::mat3 impulseMatrix(glm::inverse(deltaVelContact));
+			// the ends of a capsule resting on the world touch it as well as the closest point, taking them
+			// from the distances already measured keeps it from rocking around a single contact, the points
+			// are overwritten by the normal taps below, so they are copied out here
+			const size_t ends[2] = { 0, query.pointCount - 1 };
+			for (size_t end : ends)
+			{
+				if (hitQuery.endCount + 1 >= worldManifoldSize || end == closest || p_distances[end] > radius)
+					continue;
 
-		// contact-space point-velocity we want to subtract by applying impulse
-		// we want to make the point stand still in the contact plane and bounce back in the normal direction
-		glm::vec3 subtractVel(
-			desiredNormalVelocity,
-			-contactVel.y,
-			-contactVel.z
-		);
+				hitQuery.endIndices[hitQuery.endCount] = uint32_t(end);
+				hitQuery.endPoints[hitQuery.endCount] = p_points[end];
+				hitQuery.endDistances[hitQuery.endCount] = p_distances[end];
+				hitQuery.endCount++;
+			}
+		}
 
-		// calculate the contact-space impulse needed to produce the velocity subtraction
- 		glm::vec3 contactImpulse(impulseMatrix * subtractVel);
+		worldQueries.resize(hitCount);
 
-		// calculate the length of the impulse in the contact plane
-		float planarImpulse = glm::sqrt(
-			contactImpulse.y * contactImpulse.y +
-			contactImpulse.z * contactImpulse.z
-		);
+		// a world sdf with a gradient gives the normals in one run per point, the others need the taps
+		bool useGradients = worldSDF.HasGradient();
+		size_t pointsPerHit = useGradients ? 1 : normalTapCount;
+		worldQueryPoints.resize(hitCount * pointsPerHit);
 
-		// check if the planar component of the impulse exceeds the static friction limit
-		// if it does, we change the impulse to simulate dynamic friction
-		if (planarImpulse > glm::abs(contactImpulse.x) * friction)
+		for (size_t i = 0; i < hitCount; i++)
 		{
-			contactImpulse.y /= planarImpulse;
-			contactImpulse.z /= planarImpulse;
-		
-			contactImpulse.x = deltaVelContact[0][0] +
-				deltaVelContact[0][1] * friction * contactImpulse.y +
-				deltaVelContact[0][2] * friction * contactImpulse.z;
-			contactImpulse.x = desiredNormalVelocity / contactImpulse.x;
-			contactImpulse.y *= friction * contactImpulse.x;
-			contactImpulse.z *= friction * contactImpulse.x;
+			if (useGradients)
+				worldQueryPoints[i] = worldQueries[i].closestPoint;
+			else
+				GetNormalTaps(worldQueries[i].closestPoint, &worldQueryPoints[i * normalTapCount]);
 		}
 
-		// convert back to world space
-		glm::vec3 impulse = contactToWorld * contactImpulse;
+		EvaluateWorldQueries(useGradients);
+
+		for (size_t i = 0; i < hitCount; i++)
+		{
+			const WorldQuery& query = worldQueries[i];
+			const PhysicsObject& object = objects[query.objectIndex];
+
+			uint32_t slot = denseToSlot[query.objectIndex];
+			float radius = object.p_collider->GetSdfQueryRadius();
+
+			// the query point index tells the contacts apart, so warm starting follows each of them
+			HitResult hit;
+			hit.normal = useGradients ? glm::normalize(worldQueryGradients[i]) : NormalFromTaps(&worldQueryDistances[i * normalTapCount]);
+			hit.point = query.closestPoint - hit.normal * query.closestDistance;
+			hit.distance = radius - query.closestDistance;// distance = overlap
+
+			outContacts.push_back(MakeContact(object, Rigidbody(), worldPhysicsMaterial, slot, worldUserId, hit, query.closestIndex));
+
+			for (uint32_t k = 0; k < query.endCount; k++)
+			{
+				hit.point = query.endPoints[k] - hit.normal * query.endDistances[k];
+				hit.distance = radius - query.endDistances[k];
 
-		return impulse;
+				outContacts.push_back(MakeContact(object, Rigidbody(), worldPhysicsMaterial, slot, worldUserId, hit, query.endIndices[k]));
+			}
+		}
 	}
 
-	void PhysicsWorld::Init(float(*_worldSDF)(const glm::vec3&), const PhysicsMaterial& _worldPhysicsMaterial)
+	void PhysicsWorld::EvaluateWorldQueries(bool withGradients)
 	{
-		worldSDF = _worldSDF;
-		worldPhysicsMaterial = _worldPhysicsMaterial;
+		const size_t pointCount = worldQueryPoints.size();
+		const size_t batchCount = (pointCount + worldQueryBatchSize - 1) / worldQueryBatchSize;
+		worldQueryDistances.resize(pointCount);
+
+		if (withGradients)
+			worldQueryGradients.resize(pointCount);
+
+		auto evaluateBatch = [&](size_t batch)
+		{
+			size_t begin = batch * worldQueryBatchSize;
+			size_t end = std::min(begin + worldQueryBatchSize, pointCount);
+
+			if (withGradients)
+				worldSDF.EvaluateGradients(&worldQueryPoints[begin], &worldQueryDistances[begin], &worldQueryGradients[begin], end - begin);
+			else
+				worldSDF.Evaluate(&worldQueryPoints[begin], &worldQueryDistances[begin], end - begin);
+		};
+
+		if (p_jobSystem != nullptr && batchCount > 1)
+			p_jobSystem->ParallelFor(batchCount, 1, evaluateBatch);
+		else
+		{
+			for (size_t batch = 0; batch < batchCount; batch++)
+				evaluateBatch(batch);
+		}
 	}
 
-	void PhysicsWorld::AddObject(Collider* p_collider, Rigidbody* p_rigidbody, const PhysicsMaterial& physicsMaterial)
+	bool PhysicsWorld::IsClearOfWorld(size_t objectIndex) const
 	{
-		objects.push_back({ p_collider, p_rigidbody, physicsMaterial });
+		const PhysicsObject& object = objects[objectIndex];
+		const WorldDistanceCache& cache = worldDistances[denseToSlot[objectIndex]];
+
+		if (!cache.valid)
+			return false;
+
+		// the distance shrinks by at most the lipschitz bound times how far any point of the collider and
+		// of the world surface has moved since it was measured, bodies touching the world have a distance
+		// of zero and are always tested
+		float travel =
+			glm::distance(object.rigidbody.GetCenterOfMass(), cache.centerOfMass) +
+			RotationAngle(cache.rotation, object.rigidbody.GetRotation()) * ColliderReach(*object.p_collider) +
+			worldSurfaceSpeed * float(simulationTime - cache.time);
+
+		return cache.distance - worldLipschitzBound * travel > 0.f;
 	}
 
-	PhysicsObject* PhysicsWorld::RaycastObjects(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitResult& outHitResult, Collider* p_ignore)
+	Contact PhysicsWorld::MakeContact(
+		const PhysicsObject& first,
+		const Rigidbody& secondRigidbody,
+		const PhysicsMaterial& secondPhysicsMaterial,
+		uint32_t firstSlot,
+		uint32_t secondSlot,
+		const HitResult& hit,
+		uint32_t feature
+	) const
 	{
-		PhysicsObject* p_closestObj = nullptr;
+		Contact contact;
+		contact.firstBody = first.rigidbody;
+		contact.secondBody = secondRigidbody;
+		contact.firstUserId = firstSlot;
+		contact.secondUserId = secondSlot;
+		contact.key = MakePairKey(firstSlot, secondSlot);
+		contact.feature = feature;
+		contact.point = hit.point;
+		contact.normal = hit.normal;
+		contact.penetration = hit.distance;
+		contact.restitution = first.physicsMaterial.restitution * secondPhysicsMaterial.restitution;
+		contact.friction = 0.5f * (first.physicsMaterial.friction + secondPhysicsMaterial.friction);
+		contact.impulse = glm::vec3(0.f);
+		contact.firstCorrection = glm::vec3(0.f);
+		contact.secondCorrection = glm::vec3(0.f);
 
-		for (PhysicsObject& object : objects)
+		return contact;
+	}
+
+	void PhysicsWorld::WakeTouchedIslands()
+	{
+		sleepingBeforeContacts.resize(slotToDense.size());
+		for (size_t i = 0; i < objects.size(); i++)
+			sleepingBeforeContacts[denseToSlot[i]] = objects[i].rigidbody.IsSleeping();
+
+		bool wokeAny = false;
+
+		for (const Contact& contact : contacts)
 		{
-			if (object.p_collider == p_ignore)
+			if (contact.secondUserId == worldUserId)
 				continue;
 
-			HitResult hit;
-			if (object.p_collider->IntersectsRay(origin, direction, hit) && hit.distance < maxDistance)
+			// an awake body touched a sleeping one, the whole island of the sleeping one wakes up
+			if (sleepingBeforeContacts[contact.firstUserId] || sleepingBeforeContacts[contact.secondUserId])
 			{
-				maxDistance = hit.distance;
-				outHitResult = hit;
-				p_closestObj = &object;
+				objects[slotToDense[contact.firstUserId]].rigidbody.WakeUp();
+				objects[slotToDense[contact.secondUserId]].rigidbody.WakeUp();
+				wokeAny = true;
 			}
 		}
 
-		return p_closestObj;
+		if (!wokeAny)
+			return;
+
+		// the woken bodies skipped the world test this step
+		worldQueryObjects.clear();
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (sleepingBeforeContacts[denseToSlot[i]] && !objects[i].rigidbody.IsSleeping())
+				QueueWorldTest(i);
+		}
+
+		CollideWithWorld(contacts);
 	}
 
-	bool PhysicsWorld::RaycastWorld(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitResult& outHitResult)
+	uint32_t PhysicsWorld::FindIslandRoot(uint32_t slot)
 	{
-		float t = 0.f;
+		while (islandParents[slot] != slot)
+		{
+			// path halving
+			islandParents[slot] = islandParents[islandParents[slot]];
+			slot = islandParents[slot];
+		}
+
+		return slot;
+	}
+
+	void PhysicsWorld::UpdateSleeping(float deltaTime)
+	{
+		if (!allowSleeping)
+			return;
+
+		rigidbodies.UpdateSleepTimers(deltaTime, sleepLinearVelocity, sleepAngularVelocity);
+
+		// bodies connected through contacts form an island, the world and static or kinematic bodies do
+		// not connect anything
+		islandParents.resize(slotToDense.size());
+		for (size_t slot = 0; slot < slotToDense.size(); slot++)
+			islandParents[slot] = uint32_t(slot);
+
+		for (const Contact& contact : contacts)
+		{
+			if (contact.secondUserId == worldUserId)
+				continue;
+
+			if (contact.firstBody.GetBodyType() != BodyType::E_Dynamic || contact.secondBody.GetBodyType() != BodyType::E_Dynamic)
+				continue;
+
+			uint32_t firstRoot = FindIslandRoot(contact.firstUserId);
+			uint32_t secondRoot = FindIslandRoot(contact.secondUserId);
+			if (firstRoot != secondRoot)
+				islandParents[firstRoot] = secondRoot;
+		}
+
+		// an island sleeps once its most recently moving body has been resting long enough
+		islandSleepTimes.assign(slotToDense.size(), timeToSleep);
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (!IsSimulated(objects[i].rigidbody))
+				continue;
+
+			uint32_t root = FindIslandRoot(denseToSlot[i]);
+			islandSleepTimes[root] = glm::min(islandSleepTimes[root], objects[i].rigidbody.GetSleepTime());
+		}
 
-		for (size_t i = 0; i < 100 && t < maxDistance; i++)
+		// group the bodies of the islands that fall asleep by root
+		islandMembers.clear();
+		for (size_t i = 0; i < objects.size(); i++)
 		{
-			glm::vec3 p = origin + direction * t;
-			float r = worldSDF(p);
+			if (!IsSimulated(objects[i].rigidbody))
+				continue;
+
+			uint32_t root = FindIslandRoot(denseToSlot[i]);
+			if (islandSleepTimes[root] >= timeToSleep)
+				islandMembers.push_back((uint64_t(root) << 32) | objects[i].rigidbody.GetId());
+		}
+
+		std::sort(islandMembers.begin(), islandMembers.end());
+
+		sleepingIds.clear();
+		for (size_t i = 0; i < islandMembers.size(); i++)
+		{
+			sleepingIds.push_back(uint32_t(islandMembers[i]));
 
-			if (r < 0.01f)
+			bool islandEnds = (i + 1 == islandMembers.size()) || (islandMembers[i + 1] >> 32) != (islandMembers[i] >> 32);
+			if (islandEnds)
 			{
-				outHitResult.point = p;
-				outHitResult.normal = CalcNormal(worldSDF, p);
-				outHitResult.distance = t;
-				return true;
+				rigidbodies.PutToSleep(sleepingIds.data(), sleepingIds.size());
+				sleepingIds.clear();
 			}
+		}
+	}
+
+	void PhysicsWorld::FindSweptBodies(float deltaTime)
+	{
+		sweptBodies.clear();
+
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			const Rigidbody& rigidbody = objects[i].rigidbody;
+			if (!rigidbody.IsContinuousCollisionEnabled() || !IsSimulated(rigidbody))
+				continue;
+
+			if ((objects[i].collisionFilter.mask & CollisionFilter::E_World) == 0)
+				continue;
 
-			t += r;
+			// slow bodies can not skip past the world surface, the regular contacts catch them
+			float motion = glm::length(rigidbody.GetLinearVelocity()) * deltaTime;
+			if (motion > ccdMotionThreshold * objects[i].p_collider->BoundingRadius())
+				sweptBodies.push_back({ uint32_t(i), rigidbody.GetCenterOfMass(), rigidbody.GetRotation() });
 		}
+	}
 
-		return false;
+	void PhysicsWorld::AdvanceToImpact(const SweptBody& sweptBody)
+	{
+		PhysicsObject& object = objects[sweptBody.objectIndex];
+		Collider& collider = *object.p_collider;
+
+		glm::vec3 endCenterOfMass = object.rigidbody.GetCenterOfMass();
+		glm::quat endRotation = object.rigidbody.GetRotation();
+
+		// no point of the collider moves further than this over the step, the angular part uses the
+		// reach of the collider from the center of mass
+		float motionBound =
+			glm::distance(sweptBody.startCenterOfMass, endCenterOfMass) +
+			RotationAngle(sweptBody.startRotation, endRotation) * ColliderReach(collider);
+
+		if (motionBound <= 0.f)
+			return;
+
+		auto placeAt = [&](float t)
+		{
+			glm::mat4 rbWorldMatrix = glm::mat4_cast(glm::slerp(sweptBody.startRotation, endRotation, t));
+			rbWorldMatrix[3] = glm::vec4(glm::mix(sweptBody.startCenterOfMass, endCenterOfMass, t), 1.f);
+			collider.worldMatrix = rbWorldMatrix * collider.localMatrix;
+		};
+
+		placeAt(0.f);
+		glm::vec3 closestPoint;
+		float dist = collider.DistanceToSDF(worldSDF, closestPoint, worldLipschitzBound);
+
+		// bodies already touching the world are handled by the regular contacts
+		if (dist < ccdTolerance)
+			return;
+
+		// conservative advancement, the collider can not reach the surface before it has moved the
+		// current distance over the lipschitz bound, so advancing by that over the motion bound is always safe
+		float t = 0.f;
+
+		for (size_t i = 0; i < ccdMaxIterations; i++)
+		{
+			t += dist / (motionBound * worldLipschitzBound);
+			if (t >= 1.f)
+				break;
+
+			placeAt(t);
+			dist = collider.DistanceToSDF(worldSDF, closestPoint, worldLipschitzBound);
+			if (dist < ccdTolerance)
+				break;
+		}
+
+		if (t <= 0.f || t >= 1.f)
+			return;
+
+		// the body is held at the last safe time and the rest of the step is dropped, running out of
+		// iterations before reaching the surface says nothing about the rest of the motion, so the body
+		// keeps its velocity and carries on from there next step
+		object.rigidbody.SetCenterOfMass(glm::mix(sweptBody.startCenterOfMass, endCenterOfMass, t));
+		object.rigidbody.SetRotation(glm::slerp(sweptBody.startRotation, endRotation, t));
+
+		if (dist >= ccdTolerance)
+			return;
+
+		// at the time of impact the velocity into the surface is removed so the next step does not start
+		// by passing through it
+		glm::vec3 normal = CalcNormal(worldSDF, closestPoint);
+		glm::vec3 velocity = object.rigidbody.GetLinearVelocity();
+		float normalVelocity = glm::dot(velocity, normal);
+
+		if (normalVelocity < 0.f)
+		{
+			float restitution = object.physicsMaterial.restitution * worldPhysicsMaterial.restitution;
+			object.rigidbody.SetLinearVelocity(velocity - (1.f + restitution) * normalVelocity * normal);
+		}
 	}
 
 	void PhysicsWorld::Start()
 	{
 		for (PhysicsObject& object : objects)
-		{
-			glm::mat4 rbWorldMatrix = glm::mat4_cast(object.p_rigidbody->rotation);
-			rbWorldMatrix[3] = glm::vec4(object.p_rigidbody->centerOfMass, 1.f);
+			UpdateColliderTransform(object);
 
-			object.p_collider->worldMatrix = rbWorldMatrix * object.p_collider->localMatrix;
-			object.p_collider->UpdateWorldAABB();
-		}
+		UpdateBroadphaseProxies(0.f);
 	}
 
 	void PhysicsWorld::Update(float deltaTime)
 	{
-		for (PhysicsObject& object : objects)
-			object.p_rigidbody->ApplyGravity(gravity, deltaTime);
+		SyncStaticObjects();
+		rigidbodies.ApplyGravity(gravity, deltaTime);
 
 		FindAabbIntersections();
 
-		collisions.clear();
+		// the narrowphase is split into fixed size chunks that jobs pick up in any order, each chunk
+		// writes to its own buffer and the buffers are merged in chunk order, so the result does not
+		// depend on the thread count or on scheduling
+		const size_t pairChunkCount = (aabbIntersections.size() + narrowphaseChunkSize - 1) / narrowphaseChunkSize;
 
-		// object vs object
-		for (AabbIntersection& intersection : aabbIntersections)
+		chunkContacts.resize(pairChunkCount);
+
+		auto collideChunk = [&](size_t chunk)
 		{
-			Collider* p_firstCollider = intersection.p_firstObject->p_collider;
-			Collider* p_secondCollider = intersection.p_secondObject->p_collider;
+			std::vector<Contact>& chunkBuffer = chunkContacts[chunk];
+			chunkBuffer.clear();
 
-			HitResult hit;
-			if (p_firstCollider->IntersectsSDF(p_secondCollider->sdf, hit))
-			{
-				glm::vec3 impulse = CalculateImpulseResponse(
-					hit.point,
-					hit.normal,
-					intersection.p_firstObject->p_rigidbody,
-					intersection.p_secondObject->p_rigidbody,
-					intersection.p_firstObject->physicsMaterial,
-					intersection.p_secondObject->physicsMaterial
-				);
-
-				glm::vec3 overlap = hit.normal * (hit.distance * 0.5f);
-
-				collisions.push_back({ intersection.p_firstObject, hit.point, impulse, overlap });
-				collisions.push_back({ intersection.p_secondObject, hit.point, -impulse, -overlap });
-			}
+			size_t begin = chunk * narrowphaseChunkSize;
+			CollideObjects(begin, std::min(begin + narrowphaseChunkSize, aabbIntersections.size()), chunkBuffer);
+		};
+
+		if (p_jobSystem != nullptr)
+			p_jobSystem->ParallelFor(pairChunkCount, 1, collideChunk);
+		else
+		{
+			for (size_t chunk = 0; chunk < pairChunkCount; chunk++)
+				collideChunk(chunk);
 		}
 
-		// object vs world
-		for (PhysicsObject& object : objects)
+		contacts.clear();
+		for (size_t chunk = 0; chunk < pairChunkCount; chunk++)
+			contacts.insert(contacts.end(), chunkContacts[chunk].begin(), chunkContacts[chunk].end());
+
+		// the world test is batched over all objects, its contacts follow the object pairs
+		worldQueryObjects.clear();
+		for (size_t i = 0; i < objects.size(); i++)
+			QueueWorldTest(i);
+
+		CollideWithWorld(contacts);
+
+		WakeTouchedIslands();
+
+		contactSolver.iterationCount = solverIterationCount;
+		contactSolver.Solve(contacts);
+
+		collisions.clear();
+		for (const Contact& contact : contacts)
 		{
-			HitResult hit;
-			if (object.p_collider->IntersectsSDF(worldSDF, hit))
-			{
-				glm::vec3 impulse = CalculateImpulseResponse(
-					hit.point,
-					hit.normal,
-					object.p_rigidbody,
-					nullptr,
-					object.physicsMaterial,
-					worldPhysicsMaterial
-				);
-
-				glm::vec3 overlap = hit.normal * hit.distance;
-
-				collisions.push_back({ &object, hit.point, impulse, overlap });
-			}
+			collisions.push_back({ HandleOfSlot(contact.firstUserId), contact.point, contact.impulse, contact.firstCorrection });
+
+			if (contact.secondUserId != worldUserId)
+				collisions.push_back({ HandleOfSlot(contact.secondUserId), contact.point, -contact.impulse, contact.secondCorrection });
 		}
 
-		for (Collision& collision : collisions)
-			collision.p_object->p_rigidbody->AddCollisionResponseTranslation(collision.overlap);
+		FindSweptBodies(deltaTime);
+		rigidbodies.Integrate(deltaTime);
+		rigidbodies.IntegrateKinematic(deltaTime);
 
-		for (Collision& collision : collisions)
-			collision.p_object->p_rigidbody->AddImpulseAtPoint(collision.impulse, collision.hitPoint);
+		for (const SweptBody& sweptBody : sweptBodies)
+			AdvanceToImpact(sweptBody);
 
 		for (PhysicsObject& object : objects)
 		{
-			object.p_rigidbody->Integrate(deltaTime);
+			if (CanMove(object.rigidbody))
+				UpdateColliderTransform(object);
+		}
 
-			glm::mat4 rbWorldMatrix = glm::mat4_cast(object.p_rigidbody->rotation);
-			rbWorldMatrix[3] = glm::vec4(object.p_rigidbody->centerOfMass, 1.f);
+		// the proxies skip sleeping bodies, so the ones falling asleep now need their last move seen first
+		UpdateBroadphaseProxies(deltaTime);
+		UpdateSleeping(deltaTime);
 
-			object.p_collider->worldMatrix = rbWorldMatrix * object.p_collider->localMatrix;
-			object.p_collider->UpdateWorldAABB();
-		}
+		// slots released before this step can be reused now that no contact refers to them
+		freeSlots.insert(freeSlots.end(), releasedSlots.begin(), releasedSlots.end());
+		releasedSlots.clear();
+
+		simulationTime += deltaTime;
 	}
 }
\ No newline at end of file
@@ -1,7 +1,15 @@
 #pragma once
 #include "collider.h"
 #include "rigidbody.h"
+#include "rigidbody_pool.h"
+#include "sweep_and_prune.h"
+#include "aabb_tree.h"
+#include "spatial_hash_grid.h"
+#include "job_system.h"
+#include "contact_solver.h"
+#include "sdf_raycast.h"
 #include <vector>
+#include <functional>
 
 namespace Engine
 {
@@ -11,16 +19,42 @@ namespace Engine
 		float friction;
 	};
 
+	// two objects collide when each one's category is in the other one's mask
+	struct CollisionFilter
+	{
+		enum : uint32_t
+		{
+			E_None = 0,
+			E_Default = 1,
+			E_World = 1u << 31,// category of the world sdf, clear it from a mask to skip the world test
+			E_All = 0xFFFFFFFF
+		};
+
+		uint32_t category;
+		uint32_t mask;
+	};
+
+	bool ShouldCollide(const CollisionFilter& a, const CollisionFilter& b);
+
 	struct PhysicsObject
 	{
 		Collider* p_collider;
-		Rigidbody* p_rigidbody;
+		Rigidbody rigidbody;
 		PhysicsMaterial physicsMaterial;
+		CollisionFilter collisionFilter;
+	};
+
+	// refers to an object in a PhysicsWorld, a handle to a removed object is detected as stale since
+	// the slot generation changes, generation zero is never used so a zeroed handle is invalid
+	struct PhysicsObjectHandle
+	{
+		uint32_t slot;
+		uint32_t generation;
 	};
 
 	struct Collision
 	{
-		PhysicsObject* p_object;
+		PhysicsObjectHandle object;
 		glm::vec3 hitPoint;
 		glm::vec3 impulse;
 		glm::vec3 overlap;
@@ -28,53 +62,228 @@ namespace Engine
 
 	struct AabbIntersection
 	{
-		PhysicsObject* p_firstObject;
-		PhysicsObject* p_secondObject;
+		uint32_t firstIndex;// dense object indices, only valid during the step
+		uint32_t secondIndex;
 	};
 
-	struct EventPoint
+	struct WorldDistanceCache
 	{
-		enum class Type : char
-		{
-			E_Start,
-			E_End
-		};
+		float distance;// lower bound of the distance to the world, zero while touching it
+		glm::vec3 centerOfMass;// body pose when the distance was measured
+		glm::quat rotation;
+		double time;
+		bool valid;
+	};
 
-		Type type;
-		size_t pairId;
-		PhysicsObject* p_object;
+	struct WorldQuery
+	{
+		uint32_t objectIndex;
+		uint32_t firstPoint;// range of the collider query points in the batch
+		uint32_t pointCount;
+		uint32_t closestIndex;
+		glm::vec3 closestPoint;
+		float closestDistance;
+		// the collider ends when they touch the world too, their contacts share the normal of the closest point
+		uint32_t endCount;
+		uint32_t endIndices[2];
+		glm::vec3 endPoints[2];
+		float endDistances[2];
+	};
+
+	struct SweptBody
+	{
+		uint32_t objectIndex;
+		glm::vec3 startCenterOfMass;
+		glm::quat startRotation;
+	};
+
+	// sweep and prune is the default and the fastest for up to a few thousand bodies, the grid overtakes it
+	// from about 10k bodies of similar size and halves its step time at 100k
+	enum class BroadphaseType : char
+	{
+		E_SweepAndPrune,
+		E_AabbTree,
+		E_SpatialHashGrid
 	};
 
 	class PhysicsWorld final
 	{
 	private:
+		static constexpr uint32_t worldUserId = 0xFFFFFFFF;
+
+		// objects are stored densely and addressed through slots, removing an object moves the last one
+		// into its place, contacts and broadphase proxies use the slot as id
 		std::vector<PhysicsObject> objects;
+		std::vector<uint32_t> denseToSlot;
+		std::vector<uint32_t> slotToDense;
+		std::vector<uint32_t> slotGenerations;
+		std::vector<uint32_t> freeSlots;
+		std::vector<uint32_t> releasedSlots;// reused after the next update so cached impulses of the removed object are gone
+
 		SDF worldSDF;
 		PhysicsMaterial worldPhysicsMaterial;
+		RigidbodyPool rigidbodies;
 
+		SweepAndPrune broadphase;
+		AabbTree aabbTree;
+		SpatialHashGrid hashGrid;
+		AabbTree staticTree;// static objects, only touched when one of them changes
+		uint32_t staticRevision;
+		std::vector<bool> slotIsStatic;
+		std::vector<int32_t> treeProxyIds;// by slot, in staticTree for static objects
 		std::vector<AabbIntersection> aabbIntersections;
 
-		void PhysicsWorld::FindAabbIntersections();
+		JobSystem* p_jobSystem;
+		std::vector<std::vector<Contact>> chunkContacts;
+		std::vector<Contact> contacts;
+		ContactSolver contactSolver;
+
+		std::vector<bool> sleepingBeforeContacts;// by slot
+		std::vector<uint32_t> islandParents;
+		std::vector<float> islandSleepTimes;
+		std::vector<uint64_t> islandMembers;// island root << 32 | body id
+		std::vector<uint32_t> sleepingIds;
+
+		std::vector<SweptBody> sweptBodies;
+
+		std::vector<uint32_t> worldQueryObjects;
+		std::vector<WorldQuery> worldQueries;
+		std::vector<glm::vec3> worldQueryPoints;
+		std::vector<float> worldQueryDistances;
+		std::vector<glm::vec3> worldQueryGradients;
+		std::vector<WorldDistanceCache> worldDistances;// by slot
+		double simulationTime;
+
+		PhysicsObjectHandle HandleOfSlot(uint32_t slot) const;
+		void UpdateColliderTransform(PhysicsObject& object);
+
+		void AddBroadphaseProxy(uint32_t slot);
+		void RemoveBroadphaseProxy(uint32_t slot);
+		void SyncStaticObjects();
+		void UpdateBroadphaseProxies(float deltaTime);
+		void FindAabbIntersections();
+		void FindStaticIntersections();
+		void CollideObjects(size_t begin, size_t end, std::vector<Contact>& outContacts);
+		void QueueWorldTest(size_t objectIndex);
+		void CollideWithWorld(std::vector<Contact>& outContacts);
+		void EvaluateWorldQueries(bool withGradients);
+		bool IsClearOfWorld(size_t objectIndex) const;
+
+		void WakeTouchedIslands();
+		uint32_t FindIslandRoot(uint32_t slot);
+		void UpdateSleeping(float deltaTime);
 
-		glm::vec3 PhysicsWorld::CalculateImpulseResponse(
-			const glm::vec3& hitPoint,
-			const glm::vec3& hitNormal,
-			const Rigidbody* p_firstRb,
-			const Rigidbody* p_optionalSecondRb,
-			const PhysicsMaterial& firstPhysicsMat,
-			const PhysicsMaterial& secondPhysicsMat);
+		void FindSweptBodies(float deltaTime);
+		void AdvanceToImpact(const SweptBody& sweptBody);
+
+		// runs the function on ranges of raycastBatchSize queries, on the job system when there are several
+		void RunQueryBatches(size_t queryCount, const std::function<void(size_t begin, size_t count)>& function);
+
+		Contact MakeContact(
+			const PhysicsObject& first,
+			const Rigidbody& secondRigidbody,
+			const PhysicsMaterial& secondPhysicsMaterial,
+			uint32_t firstSlot,
+			uint32_t secondSlot,
+			const HitResult& hit,
+			uint32_t feature = 0) const;
 
 	public:
 		std::vector<Collision> collisions;
 		glm::vec3 gravity;
+		BroadphaseType broadphaseType;
+		float gridCellSize;// used by the spatial hash grid, derived from the aabb extents when zero
+		size_t narrowphaseChunkSize;
+		size_t worldQueryBatchSize;// points per job when evaluating the world sdf
+		size_t raycastBatchSize;// rays or casts per job in the batched queries
+		size_t solverIterationCount;
+		size_t worldManifoldSize;// contacts of an object with the world, the closest query point and up to two collider ends
+
+		bool allowSleeping;
+		float sleepLinearVelocity;// bodies slower than this for timeToSleep seconds fall asleep with their island
+		float sleepAngularVelocity;
+		float timeToSleep;
+
+		bool cacheWorldDistances;
+		float worldSurfaceSpeed;// upper bound of how fast the world surface moves, zero for a static world
+		float worldLipschitzBound;// how fast the world sdf can change per unit moved, above one for approximations like a brick cache
+
+		float ccdMotionThreshold;// bodies with continuous collision moving further than this fraction of their bounding radius in a step are swept
+		float ccdTolerance;// distance to the world at which the sweep stops
+		size_t ccdMaxIterations;
 
 		PhysicsWorld();
 
-		void Init(float(*_worldSDF)(const glm::vec3&), const PhysicsMaterial& _worldPhysicsMaterial);
-		void AddObject(Collider* p_collider, Rigidbody* p_rigidbody, const PhysicsMaterial& physicsMaterial);
+		// the world sdf is referenced, not copied, whatever it refers to has to outlive the physics world
+		void Init(const SDF& _worldSDF, const PhysicsMaterial& _worldPhysicsMaterial, JobSystem* _p_jobSystem = nullptr);
+		Rigidbody CreateRigidbody();
+		void DestroyRigidbody(const Rigidbody& rigidbody);
+
+		PhysicsObjectHandle AddObject(
+			Collider* p_collider,
+			const Rigidbody& rigidbody,
+			const PhysicsMaterial& physicsMaterial,
+			const CollisionFilter& collisionFilter = { CollisionFilter::E_Default, CollisionFilter::E_All });
+		void AddObjects(const PhysicsObject* p_objects, size_t objectCount, PhysicsObjectHandle* p_outHandles);
+		// the rigidbody of a removed object is left alive, destroy it separately when it is not shared
+		void RemoveObject(const PhysicsObjectHandle& handle);
+		void RemoveObjects(const PhysicsObjectHandle* p_handles, size_t handleCount);
+		void ReserveObjects(size_t objectCount);
+
+		bool IsValid(const PhysicsObjectHandle& handle) const;
+		// the pointer is invalidated by adding or removing objects, keep the handle instead
+		PhysicsObject* GetPhysicsObject(const PhysicsObjectHandle& handle);
+		size_t GetObjectCount() const;
+
+		PhysicsObjectHandle RaycastObjects(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitResult& outHitResult, Collider* p_ignore = nullptr);
+		bool RaycastWorld(
+			const glm::vec3& origin,
+			const glm::vec3& direction,
+			float maxDistance,
+			HitResult& outHitResult,
+			const RaycastOptions& options = RaycastOptions(),
+			RaycastStats* p_outStats = nullptr);
+		// traces the rays in packets, see RaycastSDF, batches of raycastBatchSize rays run on the job system
+		size_t RaycastWorld(
+			const glm::vec3* p_origins,
+			const glm::vec3* p_directions,
+			const float* p_maxDistances,
+			size_t rayCount,
+			HitResult* p_outHitResults,
+			bool* p_outHits,
+			const RaycastOptions& options = RaycastOptions(),
+			RaycastStats* p_outStats = nullptr);
+
+		// sphere and capsule sweeps, see ShapeCastSDF, a sphere costs the same as a ray
+		bool ShapeCastWorld(
+			const ShapeCast& cast,
+			HitResult& outHitResult,
+			const RaycastOptions& options = RaycastOptions(),
+			RaycastStats* p_outStats = nullptr);
+		size_t ShapeCastWorld(
+			const ShapeCast* p_casts,
+			size_t castCount,
+			HitResult* p_outHitResults,
+			bool* p_outHits,
+			const RaycastOptions& options = RaycastOptions(),
+			RaycastStats* p_outStats = nullptr);
+		// the closest object the cast touches, the candidates come from sweeping its aabb through the aabb trees
+		PhysicsObjectHandle ShapeCastObjects(
+			const ShapeCast& cast,
+			HitResult& outHitResult,
+			Collider* p_ignore = nullptr,
+			const RaycastOptions& options = RaycastOptions());
+		void ShapeCastObjects(
+			const ShapeCast* p_casts,
+			size_t castCount,
+			PhysicsObjectHandle* p_outObjects,
+			HitResult* p_outHitResults,
+			Collider* p_ignore = nullptr,
+			const RaycastOptions& options = RaycastOptions());
 
-		PhysicsObject* RaycastObjects(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitResult& outHitResult, Collider* p_ignore = nullptr);
-		bool RaycastWorld(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitResult& outHitResult);
+		// has to be called when the world sdf changes in a way worldSurfaceSpeed does not cover
+		void InvalidateWorldDistances();
+		void InvalidateWorldDistances(const AABB& region);
 
 		void Start();
 		void Update(float deltaTime);
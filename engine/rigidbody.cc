@@ -1,117 +1,255 @@
 #include "rigidbody.h"
+#include "rigidbody_pool.h"
+#include <gtc/type_ptr.hpp>
+#include <cstring>
 
 namespace Engine
 {
+	static float LockMask(bool flag)
+	{
+		uint32_t bits = flag ? 0xFFFFFFFFu : 0u;
+		float mask;
+		std::memcpy(&mask, &bits, sizeof(float));
+		return mask;
+	}
+
 	Rigidbody::Rigidbody() :
-		centerOfMass(glm::vec3(0.f)),
-		linearVelocity(glm::vec3(0.f)),
-		accumulatedForce(glm::vec3(0.f)),
-		inverseMass(1.f),
-		linearDamping(0.2f),
-		rotation(glm::identity<glm::quat>()),
-		angularVelocity(glm::vec3(0.f)),
-		accumulatedTorque(glm::vec3(0.f)),
-		localInverseInertiaTensor(glm::identity<glm::mat3>()),
-		angularDamping(0.2f),
-		worldInverseInertiaTensor(glm::identity<glm::mat3>()),
-		accumulatedResponseTranslation(glm::vec3(0.f)),
-		constraints(0)
+		p_pool(nullptr),
+		id(0)
 	{}
 
-	void Rigidbody::AddForce(const glm::vec3& force)
+	Rigidbody::Rigidbody(RigidbodyPool* _p_pool, uint32_t _id) :
+		p_pool(_p_pool),
+		id(_id)
+	{}
+
+	bool Rigidbody::IsValid() const
 	{
-		accumulatedForce += force;
+		return p_pool != nullptr;
 	}
 
-	void Rigidbody::AddForceAtPoint(const glm::vec3& force, const glm::vec3& point)
+	uint32_t Rigidbody::GetId() const
 	{
-		accumulatedForce += force;
-		accumulatedTorque += glm::cross(point - centerOfMass, force);
+		return id;
 	}
 
-	void Rigidbody::ApplyGravity(const glm::vec3& gravityAcceleration, float deltaTime)
+	glm::vec3 Rigidbody::GetCenterOfMass() const
 	{
-		if (inverseMass != 0.f)
-			linearVelocity += gravityAcceleration * deltaTime;
+		size_t i = p_pool->Dense(id);
+		return glm::vec3(p_pool->positionX[i], p_pool->positionY[i], p_pool->positionZ[i]);
 	}
 
-	void Rigidbody::AddImpulse(const glm::vec3& impulse)
+	void Rigidbody::SetCenterOfMass(const glm::vec3& centerOfMass)
 	{
-		linearVelocity += impulse * inverseMass;
+		WakeUp();
+		MarkStaticMoved();
+
+		size_t i = p_pool->Dense(id);
+		p_pool->positionX[i] = centerOfMass.x;
+		p_pool->positionY[i] = centerOfMass.y;
+		p_pool->positionZ[i] = centerOfMass.z;
 	}
 
-	void Rigidbody::AddImpulseAtPoint(const glm::vec3& impulse, const glm::vec3& point)
+	glm::vec3 Rigidbody::GetLinearVelocity() const
 	{
-		linearVelocity += impulse * inverseMass;
-		angularVelocity += worldInverseInertiaTensor * glm::cross(point - centerOfMass, impulse);
+		size_t i = p_pool->Dense(id);
+		return glm::vec3(p_pool->velocityX[i], p_pool->velocityY[i], p_pool->velocityZ[i]);
 	}
 
-	void Rigidbody::AddCollisionResponseTranslation(const glm::vec3& responseTranslation)
+	void Rigidbody::SetLinearVelocity(const glm::vec3& linearVelocity)
 	{
-		accumulatedResponseTranslation += responseTranslation;
+		WakeUp();
+
+		size_t i = p_pool->Dense(id);
+		p_pool->velocityX[i] = linearVelocity.x;
+		p_pool->velocityY[i] = linearVelocity.y;
+		p_pool->velocityZ[i] = linearVelocity.z;
+	}
+
+	float Rigidbody::GetInverseMass() const
+	{
+		return p_pool->inverseMass[p_pool->Dense(id)];
 	}
 
 	void Rigidbody::SetMass(float mass)
 	{
-		inverseMass = 1.f / mass;
+		p_pool->inverseMass[p_pool->Dense(id)] = 1.f / mass;
+	}
+
+	void Rigidbody::SetLinearDamping(float linearDamping)
+	{
+		size_t i = p_pool->Dense(id);
+		p_pool->linearDamping[i] = linearDamping;
+		p_pool->UpdateDampingFactors(i);
+	}
+
+	glm::quat Rigidbody::GetRotation() const
+	{
+		size_t i = p_pool->Dense(id);
+		return glm::quat(p_pool->rotationW[i], p_pool->rotationX[i], p_pool->rotationY[i], p_pool->rotationZ[i]);
+	}
+
+	void Rigidbody::SetRotation(const glm::quat& rotation)
+	{
+		WakeUp();
+		MarkStaticMoved();
+
+		size_t i = p_pool->Dense(id);
+		p_pool->rotationX[i] = rotation.x;
+		p_pool->rotationY[i] = rotation.y;
+		p_pool->rotationZ[i] = rotation.z;
+		p_pool->rotationW[i] = rotation.w;
+	}
+
+	glm::vec3 Rigidbody::GetAngularVelocity() const
+	{
+		size_t i = p_pool->Dense(id);
+		return glm::vec3(p_pool->angularVelocityX[i], p_pool->angularVelocityY[i], p_pool->angularVelocityZ[i]);
+	}
+
+	void Rigidbody::SetAngularVelocity(const glm::vec3& angularVelocity)
+	{
+		WakeUp();
+
+		size_t i = p_pool->Dense(id);
+		p_pool->angularVelocityX[i] = angularVelocity.x;
+		p_pool->angularVelocityY[i] = angularVelocity.y;
+		p_pool->angularVelocityZ[i] = angularVelocity.z;
+	}
+
+	glm::mat3 Rigidbody::GetWorldInverseInertiaTensor() const
+	{
+		size_t i = p_pool->Dense(id);
+
+		glm::mat3 tensor;
+		float* p_elements = glm::value_ptr(tensor);
+		for (size_t k = 0; k < 9; k++)
+			p_elements[k] = p_pool->worldInverseInertia[k][i];
+
+		return tensor;
 	}
 
 	void Rigidbody::SetInertiaTensor(const glm::mat3& inertiaTensor)
 	{
-		localInverseInertiaTensor = glm::inverse(inertiaTensor);
+		size_t i = p_pool->Dense(id);
+
+		glm::mat3 inverseTensor = glm::inverse(inertiaTensor);
+		const float* p_elements = glm::value_ptr(inverseTensor);
+		for (size_t k = 0; k < 9; k++)
+			p_pool->localInverseInertia[k][i] = p_elements[k];
 	}
 
-	void Rigidbody::Integrate(float fixedDeltaTime)
+	void Rigidbody::SetAngularDamping(float angularDamping)
 	{
-		if (!(constraints & 1))
-		{
-			// update linear velocity based on force and mass (linear acceleration)
-			linearVelocity += accumulatedForce * (fixedDeltaTime * inverseMass);
+		size_t i = p_pool->Dense(id);
+		p_pool->angularDamping[i] = angularDamping;
+		p_pool->UpdateDampingFactors(i);
+	}
 
-			// apply linear damping
-			linearVelocity *= glm::pow(1.f - glm::clamp(linearDamping, 0.f, 0.999f), fixedDeltaTime);
+	void Rigidbody::AddForce(const glm::vec3& force)
+	{
+		WakeUp();
 
-			// update center of mass based on linear velocity and response translation
-			centerOfMass += linearVelocity * fixedDeltaTime + accumulatedResponseTranslation;
-		}
-		else
-			linearVelocity = glm::vec3(0.f);
+		size_t i = p_pool->Dense(id);
+		p_pool->forceX[i] += force.x;
+		p_pool->forceY[i] += force.y;
+		p_pool->forceZ[i] += force.z;
+	}
 
-		if (!(constraints & 2))
-		{
-			// convert inertia tensor to world space
-			glm::mat3 rotationMatrix(glm::mat3_cast(rotation));
-			worldInverseInertiaTensor = rotationMatrix * localInverseInertiaTensor * glm::transpose(rotationMatrix);
+	void Rigidbody::AddForceAtPoint(const glm::vec3& force, const glm::vec3& point)
+	{
+		AddForce(force);
 
-			// update angular velocity based on angular acceleration
-			angularVelocity += (worldInverseInertiaTensor * accumulatedTorque) * fixedDeltaTime;
+		size_t i = p_pool->Dense(id);
+		glm::vec3 torque = glm::cross(point - GetCenterOfMass(), force);
+		p_pool->torqueX[i] += torque.x;
+		p_pool->torqueY[i] += torque.y;
+		p_pool->torqueZ[i] += torque.z;
+	}
 
-			// apply angular damping
-			angularVelocity *= glm::pow(1.f - glm::clamp(angularDamping, 0.f, 0.999f), fixedDeltaTime);
+	void Rigidbody::AddImpulse(const glm::vec3& impulse)
+	{
+		SetLinearVelocity(GetLinearVelocity() + impulse * GetInverseMass());
+	}
 
-			// update rotation based on angular velocity and response rotation
-			rotation += (0.5f * fixedDeltaTime) * glm::quat(0.f, angularVelocity.x, angularVelocity.y, angularVelocity.z) * rotation;
-			rotation = glm::normalize(rotation);
-		}
-		else
-			angularVelocity = glm::vec3(0.f);
+	void Rigidbody::AddImpulseAtPoint(const glm::vec3& impulse, const glm::vec3& point)
+	{
+		SetLinearVelocity(GetLinearVelocity() + impulse * GetInverseMass());
+		SetAngularVelocity(GetAngularVelocity() + GetWorldInverseInertiaTensor() * glm::cross(point - GetCenterOfMass(), impulse));
+	}
 
-		// reset accumulators
-		accumulatedForce = glm::vec3(0.f);
-		accumulatedTorque = glm::vec3(0.f);
-		accumulatedResponseTranslation = glm::vec3(0.f);
+	void Rigidbody::AddCollisionResponseTranslation(const glm::vec3& responseTranslation)
+	{
+		size_t i = p_pool->Dense(id);
+		p_pool->responseX[i] += responseTranslation.x;
+		p_pool->responseY[i] += responseTranslation.y;
+		p_pool->responseZ[i] += responseTranslation.z;
 	}
 
 	void Rigidbody::SetLockPosition(bool flag)
 	{
-		constraints &= ~1;
-		constraints |= (flag ? 1 : 0);
+		p_pool->linearLockMask[p_pool->Dense(id)] = LockMask(flag);
 	}
 
 	void Rigidbody::SetLockRotation(bool flag)
 	{
-		constraints &= ~2;
-		constraints |= (flag ? 2 : 0);
+		p_pool->angularLockMask[p_pool->Dense(id)] = LockMask(flag);
+	}
+
+	bool Rigidbody::IsPositionLocked() const
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &p_pool->linearLockMask[p_pool->Dense(id)], sizeof(float));
+		return bits != 0;
+	}
+
+	bool Rigidbody::IsRotationLocked() const
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &p_pool->angularLockMask[p_pool->Dense(id)], sizeof(float));
+		return bits != 0;
+	}
+
+	void Rigidbody::SetContinuousCollision(bool flag)
+	{
+		p_pool->continuousCollision[id] = flag;
+	}
+
+	bool Rigidbody::IsContinuousCollisionEnabled() const
+	{
+		return p_pool->continuousCollision[id];
+	}
+
+	void Rigidbody::SetBodyType(BodyType type)
+	{
+		p_pool->SetBodyType(id, type);
+	}
+
+	BodyType Rigidbody::GetBodyType() const
+	{
+		return p_pool->GetBodyType(id);
+	}
+
+	void Rigidbody::MarkStaticMoved()
+	{
+		// the physics world refreshes its static objects when the revision changes
+		if (p_pool->bodyTypes[id] == BodyType::E_Static)
+			p_pool->staticRevision++;
+	}
+
+	void Rigidbody::WakeUp()
+	{
+		p_pool->WakeUp(id);
+	}
+
+	bool Rigidbody::IsSleeping() const
+	{
+		return p_pool->IsSleeping(id);
+	}
+
+	float Rigidbody::GetSleepTime() const
+	{
+		return p_pool->sleepTime[p_pool->Dense(id)];
 	}
 
 	glm::mat3 Rigidbody::SphereInertiaTensor(float radius, float mass)
@@ -125,7 +263,7 @@ namespace Engine
 		float h2 = height * height;
 		float a = (1.f / 12.f) * mass * h2 + 0.25 * mass * r2;
 		float b = 0.5f * mass * r2;
-		
+
 		return glm::mat3(a, 0.f, 0.f, 0.f, b, 0.f, 0.f, 0.f, a);
 	}
 
@@ -138,4 +276,4 @@ namespace Engine
 
 		return glm::mat3(f * (b + c), 0.f, 0.f, 0.f, f * (a + c), 0.f, 0.f, 0.f, f * (a + b));
 	}
-}
\ No newline at end of file
+}
@@ -1,48 +1,76 @@
 #pragma once
 #include <glm.hpp>
 #include <gtx/quaternion.hpp>
+#include <cstdint>
 
 namespace Engine
 {
-	class Rigidbody final
-	{
-	public:
-		glm::vec3 centerOfMass;
-		glm::vec3 linearVelocity;
-		glm::vec3 accumulatedForce;
-		float inverseMass;
-		float linearDamping;
+	class RigidbodyPool;
 
-		glm::quat rotation;
-		glm::vec3 angularVelocity;
-		glm::vec3 accumulatedTorque;
-		glm::mat3 localInverseInertiaTensor;
-		float angularDamping;
+	enum class BodyType : char
+	{
+		E_Dynamic,
+		E_Static,// never moves, kept out of the per step work
+		E_Kinematic// moved by its velocity only, pushes dynamic bodies but is not pushed back
+	};
 
-		glm::mat3 worldInverseInertiaTensor;
-		glm::vec3 accumulatedResponseTranslation;
+	// handle to a body stored in a RigidbodyPool, cheap to copy and stays valid while the body exists
+	class Rigidbody final
+	{
+	private:
+		RigidbodyPool* p_pool;
+		uint32_t id;
 
-		int constraints;
+		void MarkStaticMoved();
 
+	public:
 		Rigidbody();
+		Rigidbody(RigidbodyPool* _p_pool, uint32_t _id);
+
+		bool IsValid() const;
+		uint32_t GetId() const;
 
+		glm::vec3 GetCenterOfMass() const;
+		void SetCenterOfMass(const glm::vec3& centerOfMass);
+		glm::vec3 GetLinearVelocity() const;
+		void SetLinearVelocity(const glm::vec3& linearVelocity);
+		float GetInverseMass() const;
 		void SetMass(float mass);
+		void SetLinearDamping(float linearDamping);
+
+		glm::quat GetRotation() const;
+		void SetRotation(const glm::quat& rotation);
+		glm::vec3 GetAngularVelocity() const;
+		void SetAngularVelocity(const glm::vec3& angularVelocity);
+		glm::mat3 GetWorldInverseInertiaTensor() const;
 		void SetInertiaTensor(const glm::mat3& inertiaTensor);
+		void SetAngularDamping(float angularDamping);
 
 		void AddForce(const glm::vec3& force);
 		void AddForceAtPoint(const glm::vec3& force, const glm::vec3& point);
-		void ApplyGravity(const glm::vec3& gravityAcceleration, float deltaTime);
 		void AddImpulse(const glm::vec3& impulse);
 		void AddImpulseAtPoint(const glm::vec3& impulse, const glm::vec3& point);
 		void AddCollisionResponseTranslation(const glm::vec3& responseTranslation);
 
 		void SetLockPosition(bool flag);
 		void SetLockRotation(bool flag);
+		bool IsPositionLocked() const;
+		bool IsRotationLocked() const;
+
+		// fast bodies with continuous collision are swept against the world so they can not pass through it
+		void SetContinuousCollision(bool flag);
+		bool IsContinuousCollisionEnabled() const;
+
+		void SetBodyType(BodyType type);
+		BodyType GetBodyType() const;
 
-		void Integrate(float deltaTime);
+		// moving a sleeping body through the setters or applying forces to it wakes its island
+		void WakeUp();
+		bool IsSleeping() const;
+		float GetSleepTime() const;
 
 		static glm::mat3 SphereInertiaTensor(float radius, float mass);
 		static glm::mat3 CylinderInertiaTensor(float radius, float height, float mass);
 		static glm::mat3 BoxInertiaTensor(const glm::vec3& size, float mass);
 	};
-}
\ No newline at end of file
+}
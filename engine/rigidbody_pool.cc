@@ -0,0 +1,458 @@
+#include "rigidbody_pool.h"
+#include "simd.h"
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <cassert>
+
+namespace Engine
+{
+	static float DampingFactor(float damping, float deltaTime)
+	{
+		return glm::pow(1.f - glm::clamp(damping, 0.f, 0.999f), deltaTime);
+	}
+
+	static float LaneMask(bool flag)
+	{
+		uint32_t bits = flag ? 0xFFFFFFFFu : 0u;
+		float mask;
+		std::memcpy(&mask, &bits, sizeof(float));
+		return mask;
+	}
+
+	RigidbodyPool::RigidbodyPool() :
+		count(0),
+		awakeCount(0),
+		staticRevision(0),
+		cachedDeltaTime(0.f)
+	{}
+
+	template<typename CALLBACK>
+	void RigidbodyPool::ForEachArray(CALLBACK callback)
+	{
+		// callback(array, value of a body at rest)
+		callback(positionX, 0.f); callback(positionY, 0.f); callback(positionZ, 0.f);
+		callback(velocityX, 0.f); callback(velocityY, 0.f); callback(velocityZ, 0.f);
+		callback(forceX, 0.f); callback(forceY, 0.f); callback(forceZ, 0.f);
+		callback(responseX, 0.f); callback(responseY, 0.f); callback(responseZ, 0.f);
+		callback(inverseMass, 1.f);
+		callback(linearDamping, 0.2f);
+		callback(linearDampingFactor, 1.f);
+
+		callback(rotationX, 0.f); callback(rotationY, 0.f); callback(rotationZ, 0.f); callback(rotationW, 1.f);
+		callback(angularVelocityX, 0.f); callback(angularVelocityY, 0.f); callback(angularVelocityZ, 0.f);
+		callback(torqueX, 0.f); callback(torqueY, 0.f); callback(torqueZ, 0.f);
+		callback(angularDamping, 0.2f);
+		callback(angularDampingFactor, 1.f);
+
+		for (size_t k = 0; k < 9; k++)
+		{
+			// identity, the diagonal of a column major 3x3 matrix is at 0, 4 and 8
+			float identity = (k % 4 == 0) ? 1.f : 0.f;
+			callback(localInverseInertia[k], identity);
+			callback(worldInverseInertia[k], identity);
+		}
+
+		callback(linearLockMask, 0.f);
+		callback(angularLockMask, 0.f);
+		callback(heldMask, 0.f);
+		callback(sleepTime, 0.f);
+	}
+
+	void RigidbodyPool::ResetLane(size_t denseIndex)
+	{
+		ForEachArray([denseIndex](std::vector<float>& values, float restValue) { values[denseIndex] = restValue; });
+		UpdateDampingFactors(denseIndex);
+	}
+
+	void RigidbodyPool::SwapLanes(size_t firstIndex, size_t secondIndex)
+	{
+		if (firstIndex == secondIndex)
+			return;
+
+		ForEachArray([firstIndex, secondIndex](std::vector<float>& values, float) { std::swap(values[firstIndex], values[secondIndex]); });
+
+		std::swap(denseToId[firstIndex], denseToId[secondIndex]);
+		idToDense[denseToId[firstIndex]] = uint32_t(firstIndex);
+		idToDense[denseToId[secondIndex]] = uint32_t(secondIndex);
+	}
+
+	void RigidbodyPool::UpdateDampingFactors(size_t denseIndex)
+	{
+		linearDampingFactor[denseIndex] = DampingFactor(linearDamping[denseIndex], cachedDeltaTime);
+		angularDampingFactor[denseIndex] = DampingFactor(angularDamping[denseIndex], cachedDeltaTime);
+	}
+
+	size_t RigidbodyPool::Dense(uint32_t id) const
+	{
+		return idToDense[id];
+	}
+
+	Rigidbody RigidbodyPool::Create()
+	{
+		uint32_t id;
+		if (!freeIds.empty())
+		{
+			id = freeIds.back();
+			freeIds.pop_back();
+		}
+		else
+		{
+			id = uint32_t(idToDense.size());
+			idToDense.push_back(0);
+			nextInIsland.push_back(0);
+			continuousCollision.push_back(false);
+			bodyTypes.push_back(BodyType::E_Dynamic);
+		}
+
+		size_t denseIndex = count++;
+		idToDense[id] = uint32_t(denseIndex);
+		denseToId.push_back(id);
+
+		// keep the arrays padded to whole simd widths
+		size_t paddedCount = (count + Float8::width - 1) / Float8::width * Float8::width;
+		if (positionX.size() < paddedCount)
+			ForEachArray([paddedCount](std::vector<float>& values, float restValue) { values.resize(paddedCount, restValue); });
+
+		ResetLane(denseIndex);
+		nextInIsland[id] = id;
+		continuousCollision[id] = false;
+		bodyTypes[id] = BodyType::E_Dynamic;
+
+		// new bodies are awake, move it in front of the sleeping ones
+		SwapLanes(denseIndex, awakeCount);
+		awakeCount++;
+
+		return Rigidbody(this, id);
+	}
+
+	void RigidbodyPool::Destroy(const Rigidbody& rigidbody)
+	{
+		uint32_t id = rigidbody.GetId();
+
+		// held bodies only have to be moved to the end of the arrays
+		SetBodyType(id, BodyType::E_Dynamic);
+
+		// leave the sleeping island first, then move the body to the end of the awake range and
+		// from there to the end of the arrays
+		WakeUp(id);
+
+		size_t lastAwakeIndex = awakeCount - 1;
+		size_t lastIndex = count - 1;
+
+		SwapLanes(idToDense[id], lastAwakeIndex);
+		SwapLanes(lastAwakeIndex, lastIndex);
+		awakeCount--;
+
+		ResetLane(lastIndex);
+		denseToId.pop_back();
+		freeIds.push_back(id);
+		count--;
+	}
+
+	size_t RigidbodyPool::GetCount() const
+	{
+		return count;
+	}
+
+	size_t RigidbodyPool::GetAwakeCount() const
+	{
+		return awakeCount;
+	}
+
+	void RigidbodyPool::PutToSleep(const uint32_t* p_ids, size_t idCount)
+	{
+		for (size_t i = 0; i < idCount; i++)
+		{
+			uint32_t id = p_ids[i];
+			assert(bodyTypes[id] == BodyType::E_Dynamic && !IsSleeping(id));
+
+			// move the body to the front of the sleeping range
+			awakeCount--;
+			SwapLanes(idToDense[id], awakeCount);
+
+			size_t denseIndex = awakeCount;
+			heldMask[denseIndex] = LaneMask(true);
+			velocityX[denseIndex] = velocityY[denseIndex] = velocityZ[denseIndex] = 0.f;
+			angularVelocityX[denseIndex] = angularVelocityY[denseIndex] = angularVelocityZ[denseIndex] = 0.f;
+			forceX[denseIndex] = forceY[denseIndex] = forceZ[denseIndex] = 0.f;
+			torqueX[denseIndex] = torqueY[denseIndex] = torqueZ[denseIndex] = 0.f;
+			responseX[denseIndex] = responseY[denseIndex] = responseZ[denseIndex] = 0.f;
+
+			nextInIsland[id] = p_ids[(i + 1) % idCount];
+		}
+	}
+
+	void RigidbodyPool::WakeUp(uint32_t id)
+	{
+		if (!IsSleeping(id))
+			return;
+
+		uint32_t current = id;
+		do
+		{
+			size_t denseIndex = idToDense[current];
+			heldMask[denseIndex] = LaneMask(false);
+			sleepTime[denseIndex] = 0.f;
+
+			// move the body to the end of the awake range
+			SwapLanes(denseIndex, awakeCount);
+			awakeCount++;
+
+			uint32_t next = nextInIsland[current];
+			nextInIsland[current] = current;
+			current = next;
+		} while (current != id);
+	}
+
+	bool RigidbodyPool::IsSleeping(uint32_t id) const
+	{
+		return bodyTypes[id] == BodyType::E_Dynamic && idToDense[id] >= awakeCount;
+	}
+
+	void RigidbodyPool::SetBodyType(uint32_t id, BodyType type)
+	{
+		BodyType oldType = bodyTypes[id];
+		if (oldType == type)
+			return;
+
+		if (oldType == BodyType::E_Static || type == BodyType::E_Static)
+			staticRevision++;
+
+		if (oldType == BodyType::E_Kinematic)
+			kinematicIds.erase(std::find(kinematicIds.begin(), kinematicIds.end(), id));
+
+		if (type == BodyType::E_Kinematic)
+			kinematicIds.push_back(id);
+
+		if (oldType == BodyType::E_Dynamic)
+		{
+			// leave the island, then move out of the awake range, held bodies are skipped by the integrator
+			WakeUp(id);
+
+			awakeCount--;
+			SwapLanes(idToDense[id], awakeCount);
+
+			size_t denseIndex = awakeCount;
+			heldMask[denseIndex] = LaneMask(true);
+			forceX[denseIndex] = forceY[denseIndex] = forceZ[denseIndex] = 0.f;
+			torqueX[denseIndex] = torqueY[denseIndex] = torqueZ[denseIndex] = 0.f;
+			responseX[denseIndex] = responseY[denseIndex] = responseZ[denseIndex] = 0.f;
+		}
+		else if (type == BodyType::E_Dynamic)
+		{
+			size_t denseIndex = idToDense[id];
+			heldMask[denseIndex] = LaneMask(false);
+			sleepTime[denseIndex] = 0.f;
+
+			SwapLanes(denseIndex, awakeCount);
+			awakeCount++;
+		}
+
+		bodyTypes[id] = type;
+
+		if (type == BodyType::E_Static)
+		{
+			size_t denseIndex = idToDense[id];
+			velocityX[denseIndex] = velocityY[denseIndex] = velocityZ[denseIndex] = 0.f;
+			angularVelocityX[denseIndex] = angularVelocityY[denseIndex] = angularVelocityZ[denseIndex] = 0.f;
+		}
+	}
+
+	BodyType RigidbodyPool::GetBodyType(uint32_t id) const
+	{
+		return bodyTypes[id];
+	}
+
+	uint32_t RigidbodyPool::GetStaticRevision() const
+	{
+		return staticRevision;
+	}
+
+	void RigidbodyPool::IntegrateKinematic(float deltaTime)
+	{
+		// kinematic bodies follow their velocity and ignore forces, there are usually only a few
+		for (uint32_t id : kinematicIds)
+		{
+			size_t i = idToDense[id];
+
+			positionX[i] += velocityX[i] * deltaTime;
+			positionY[i] += velocityY[i] * deltaTime;
+			positionZ[i] += velocityZ[i] * deltaTime;
+
+			glm::quat rotation(rotationW[i], rotationX[i], rotationY[i], rotationZ[i]);
+			glm::quat spin(0.f, angularVelocityX[i], angularVelocityY[i], angularVelocityZ[i]);
+			rotation = glm::normalize(rotation + (0.5f * deltaTime) * spin * rotation);
+
+			rotationX[i] = rotation.x;
+			rotationY[i] = rotation.y;
+			rotationZ[i] = rotation.z;
+			rotationW[i] = rotation.w;
+
+			forceX[i] = forceY[i] = forceZ[i] = 0.f;
+			torqueX[i] = torqueY[i] = torqueZ[i] = 0.f;
+			responseX[i] = responseY[i] = responseZ[i] = 0.f;
+		}
+	}
+
+	void RigidbodyPool::ApplyGravity(const glm::vec3& gravityAcceleration, float deltaTime)
+	{
+		Float8 zero = Float8::Zero();
+		Float8 deltaX = Float8::Set(gravityAcceleration.x * deltaTime);
+		Float8 deltaY = Float8::Set(gravityAcceleration.y * deltaTime);
+		Float8 deltaZ = Float8::Set(gravityAcceleration.z * deltaTime);
+
+		for (size_t i = 0; i < awakeCount; i += Float8::width)
+		{
+			// bodies with infinite mass and held bodies are not affected
+			Float8 invMass = Float8::Load(&inverseMass[i]);
+			Float8 hasMass = Select(Float8::Load(&heldMask[i]), zero, (invMass < zero) | (invMass > zero));
+
+			(Float8::Load(&velocityX[i]) + (deltaX & hasMass)).Store(&velocityX[i]);
+			(Float8::Load(&velocityY[i]) + (deltaY & hasMass)).Store(&velocityY[i]);
+			(Float8::Load(&velocityZ[i]) + (deltaZ & hasMass)).Store(&velocityZ[i]);
+		}
+	}
+
+	void RigidbodyPool::Integrate(float deltaTime)
+	{
+		// the damping factors only change with the time step, which is usually fixed
+		if (deltaTime != cachedDeltaTime)
+		{
+			cachedDeltaTime = deltaTime;
+			for (size_t i = 0; i < count; i++)
+				UpdateDampingFactors(i);
+		}
+
+		const Float8 zero = Float8::Zero();
+		const Float8 one = Float8::Set(1.f);
+		const Float8 two = Float8::Set(2.f);
+		const Float8 dt = Float8::Set(deltaTime);
+		const Float8 halfDt = Float8::Set(0.5f * deltaTime);
+
+		for (size_t i = 0; i < awakeCount; i += Float8::width)
+		{
+			// held bodies in the last group are treated as fully locked, but keep their velocity since
+			// kinematic bodies are moved by it elsewhere
+			Float8 held = Float8::Load(&heldMask[i]);
+
+			// linear motion
+			Float8 linearLocked = Float8::Load(&linearLockMask[i]) | held;
+			Float8 linearDampingLanes = Float8::Load(&linearDampingFactor[i]);
+			Float8 forceScale = dt * Float8::Load(&inverseMass[i]);
+
+			Float8 oldVx = Float8::Load(&velocityX[i]);
+			Float8 oldVy = Float8::Load(&velocityY[i]);
+			Float8 oldVz = Float8::Load(&velocityZ[i]);
+			Float8 vx = (oldVx + Float8::Load(&forceX[i]) * forceScale) * linearDampingLanes;
+			Float8 vy = (oldVy + Float8::Load(&forceY[i]) * forceScale) * linearDampingLanes;
+			Float8 vz = (oldVz + Float8::Load(&forceZ[i]) * forceScale) * linearDampingLanes;
+
+			Float8 px = Float8::Load(&positionX[i]);
+			Float8 py = Float8::Load(&positionY[i]);
+			Float8 pz = Float8::Load(&positionZ[i]);
+
+			Select(linearLocked, px, px + vx * dt + Float8::Load(&responseX[i])).Store(&positionX[i]);
+			Select(linearLocked, py, py + vy * dt + Float8::Load(&responseY[i])).Store(&positionY[i]);
+			Select(linearLocked, pz, pz + vz * dt + Float8::Load(&responseZ[i])).Store(&positionZ[i]);
+			Select(linearLocked, oldVx & held, vx).Store(&velocityX[i]);
+			Select(linearLocked, oldVy & held, vy).Store(&velocityY[i]);
+			Select(linearLocked, oldVz & held, vz).Store(&velocityZ[i]);
+
+			// rotation matrix of the current rotation, column major like glm::mat3_cast
+			Float8 angularLocked = Float8::Load(&angularLockMask[i]) | held;
+			Float8 qx = Float8::Load(&rotationX[i]);
+			Float8 qy = Float8::Load(&rotationY[i]);
+			Float8 qz = Float8::Load(&rotationZ[i]);
+			Float8 qw = Float8::Load(&rotationW[i]);
+
+			Float8 r[9];
+			r[0] = one - two * (qy * qy + qz * qz);
+			r[1] = two * (qx * qy + qw * qz);
+			r[2] = two * (qx * qz - qw * qy);
+			r[3] = two * (qx * qy - qw * qz);
+			r[4] = one - two * (qx * qx + qz * qz);
+			r[5] = two * (qy * qz + qw * qx);
+			r[6] = two * (qx * qz + qw * qy);
+			r[7] = two * (qy * qz - qw * qx);
+			r[8] = one - two * (qx * qx + qy * qy);
+
+			Float8 local[9];
+			for (size_t k = 0; k < 9; k++)
+				local[k] = Float8::Load(&localInverseInertia[k][i]);
+
+			// world tensor = R * local * transpose(R), element (row, column) is at column * 3 + row
+			Float8 rotatedLocal[9];
+			for (size_t column = 0; column < 3; column++)
+				for (size_t row = 0; row < 3; row++)
+					rotatedLocal[column * 3 + row] = r[row] * local[column * 3] + r[3 + row] * local[column * 3 + 1] + r[6 + row] * local[column * 3 + 2];
+
+			Float8 world[9];
+			for (size_t column = 0; column < 3; column++)
+			{
+				for (size_t row = 0; row < 3; row++)
+				{
+					Float8 element = rotatedLocal[row] * r[column] + rotatedLocal[3 + row] * r[3 + column] + rotatedLocal[6 + row] * r[6 + column];
+					world[column * 3 + row] = Select(angularLocked, Float8::Load(&worldInverseInertia[column * 3 + row][i]), element);
+					world[column * 3 + row].Store(&worldInverseInertia[column * 3 + row][i]);
+				}
+			}
+
+			// angular velocity from the torque, then damping
+			Float8 tx = Float8::Load(&torqueX[i]);
+			Float8 ty = Float8::Load(&torqueY[i]);
+			Float8 tz = Float8::Load(&torqueZ[i]);
+			Float8 angularDampingLanes = Float8::Load(&angularDampingFactor[i]);
+
+			Float8 oldWx = Float8::Load(&angularVelocityX[i]);
+			Float8 oldWy = Float8::Load(&angularVelocityY[i]);
+			Float8 oldWz = Float8::Load(&angularVelocityZ[i]);
+			Float8 wx = (oldWx + (world[0] * tx + world[3] * ty + world[6] * tz) * dt) * angularDampingLanes;
+			Float8 wy = (oldWy + (world[1] * tx + world[4] * ty + world[7] * tz) * dt) * angularDampingLanes;
+			Float8 wz = (oldWz + (world[2] * tx + world[5] * ty + world[8] * tz) * dt) * angularDampingLanes;
+
+			// q += 0.5 * dt * quat(0, w) * q, then normalize
+			Float8 nx = qx + halfDt * (qw * wx + wy * qz - wz * qy);
+			Float8 ny = qy + halfDt * (qw * wy + wz * qx - wx * qz);
+			Float8 nz = qz + halfDt * (qw * wz + wx * qy - wy * qx);
+			Float8 nw = qw - halfDt * (wx * qx + wy * qy + wz * qz);
+			Float8 inverseLength = one / Sqrt(nx * nx + ny * ny + nz * nz + nw * nw);
+
+			Select(angularLocked, qx, nx * inverseLength).Store(&rotationX[i]);
+			Select(angularLocked, qy, ny * inverseLength).Store(&rotationY[i]);
+			Select(angularLocked, qz, nz * inverseLength).Store(&rotationZ[i]);
+			Select(angularLocked, qw, nw * inverseLength).Store(&rotationW[i]);
+			Select(angularLocked, oldWx & held, wx).Store(&angularVelocityX[i]);
+			Select(angularLocked, oldWy & held, wy).Store(&angularVelocityY[i]);
+			Select(angularLocked, oldWz & held, wz).Store(&angularVelocityZ[i]);
+
+			// reset accumulators
+			zero.Store(&forceX[i]); zero.Store(&forceY[i]); zero.Store(&forceZ[i]);
+			zero.Store(&torqueX[i]); zero.Store(&torqueY[i]); zero.Store(&torqueZ[i]);
+			zero.Store(&responseX[i]); zero.Store(&responseY[i]); zero.Store(&responseZ[i]);
+		}
+	}
+
+	void RigidbodyPool::UpdateSleepTimers(float deltaTime, float linearTolerance, float angularTolerance)
+	{
+		const Float8 zero = Float8::Zero();
+		const Float8 dt = Float8::Set(deltaTime);
+		const Float8 linearTolerance2 = Float8::Set(linearTolerance * linearTolerance);
+		const Float8 angularTolerance2 = Float8::Set(angularTolerance * angularTolerance);
+
+		for (size_t i = 0; i < awakeCount; i += Float8::width)
+		{
+			Float8 vx = Float8::Load(&velocityX[i]);
+			Float8 vy = Float8::Load(&velocityY[i]);
+			Float8 vz = Float8::Load(&velocityZ[i]);
+			Float8 wx = Float8::Load(&angularVelocityX[i]);
+			Float8 wy = Float8::Load(&angularVelocityY[i]);
+			Float8 wz = Float8::Load(&angularVelocityZ[i]);
+
+			Float8 resting = ((vx * vx + vy * vy + vz * vz) <= linearTolerance2) & ((wx * wx + wy * wy + wz * wz) <= angularTolerance2);
+			Float8 time = Float8::Load(&sleepTime[i]);
+
+			Select(Float8::Load(&heldMask[i]), time, Select(resting, time + dt, zero)).Store(&sleepTime[i]);
+		}
+	}
+}
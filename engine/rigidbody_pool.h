@@ -0,0 +1,85 @@
+#pragma once
+#include "rigidbody.h"
+#include <vector>
+#include <cstdint>
+
+namespace Engine
+{
+	// rigidbody state stored as structure of arrays, integrated 8 bodies at a time
+	// bodies are addressed through stable ids which map to a dense index, removing a body moves the
+	// last body into its place so the arrays stay packed
+	// the arrays are padded to a multiple of 8 with resting bodies so the integrator has no tail loop
+	// awake dynamic bodies are kept in front of sleeping, static and kinematic ones so the per step
+	// loops stop at the awake count, the bodies sharing the last group of 8 are held by their mask
+	class RigidbodyPool final
+	{
+	private:
+		friend class Rigidbody;
+
+		std::vector<uint32_t> idToDense;
+		std::vector<uint32_t> denseToId;
+		std::vector<uint32_t> freeIds;
+		std::vector<uint32_t> nextInIsland;// ring of the bodies that fell asleep together, by id
+		std::vector<bool> continuousCollision;// by id, not used by the integrator
+		std::vector<BodyType> bodyTypes;// by id
+		std::vector<uint32_t> kinematicIds;
+		size_t count;
+		size_t awakeCount;
+		uint32_t staticRevision;// changes whenever a static body is moved or a body becomes or stops being static
+
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> velocityX, velocityY, velocityZ;
+		std::vector<float> forceX, forceY, forceZ;
+		std::vector<float> responseX, responseY, responseZ;
+		std::vector<float> inverseMass;
+		std::vector<float> linearDamping;
+		std::vector<float> linearDampingFactor;// pow(1 - damping, deltaTime), cached for cachedDeltaTime
+
+		std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+		std::vector<float> angularVelocityX, angularVelocityY, angularVelocityZ;
+		std::vector<float> torqueX, torqueY, torqueZ;
+		std::vector<float> angularDamping;
+		std::vector<float> angularDampingFactor;
+		std::vector<float> localInverseInertia[9];// column major like glm::mat3
+		std::vector<float> worldInverseInertia[9];
+
+		std::vector<float> linearLockMask;// all bits set when the position is locked
+		std::vector<float> angularLockMask;
+		std::vector<float> heldMask;// all bits set when the integrator leaves the body alone, asleep, static or kinematic
+		std::vector<float> sleepTime;// time the body has been slow enough to sleep
+
+		float cachedDeltaTime;
+
+		template<typename CALLBACK>
+		void ForEachArray(CALLBACK callback);
+
+		void ResetLane(size_t denseIndex);
+		void SwapLanes(size_t firstIndex, size_t secondIndex);
+		void UpdateDampingFactors(size_t denseIndex);
+		size_t Dense(uint32_t id) const;
+
+	public:
+		RigidbodyPool();
+
+		Rigidbody Create();
+		void Destroy(const Rigidbody& rigidbody);
+
+		size_t GetCount() const;
+		size_t GetAwakeCount() const;
+
+		// the bodies are put to sleep together and are woken together when any of them is woken,
+		// all of them have to be awake
+		void PutToSleep(const uint32_t* p_ids, size_t idCount);
+		void WakeUp(uint32_t id);
+		bool IsSleeping(uint32_t id) const;
+
+		void SetBodyType(uint32_t id, BodyType type);
+		BodyType GetBodyType(uint32_t id) const;
+		uint32_t GetStaticRevision() const;
+
+		void ApplyGravity(const glm::vec3& gravityAcceleration, float deltaTime);
+		void Integrate(float deltaTime);
+		void IntegrateKinematic(float deltaTime);
+		void UpdateSleepTimers(float deltaTime, float linearTolerance, float angularTolerance);
+	};
+}
@@ -3,16 +3,133 @@
 
 namespace Engine
 {
+	// tetrahedron of offsets around the point
+	static constexpr float x = 1.f;
+	static constexpr float y = -1.f;
+	static constexpr float h = 0.0001;
+	static const glm::vec3 tapDirections[normalTapCount] =
+	{
+		glm::vec3(x, y, y),
+		glm::vec3(y, y, x),
+		glm::vec3(y, x, y),
+		glm::vec3(x, x, x)
+	};
+
+	SDF::SDF() :
+		p_context(nullptr),
+		p_distance(nullptr),
+		p_batch(nullptr),
+		p_gradient(nullptr)
+	{}
+
+	SDF::SDF(const void* _p_context, DistanceFunction _p_distance, BatchFunction _p_batch, GradientFunction _p_gradient) :
+		p_context(_p_context),
+		p_distance(_p_distance),
+		p_batch(_p_batch),
+		p_gradient(_p_gradient)
+	{}
+
+	SDF::SDF(float(*p_function)(const glm::vec3&)) :
+		p_context(reinterpret_cast<const void*>(p_function)),
+		p_distance(p_function != nullptr ? &CallFunction : nullptr),
+		p_batch(nullptr),
+		p_gradient(nullptr)
+	{}
+
+	float SDF::CallFunction(const void* p_context, const glm::vec3& p)
+	{
+		return reinterpret_cast<float(*)(const glm::vec3&)>(p_context)(p);
+	}
+
+	void SDF::Evaluate(const glm::vec3* p_points, float* p_outDistances, size_t count) const
+	{
+		if (p_batch != nullptr)
+		{
+			p_batch(p_context, p_points, p_outDistances, count);
+			return;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			p_outDistances[i] = p_distance(p_context, p_points[i]);
+	}
+
+	bool SDF::HasGradient() const
+	{
+		return p_gradient != nullptr;
+	}
+
+	float SDF::Gradient(const glm::vec3& p, glm::vec3& outGradient) const
+	{
+		if (p_gradient != nullptr)
+			return p_gradient(p_context, p, outGradient);
+
+		glm::vec3 taps[normalTapCount];
+		float tapDistances[normalTapCount];
+
+		GetNormalTaps(p, taps);
+		Evaluate(taps, tapDistances, normalTapCount);
+		outGradient = GradientFromTaps(tapDistances);
+
+		// the taps are centered on p, so their mean is the distance up to the curvature over h
+		return 0.25f * (tapDistances[0] + tapDistances[1] + tapDistances[2] + tapDistances[3]);
+	}
+
+	void SDF::EvaluateGradients(const glm::vec3* p_points, float* p_outDistances, glm::vec3* p_outGradients, size_t count) const
+	{
+		for (size_t i = 0; i < count; i++)
+			p_outDistances[i] = Gradient(p_points[i], p_outGradients[i]);
+	}
+
+	SDF::operator bool() const
+	{
+		return p_distance != nullptr;
+	}
+
 	glm::vec3 CalcNormal(const SDF& sdf, const glm::vec3& p)
 	{
-		constexpr float h = 0.0001;
-		constexpr float x = 1.f;
-		constexpr float y = -1.f;
+		if (sdf.HasGradient())
+		{
+			glm::vec3 gradient;
+			sdf.Gradient(p, gradient);
+			return glm::normalize(gradient);
+		}
+
+		glm::vec3 taps[normalTapCount];
+		float tapDistances[normalTapCount];
+
+		GetNormalTaps(p, taps);
+		sdf.Evaluate(taps, tapDistances, normalTapCount);
+
+		return NormalFromTaps(tapDistances);
+	}
+
+	size_t NormalEvaluationCount(const SDF& sdf)
+	{
+		return sdf.HasGradient() ? 1 : normalTapCount;
+	}
+
+	void GetNormalTaps(const glm::vec3& p, glm::vec3* p_outTaps)
+	{
+		for (size_t i = 0; i < normalTapCount; i++)
+			p_outTaps[i] = p + tapDirections[i] * h;
+	}
 
+	glm::vec3 NormalFromTaps(const float* p_tapDistances)
+	{
 		return glm::normalize(
-			glm::vec3(x, y, y) * sdf(p + glm::vec3(x, y, y) * h) +
-			glm::vec3(y, y, x) * sdf(p + glm::vec3(y, y, x) * h) +
-			glm::vec3(y, x, y) * sdf(p + glm::vec3(y, x, y) * h) +
-			glm::vec3(x, x, x) * sdf(p + glm::vec3(x, x, x) * h));
+			tapDirections[0] * p_tapDistances[0] +
+			tapDirections[1] * p_tapDistances[1] +
+			tapDirections[2] * p_tapDistances[2] +
+			tapDirections[3] * p_tapDistances[3]);
+	}
+
+	glm::vec3 GradientFromTaps(const float* p_tapDistances)
+	{
+		// the weighted taps sum to 4 h times the gradient
+		return (
+			tapDirections[0] * p_tapDistances[0] +
+			tapDirections[1] * p_tapDistances[1] +
+			tapDirections[2] * p_tapDistances[2] +
+			tapDirections[3] * p_tapDistances[3]) / (4.f * h);
 	}
 }
\ No newline at end of file
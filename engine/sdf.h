@@ -1,10 +1,117 @@
 #pragma once
-#include <functional>
+#include "dual.h"
 #include <vec3.hpp>
+#include <type_traits>
+#include <cstddef>
 
 namespace Engine
 {
-	typedef std::function<float(const glm::vec3&)> SDF;
+	// non-owning reference to a distance function, cheap to copy and pass by value
+	// the referenced object has to outlive the sdf, binding a temporary is only safe for the length of a call
+	// every sdf can evaluate many points at once, sources without a batch function are called once per point
+	// sources with a gradient function give the distance and its gradient in one run, for the others the
+	// gradient is estimated from the CalcNormal taps
+	class SDF final
+	{
+	public:
+		typedef float(*DistanceFunction)(const void* p_context, const glm::vec3& p);
+		typedef void(*BatchFunction)(const void* p_context, const glm::vec3* p_points, float* p_outDistances, size_t count);
+		typedef float(*GradientFunction)(const void* p_context, const glm::vec3& p, glm::vec3& outGradient);
+
+	private:
+		const void* p_context;
+		DistanceFunction p_distance;
+		BatchFunction p_batch;
+		GradientFunction p_gradient;
+
+		template<typename CALLABLE>
+		static float CallObject(const void* p_context, const glm::vec3& p)
+		{
+			return (*static_cast<const CALLABLE*>(p_context))(p);
+		}
+
+		template<typename CALLABLE>
+		static void CallObjectEach(const void* p_context, const glm::vec3* p_points, float* p_outDistances, size_t count)
+		{
+			const CALLABLE& callable = *static_cast<const CALLABLE*>(p_context);
+			for (size_t i = 0; i < count; i++)
+				p_outDistances[i] = callable(p_points[i]);
+		}
+
+		template<typename OBJECT, float(OBJECT::*DISTANCE)(const glm::vec3&) const>
+		static float CallMember(const void* p_context, const glm::vec3& p)
+		{
+			return (static_cast<const OBJECT*>(p_context)->*DISTANCE)(p);
+		}
+
+		template<typename OBJECT, float(OBJECT::*DISTANCE)(const glm::vec3&) const>
+		static void CallMemberEach(const void* p_context, const glm::vec3* p_points, float* p_outDistances, size_t count)
+		{
+			const OBJECT& object = *static_cast<const OBJECT*>(p_context);
+			for (size_t i = 0; i < count; i++)
+				p_outDistances[i] = (object.*DISTANCE)(p_points[i]);
+		}
+
+		template<typename OBJECT, Dual(OBJECT::*DUAL_DISTANCE)(const DualVec3&) const>
+		static float CallMemberGradient(const void* p_context, const glm::vec3& p, glm::vec3& outGradient)
+		{
+			Dual distance = (static_cast<const OBJECT*>(p_context)->*DUAL_DISTANCE)(DualVec3::Variable(p));
+			outGradient = distance.gradient;
+			return distance.value;
+		}
+
+		static float CallFunction(const void* p_context, const glm::vec3& p);
+
+	public:
+		SDF();
+		SDF(const void* _p_context, DistanceFunction _p_distance, BatchFunction _p_batch = nullptr, GradientFunction _p_gradient = nullptr);
+		SDF(float(*p_function)(const glm::vec3&));
+
+		// refers to a lambda or function object
+		template<typename CALLABLE, typename = std::enable_if_t<!std::is_same<std::decay_t<CALLABLE>, SDF>::value && !std::is_function<CALLABLE>::value>>
+		SDF(const CALLABLE& callable) :
+			p_context(&callable),
+			p_distance(&CallObject<CALLABLE>),
+			p_batch(&CallObjectEach<CALLABLE>),
+			p_gradient(nullptr)
+		{}
+
+		// refers to an object through a const member function, which the batch loop calls directly
+		template<typename OBJECT, float(OBJECT::*DISTANCE)(const glm::vec3&) const>
+		static SDF Bind(const OBJECT& object)
+		{
+			return SDF(&object, &CallMember<OBJECT, DISTANCE>, &CallMemberEach<OBJECT, DISTANCE>);
+		}
+
+		// same with a second member function that evaluates the distance on duals for the gradient
+		template<typename OBJECT, float(OBJECT::*DISTANCE)(const glm::vec3&) const, Dual(OBJECT::*DUAL_DISTANCE)(const DualVec3&) const>
+		static SDF Bind(const OBJECT& object)
+		{
+			return SDF(&object, &CallMember<OBJECT, DISTANCE>, &CallMemberEach<OBJECT, DISTANCE>, &CallMemberGradient<OBJECT, DUAL_DISTANCE>);
+		}
+
+		float operator()(const glm::vec3& p) const
+		{
+			return p_distance(p_context, p);
+		}
+
+		void Evaluate(const glm::vec3* p_points, float* p_outDistances, size_t count) const;
+
+		bool HasGradient() const;
+		float Gradient(const glm::vec3& p, glm::vec3& outGradient) const;
+		void EvaluateGradients(const glm::vec3* p_points, float* p_outDistances, glm::vec3* p_outGradients, size_t count) const;
+
+		explicit operator bool() const;
+	};
+
+	constexpr size_t normalTapCount = 4;
 
 	glm::vec3 CalcNormal(const SDF& sdf, const glm::vec3& p);
+	// evaluations CalcNormal makes, one gradient or the taps
+	size_t NormalEvaluationCount(const SDF& sdf);
+
+	// CalcNormal split in two, so the taps of many points can be evaluated in one batch
+	void GetNormalTaps(const glm::vec3& p, glm::vec3* p_outTaps);
+	glm::vec3 NormalFromTaps(const float* p_tapDistances);
+	glm::vec3 GradientFromTaps(const float* p_tapDistances);
 }
\ No newline at end of file
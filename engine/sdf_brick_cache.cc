@@ -0,0 +1,475 @@
+#include "sdf_brick_cache.h"
+#include <algorithm>
+
+namespace Engine
+{
+	static constexpr size_t strideY = SdfBrickCache::brickSamples;
+	static constexpr size_t strideZ = SdfBrickCache::brickSamples * SdfBrickCache::brickSamples;
+	static constexpr int32_t keyBias = 1 << 20;// 21 bits per axis
+	static constexpr uint64_t keyMask = (1u << 21) - 1;
+
+	SdfBrickCache::SdfBrickCache() :
+		animationMargin(0.f),
+		isAllAnimated(false),
+		p_jobSystem(nullptr),
+		voxelSize(0.25f),
+		bandWidth(2.f),
+		maxBricks(0),
+		frame(0),
+		queuedKeys(new std::atomic<uint64_t>[queuedKeySlots]),
+		missCount(0)
+	{
+		Clear();
+	}
+
+	float SdfBrickCache::BrickExtent() const
+	{
+		return float(brickSamples - 1) * voxelSize;
+	}
+
+	glm::ivec3 SdfBrickCache::BrickOf(const glm::vec3& p) const
+	{
+		return glm::ivec3(glm::floor(p / BrickExtent()));
+	}
+
+	uint64_t SdfBrickCache::KeyOf(const glm::ivec3& brick)
+	{
+		return
+			(uint64_t(brick.x + keyBias) & keyMask) << 42 |
+			(uint64_t(brick.y + keyBias) & keyMask) << 21 |
+			(uint64_t(brick.z + keyBias) & keyMask);
+	}
+
+	glm::ivec3 SdfBrickCache::BrickOfKey(uint64_t key)
+	{
+		return glm::ivec3(
+			int32_t((key >> 42) & keyMask) - keyBias,
+			int32_t((key >> 21) & keyMask) - keyBias,
+			int32_t(key & keyMask) - keyBias);
+	}
+
+	bool SdfBrickCache::MarkQueued(uint64_t key) const
+	{
+		size_t hash = size_t((key * 0x9e3779b97f4a7c15ull) >> 32);
+
+		for (size_t i = 0; i < queuedKeyProbes; i++)
+		{
+			std::atomic<uint64_t>& entry = queuedKeys[(hash + i) & (queuedKeySlots - 1)];
+			uint64_t current = entry.load(std::memory_order_relaxed);
+
+			if (current == noKey && entry.compare_exchange_strong(current, key, std::memory_order_relaxed))
+				return true;
+			if (current == key)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool SdfBrickCache::FindBrick(const glm::vec3& p, uint32_t& outSlot, std::vector<uint64_t>* p_outMissedKeys) const
+	{
+		uint64_t key = KeyOf(BrickOf(p));
+		auto it = brickSlots.find(key);
+
+		if (it == brickSlots.end())
+		{
+			missCount.fetch_add(1, std::memory_order_relaxed);
+
+			// a brick is usually missed by many queries, only the first one queues it
+			if (MarkQueued(key))
+			{
+				if (p_outMissedKeys != nullptr)
+					p_outMissedKeys->push_back(key);
+				else
+				{
+					std::lock_guard<std::mutex> lock(missMutex);
+					missedKeys.push_back(key);
+				}
+			}
+
+			return false;
+		}
+
+		// only written when it changes so threads reading the same brick do not fight over the cache line
+		std::atomic<uint32_t>& lastUsed = lastUsedFrames[it->second];
+		if (lastUsed.load(std::memory_order_relaxed) != frame)
+			lastUsed.store(frame, std::memory_order_relaxed);
+
+		outSlot = it->second;
+		return bricks[it->second].inBand;
+	}
+
+	void SdfBrickCache::QueueMissedKeys(const std::vector<uint64_t>& keys) const
+	{
+		if (keys.empty())
+			return;
+
+		std::lock_guard<std::mutex> lock(missMutex);
+		missedKeys.insert(missedKeys.end(), keys.begin(), keys.end());
+	}
+
+	float SdfBrickCache::Interpolate(uint32_t slot, const glm::vec3& p, glm::vec3* p_outGradient) const
+	{
+		glm::vec3 local = (p - bricks[slot].origin) / voxelSize;
+		glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(local)), glm::ivec3(0), glm::ivec3(int32_t(brickSamples) - 2));
+		glm::vec3 f = glm::clamp(local - glm::vec3(cell), 0.f, 1.f);
+
+		const float* s = &samples[slot * samplesPerBrick + cell.z * strideZ + cell.y * strideY + cell.x];
+		float c000 = s[0];
+		float c100 = s[1];
+		float c010 = s[strideY];
+		float c110 = s[strideY + 1];
+		float c001 = s[strideZ];
+		float c101 = s[strideZ + 1];
+		float c011 = s[strideZ + strideY];
+		float c111 = s[strideZ + strideY + 1];
+
+		float x00 = glm::mix(c000, c100, f.x);
+		float x10 = glm::mix(c010, c110, f.x);
+		float x01 = glm::mix(c001, c101, f.x);
+		float x11 = glm::mix(c011, c111, f.x);
+		float y0 = glm::mix(x00, x10, f.y);
+		float y1 = glm::mix(x01, x11, f.y);
+
+		if (p_outGradient != nullptr)
+		{
+			// derivative of the interpolation inside the cell
+			float dx = glm::mix(glm::mix(c100 - c000, c110 - c010, f.y), glm::mix(c101 - c001, c111 - c011, f.y), f.z);
+			float dy = glm::mix(x10 - x00, x11 - x01, f.z);
+			float dz = y1 - y0;
+			*p_outGradient = glm::vec3(dx, dy, dz) / voxelSize;
+		}
+
+		return glm::mix(y0, y1, f.z);
+	}
+
+	void SdfBrickCache::SampleBrick(uint32_t slot, const glm::vec3& origin, glm::vec3* p_outPoints)
+	{
+		for (size_t z = 0; z < brickSamples; z++)
+		{
+			for (size_t y = 0; y < brickSamples; y++)
+			{
+				for (size_t x = 0; x < brickSamples; x++)
+					p_outPoints[z * strideZ + y * strideY + x] = origin + glm::vec3(float(x), float(y), float(z)) * voxelSize;
+			}
+		}
+
+		float* p_samples = &samples[slot * samplesPerBrick];
+		source.Evaluate(p_outPoints, p_samples, samplesPerBrick);
+
+		float closest = glm::abs(p_samples[0]);
+		for (size_t i = 1; i < samplesPerBrick; i++)
+			closest = glm::min(closest, glm::abs(p_samples[i]));
+
+		bricks[slot].inBand = closest <= bandWidth;
+	}
+
+	void SdfBrickCache::FillBrick(uint32_t slot, uint64_t key)
+	{
+		glm::vec3 origin = glm::vec3(BrickOfKey(key)) * BrickExtent();
+
+		glm::vec3 points[samplesPerBrick];
+		bricks[slot].key = key;
+		bricks[slot].origin = origin;
+		SampleBrick(slot, origin, points);
+
+		bricks[slot].isAnimated = isAllAnimated || (staticSource && IsAnimated(origin, points, &samples[slot * samplesPerBrick]));
+		lastUsedFrames[slot].store(frame, std::memory_order_relaxed);
+	}
+
+	bool SdfBrickCache::IsAnimated(const glm::vec3& origin, const glm::vec3* p_points, const float* p_samples) const
+	{
+		// differences this small are rounding in the combination of the static and the animated parts
+		float tolerance = voxelSize * 0.001f;
+
+		float staticSamples[samplesPerBrick];
+		staticSource.Evaluate(p_points, staticSamples, samplesPerBrick);
+
+		for (size_t i = 0; i < samplesPerBrick; i++)
+		{
+			if (glm::abs(staticSamples[i] - p_samples[i]) > tolerance)
+				return true;
+		}
+
+		// the animated geometry may move into the brick later, so a coarse lattice around it is checked too
+		constexpr size_t latticeSamples = 3 * 3 * 3;
+		glm::vec3 latticeOrigin = origin - glm::vec3(animationMargin);
+		float latticeStep = 0.5f * (BrickExtent() + 2.f * animationMargin);
+
+		glm::vec3 latticePoints[latticeSamples];
+		for (size_t i = 0; i < latticeSamples; i++)
+			latticePoints[i] = latticeOrigin + glm::vec3(float(i % 3), float(i / 3 % 3), float(i / 9)) * latticeStep;
+
+		float sourceSamples[latticeSamples];
+		source.Evaluate(latticePoints, sourceSamples, latticeSamples);
+		staticSource.Evaluate(latticePoints, staticSamples, latticeSamples);
+
+		for (size_t i = 0; i < latticeSamples; i++)
+		{
+			if (glm::abs(staticSamples[i] - sourceSamples[i]) > tolerance)
+				return true;
+		}
+
+		return false;
+	}
+
+	size_t SdfBrickCache::MakeRoom(size_t slotCount)
+	{
+		if (freeSlots.size() >= slotCount)
+			return slotCount;
+
+		// bricks read during the last frame are the working set and stay, the others go oldest first
+		evictionOrder.clear();
+		for (const auto& entry : brickSlots)
+		{
+			if (lastUsedFrames[entry.second].load(std::memory_order_relaxed) + 1 < frame)
+				evictionOrder.push_back(entry.second);
+		}
+
+		size_t evictionCount = std::min(slotCount - freeSlots.size(), evictionOrder.size());
+		std::nth_element(evictionOrder.begin(), evictionOrder.begin() + evictionCount, evictionOrder.end(), [&](uint32_t a, uint32_t b)
+		{
+			return lastUsedFrames[a].load(std::memory_order_relaxed) < lastUsedFrames[b].load(std::memory_order_relaxed);
+		});
+
+		for (size_t i = 0; i < evictionCount; i++)
+		{
+			uint32_t slot = evictionOrder[i];
+			brickSlots.erase(bricks[slot].key);
+			freeSlots.push_back(slot);
+		}
+
+		return std::min(slotCount, freeSlots.size());
+	}
+
+	void SdfBrickCache::Init(const SDF& _source, float _voxelSize, float _bandWidth, size_t _maxBricks, JobSystem* _p_jobSystem)
+	{
+		source = _source;
+		voxelSize = _voxelSize;
+		bandWidth = _bandWidth;
+		maxBricks = _maxBricks;
+		p_jobSystem = _p_jobSystem;
+
+		bricks.resize(maxBricks);
+		samples.resize(maxBricks * samplesPerBrick);
+		lastUsedFrames.reset(new std::atomic<uint32_t>[maxBricks]);
+
+		Clear();
+	}
+
+	void SdfBrickCache::Clear()
+	{
+		brickSlots.clear();
+		missedKeys.clear();
+		for (size_t i = 0; i < queuedKeySlots; i++)
+			queuedKeys[i].store(noKey, std::memory_order_relaxed);
+
+		freeSlots.clear();
+		for (size_t slot = maxBricks; slot > 0; slot--)
+			freeSlots.push_back(uint32_t(slot - 1));
+	}
+
+	void SdfBrickCache::SetStaticPart(const SDF& _staticSource, float _animationMargin)
+	{
+		staticSource = _staticSource;
+		animationMargin = _animationMargin;
+		isAllAnimated = false;
+
+		Clear();
+	}
+
+	void SdfBrickCache::SetAllAnimated()
+	{
+		staticSource = SDF();
+		animationMargin = 0.f;
+		isAllAnimated = true;
+
+		Clear();
+	}
+
+	void SdfBrickCache::Prefetch(const AABB& region)
+	{
+		glm::ivec3 min = BrickOf(region.min);
+		glm::ivec3 max = BrickOf(region.max);
+
+		std::lock_guard<std::mutex> lock(missMutex);
+		for (int32_t z = min.z; z <= max.z; z++)
+		{
+			for (int32_t y = min.y; y <= max.y; y++)
+			{
+				for (int32_t x = min.x; x <= max.x; x++)
+				{
+					uint64_t key = KeyOf(glm::ivec3(x, y, z));
+					if (brickSlots.find(key) == brickSlots.end() && MarkQueued(key))
+						missedKeys.push_back(key);
+				}
+			}
+		}
+	}
+
+	void SdfBrickCache::Update()
+	{
+		frame++;
+
+		fillKeys.clear();
+		{
+			std::lock_guard<std::mutex> lock(missMutex);
+			fillKeys.swap(missedKeys);
+		}
+
+		for (size_t i = 0; i < queuedKeySlots; i++)
+			queuedKeys[i].store(noKey, std::memory_order_relaxed);
+
+		// keys the queued set had no room for can repeat, and a brick may have been filled since it was queued
+		std::sort(fillKeys.begin(), fillKeys.end());
+		fillKeys.erase(std::unique(fillKeys.begin(), fillKeys.end()), fillKeys.end());
+		fillKeys.erase(std::remove_if(fillKeys.begin(), fillKeys.end(), [&](uint64_t key)
+		{
+			return brickSlots.find(key) != brickSlots.end();
+		}), fillKeys.end());
+
+		// bricks that do not fit are dropped, their queries fall back to the source and queue them again
+		fillKeys.resize(MakeRoom(fillKeys.size()));
+
+		// the animated bricks in use follow the source, the ones nobody reads wait until they are read again
+		refreshSlots.clear();
+		if (staticSource || isAllAnimated)
+		{
+			for (const auto& entry : brickSlots)
+			{
+				uint32_t slot = entry.second;
+				if (bricks[slot].isAnimated && lastUsedFrames[slot].load(std::memory_order_relaxed) + 1 >= frame)
+					refreshSlots.push_back(slot);
+			}
+		}
+
+		fillSlots.clear();
+		for (uint64_t key : fillKeys)
+		{
+			uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			brickSlots[key] = slot;
+			fillSlots.push_back(slot);
+		}
+
+		auto fill = [&](size_t i)
+		{
+			if (i < fillKeys.size())
+				FillBrick(fillSlots[i], fillKeys[i]);
+			else
+			{
+				glm::vec3 points[samplesPerBrick];
+				uint32_t slot = refreshSlots[i - fillKeys.size()];
+				SampleBrick(slot, bricks[slot].origin, points);
+			}
+		};
+
+		size_t jobCount = fillKeys.size() + refreshSlots.size();
+		if (p_jobSystem != nullptr)
+			p_jobSystem->ParallelFor(jobCount, 1, fill);
+		else
+		{
+			for (size_t i = 0; i < jobCount; i++)
+				fill(i);
+		}
+	}
+
+	float SdfBrickCache::Distance(const glm::vec3& p) const
+	{
+		uint32_t slot;
+		if (FindBrick(p, slot))
+			return Interpolate(slot, p, nullptr);
+
+		return source(p);
+	}
+
+	float SdfBrickCache::Gradient(const glm::vec3& p, glm::vec3& outGradient) const
+	{
+		uint32_t slot;
+		if (FindBrick(p, slot))
+			return Interpolate(slot, p, &outGradient);
+
+		return source.Gradient(p, outGradient);
+	}
+
+	float SdfBrickCache::DistanceOf(const void* p_context, const glm::vec3& p)
+	{
+		return static_cast<const SdfBrickCache*>(p_context)->Distance(p);
+	}
+
+	void SdfBrickCache::DistancesOf(const void* p_context, const glm::vec3* p_points, float* p_outDistances, size_t count)
+	{
+		const SdfBrickCache& cache = *static_cast<const SdfBrickCache*>(p_context);
+
+		// the points outside the cached bricks are passed on to the source as one batch, and their bricks are
+		// queued together
+		thread_local std::vector<glm::vec3> missedPoints;
+		thread_local std::vector<float> missedDistances;
+		thread_local std::vector<size_t> missedIndices;
+		thread_local std::vector<uint64_t> missedBrickKeys;
+		missedPoints.clear();
+		missedIndices.clear();
+		missedBrickKeys.clear();
+
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t slot;
+			if (cache.FindBrick(p_points[i], slot, &missedBrickKeys))
+				p_outDistances[i] = cache.Interpolate(slot, p_points[i], nullptr);
+			else
+			{
+				missedPoints.push_back(p_points[i]);
+				missedIndices.push_back(i);
+			}
+		}
+
+		cache.QueueMissedKeys(missedBrickKeys);
+
+		if (missedPoints.empty())
+			return;
+
+		missedDistances.resize(missedPoints.size());
+		cache.source.Evaluate(missedPoints.data(), missedDistances.data(), missedPoints.size());
+
+		for (size_t i = 0; i < missedIndices.size(); i++)
+			p_outDistances[missedIndices[i]] = missedDistances[i];
+	}
+
+	float SdfBrickCache::GradientOf(const void* p_context, const glm::vec3& p, glm::vec3& outGradient)
+	{
+		return static_cast<const SdfBrickCache*>(p_context)->Gradient(p, outGradient);
+	}
+
+	SDF SdfBrickCache::GetSDF() const
+	{
+		return SDF(this, &DistanceOf, &DistancesOf, &GradientOf);
+	}
+
+	float SdfBrickCache::GetErrorBound() const
+	{
+		// the interpolation blends samples up to half a cell diagonal away from the query
+		return 0.5f * glm::sqrt(3.f) * voxelSize;
+	}
+
+	size_t SdfBrickCache::GetBrickCount() const
+	{
+		return brickSlots.size();
+	}
+
+	size_t SdfBrickCache::GetAnimatedBrickCount() const
+	{
+		size_t count = 0;
+		for (const auto& entry : brickSlots)
+		{
+			if (bricks[entry.second].isAnimated)
+				count++;
+		}
+
+		return count;
+	}
+
+	uint64_t SdfBrickCache::GetMissCount() const
+	{
+		return missCount.load(std::memory_order_relaxed);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+#include "sdf.h"
+#include "collider.h"
+#include "job_system.h"
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+
+namespace Engine
+{
+	// sparse cache of an expensive sdf, sampled into bricks of 8^3 values near its surface and
+	// answered by trilinear interpolation, queries elsewhere go to the source
+	// bricks are filled on demand, a query that misses queues its brick for the next Update, which fills
+	// the queued bricks in jobs and evicts the least recently used ones when the cache is full
+	// a source that changes over time can be given its static part, bricks where the two differ nearby are
+	// animated and sampled again on every Update while they are in use, the others are kept, a source without
+	// a static part can have all of its bricks animated
+	// the interpolation is exact on flat surfaces but it is not an sdf itself, it changes up to lipschitzBound
+	// per unit moved and outside of curved surfaces it can exceed the source by up to GetErrorBound, users
+	// that step by the distance have to allow for both
+	// queries are safe from several threads at once but not while Update or Clear runs
+	class SdfBrickCache final
+	{
+	public:
+		static constexpr size_t brickSamples = 8;// per axis, neighbouring bricks share their border samples
+		static constexpr size_t samplesPerBrick = brickSamples * brickSamples * brickSamples;
+		// every axis of a cell blends differences of samples a voxel apart, each at most a voxel
+		static constexpr float lipschitzBound = 1.7320508f;
+
+	private:
+		struct Brick
+		{
+			uint64_t key;
+			glm::vec3 origin;
+			bool inBand;// far bricks keep no samples worth reading, they only remember not to fill again
+			bool isAnimated;
+		};
+
+		static constexpr size_t queuedKeySlots = 4096;// power of two
+		static constexpr size_t queuedKeyProbes = 8;
+		static constexpr uint64_t noKey = ~uint64_t(0);
+
+		SDF source;
+		SDF staticSource;
+		float animationMargin;
+		bool isAllAnimated;
+		JobSystem* p_jobSystem;
+		float voxelSize;
+		float bandWidth;
+		size_t maxBricks;
+
+		std::unordered_map<uint64_t, uint32_t> brickSlots;
+		std::vector<Brick> bricks;// by slot
+		std::vector<float> samples;// samplesPerBrick per slot, x fastest
+		std::unique_ptr<std::atomic<uint32_t>[]> lastUsedFrames;// by slot
+		std::vector<uint32_t> freeSlots;
+		uint32_t frame;
+
+		mutable std::mutex missMutex;
+		mutable std::vector<uint64_t> missedKeys;
+		std::unique_ptr<std::atomic<uint64_t>[]> queuedKeys;// open addressing set of the keys in missedKeys
+		std::vector<uint64_t> fillKeys;
+		std::vector<uint32_t> fillSlots;
+		std::vector<uint32_t> refreshSlots;
+		std::vector<uint32_t> evictionOrder;
+
+		mutable std::atomic<uint64_t> missCount;
+
+		float BrickExtent() const;
+		glm::ivec3 BrickOf(const glm::vec3& p) const;
+		static uint64_t KeyOf(const glm::ivec3& brick);
+		static glm::ivec3 BrickOfKey(uint64_t key);
+
+		// true for the first query to queue the key since the last Update, when the probes find no room the
+		// key is let through and Update drops the duplicates
+		bool MarkQueued(uint64_t key) const;
+		// slot of the brick holding p when it is cached and in the band, records the miss otherwise, into the
+		// given keys for the caller to queue in one go or straight into the queue
+		bool FindBrick(const glm::vec3& p, uint32_t& outSlot, std::vector<uint64_t>* p_outMissedKeys = nullptr) const;
+		void QueueMissedKeys(const std::vector<uint64_t>& keys) const;
+		float Interpolate(uint32_t slot, const glm::vec3& p, glm::vec3* p_outGradient) const;
+		void SampleBrick(uint32_t slot, const glm::vec3& origin, glm::vec3* p_outPoints);
+		void FillBrick(uint32_t slot, uint64_t key);
+		bool IsAnimated(const glm::vec3& origin, const glm::vec3* p_points, const float* p_samples) const;
+		size_t MakeRoom(size_t slotCount);
+
+		static float DistanceOf(const void* p_context, const glm::vec3& p);
+		static void DistancesOf(const void* p_context, const glm::vec3* p_points, float* p_outDistances, size_t count);
+		static float GradientOf(const void* p_context, const glm::vec3& p, glm::vec3& outGradient);
+
+	public:
+		SdfBrickCache();
+
+		// the voxel size sets the interpolation error, bricks whose samples are all further than the band
+		// width from the surface are not interpolated
+		void Init(const SDF& _source, float _voxelSize, float _bandWidth, size_t _maxBricks, JobSystem* _p_jobSystem = nullptr);
+		// drops every brick, has to be called when the source changes
+		void Clear();
+		// the static part has to match the source wherever the time-varying geometry is not close, the margin
+		// is how far that geometry moves while a brick stays cached, an empty sdf treats the source as static
+		void SetStaticPart(const SDF& _staticSource, float _animationMargin);
+		// every brick is animated, for sources that change over time without a static part to compare to
+		void SetAllAnimated();
+
+		// queues the bricks overlapping the region, like bodies that are about to query it
+		void Prefetch(const AABB& region);
+		void Update();
+
+		float Distance(const glm::vec3& p) const;
+		float Gradient(const glm::vec3& p, glm::vec3& outGradient) const;
+		// refers to this cache, so it is only valid while the cache exists
+		SDF GetSDF() const;
+
+		// how much a cached distance outside the surface can exceed the source, reached around sharp features
+		float GetErrorBound() const;
+		size_t GetBrickCount() const;
+		size_t GetAnimatedBrickCount() const;
+		uint64_t GetMissCount() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,586 @@
+#include "sdf_raycast.h"
+#include "simd.h"
+#include <vector>
+#include <memory>
+#include <glm.hpp>
+
+namespace Engine
+{
+	RaycastOptions::RaycastOptions() :
+		hitDistance(0.01f),
+		hitDistanceScale(0.f),
+		maxIterations(100),
+		stepScale(0.9f)
+	{}
+
+	ShapeCast MakeSphereCast(const glm::vec3& center, float radius, const glm::vec3& direction, float maxDistance)
+	{
+		return { center, center, radius, direction, maxDistance };
+	}
+
+	ShapeCast MakeCapsuleCast(const glm::vec3& a, const glm::vec3& b, float radius, const glm::vec3& direction, float maxDistance)
+	{
+		return { a, b, radius, direction, maxDistance };
+	}
+
+	// the step of enhanced sphere tracing, the plain step before the first one and when the last two distances
+	// give no slope
+	static float RelaxedStep(float step, float previousDistance, float distance, float stepScale)
+	{
+		float denominator = step + previousDistance - distance;
+		if (step <= 0.f || denominator == 0.f)
+			return distance;
+
+		return glm::abs(distance + stepScale * distance * (step - previousDistance + distance) / denominator);
+	}
+
+	static Float8 RelaxedStep(const Float8& step, const Float8& previousDistance, const Float8& distance, const Float8& stepScale)
+	{
+		const Float8 zero = Float8::Zero();
+		Float8 denominator = step + previousDistance - distance;
+		Float8 relaxed = distance + stepScale * distance * (step - previousDistance + distance) / denominator;
+		relaxed = Max(relaxed, zero - relaxed);
+
+		Float8 hasSlope = (step > zero) & ((denominator < zero) | (denominator > zero));
+		return Select(hasSlope, relaxed, distance);
+	}
+
+	// sphere tracing of the sdf offset by the radius, a radius of zero traces a ray
+	static bool TraceSphere(
+		const SDF& sdf,
+		const glm::vec3& origin,
+		float radius,
+		const glm::vec3& direction,
+		float maxDistance,
+		HitResult& outHitResult,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		// the first step has no length, so the first evaluation is at the origin
+		float t = 0.f;
+		float step = 0.f;
+		float previousDistance = 0.f;
+		float distance = 0.f;
+		uint32_t iterationCount = 0;
+		uint32_t evaluationCount = 0;
+		bool hit = false;
+
+		while (iterationCount < options.maxIterations)
+		{
+			float nextStep = RelaxedStep(step, previousDistance, distance, options.stepScale);
+
+			// the distance sphere reaching past the end means nothing is hit before it
+			if (t + nextStep >= maxDistance)
+			{
+				nextStep = distance;
+				if (t + nextStep >= maxDistance)
+					break;
+			}
+
+			float nextDistance = sdf(origin + direction * (t + nextStep)) - radius;
+			evaluationCount++;
+
+			// a gap between the two distance spheres may hide the surface, take the safe step instead
+			if (nextStep > distance && nextStep > distance + nextDistance)
+			{
+				nextStep = distance;
+				nextDistance = sdf(origin + direction * (t + nextStep)) - radius;
+				evaluationCount++;
+			}
+
+			t += nextStep;
+			step = nextStep;
+			previousDistance = distance;
+			distance = nextDistance;
+			iterationCount++;
+
+			if (distance < options.hitDistance + options.hitDistanceScale * t)
+			{
+				hit = true;
+				break;
+			}
+		}
+
+		if (hit)
+		{
+			glm::vec3 center = origin + direction * t;
+			outHitResult.normal = CalcNormal(sdf, center);
+			outHitResult.point = center - outHitResult.normal * radius;
+			outHitResult.distance = t;
+			evaluationCount += uint32_t(NormalEvaluationCount(sdf));
+		}
+
+		if (p_outStats != nullptr)
+			*p_outStats = { iterationCount, evaluationCount };
+
+		return hit;
+	}
+
+	// the packets of RaycastSDF, p_radii may be null for rays
+	static size_t TraceSpheres(
+		const SDF& sdf,
+		const glm::vec3* p_origins,
+		const float* p_radii,
+		const glm::vec3* p_directions,
+		const float* p_maxDistances,
+		size_t rayCount,
+		HitResult* p_outHitResults,
+		bool* p_outHits,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		constexpr size_t width = Float8::width;
+		constexpr uint32_t allLanes = (1u << width) - 1;
+
+		// the lanes are stored as columns so a step is a few packed operations
+		float originX[width], originY[width], originZ[width];
+		float directionX[width], directionY[width], directionZ[width];
+		float t[width], step[width], previousDistance[width], distance[width];
+		float radius[width], maxDistance[width], iterations[width];
+		float nextStep[width], nextDistance[width];
+		uint32_t evaluations[width];
+		size_t laneRays[width];
+
+		for (size_t lane = 0; lane < width; lane++)
+		{
+			originX[lane] = originY[lane] = originZ[lane] = 0.f;
+			directionX[lane] = directionY[lane] = directionZ[lane] = 0.f;
+			t[lane] = step[lane] = previousDistance[lane] = distance[lane] = 0.f;
+			radius[lane] = maxDistance[lane] = iterations[lane] = 0.f;
+			nextStep[lane] = nextDistance[lane] = 0.f;
+			evaluations[lane] = 0;
+		}
+
+		// evaluates the sdf at t + nextStep of the given lanes, packed to the front of one batch
+		auto evaluateLanes = [&](uint32_t lanes)
+		{
+			float pointX[width], pointY[width], pointZ[width];
+			Float8 along = Float8::Load(t) + Float8::Load(nextStep);
+			(Float8::Load(originX) + Float8::Load(directionX) * along).Store(pointX);
+			(Float8::Load(originY) + Float8::Load(directionY) * along).Store(pointY);
+			(Float8::Load(originZ) + Float8::Load(directionZ) * along).Store(pointZ);
+
+			glm::vec3 points[width];
+			float pointDistances[width];
+			size_t pointLanes[width];
+			size_t pointCount = 0;
+
+			for (; lanes != 0; lanes &= lanes - 1)
+			{
+				size_t lane = CountTrailingZeros(lanes);
+				points[pointCount] = glm::vec3(pointX[lane], pointY[lane], pointZ[lane]);
+				pointLanes[pointCount++] = lane;
+			}
+
+			sdf.Evaluate(points, pointDistances, pointCount);
+
+			for (size_t i = 0; i < pointCount; i++)
+			{
+				nextDistance[pointLanes[i]] = pointDistances[i] - radius[pointLanes[i]];
+				evaluations[pointLanes[i]]++;
+			}
+		};
+
+		const Float8 hitDistance = Float8::Set(options.hitDistance);
+		const Float8 hitDistanceScale = Float8::Set(options.hitDistanceScale);
+		const Float8 iterationCap = Float8::Set(float(options.maxIterations));
+		const Float8 stepScale = Float8::Set(options.stepScale);
+		const Float8 one = Float8::Set(1.f);
+
+		std::vector<size_t> hitRays;
+		uint32_t activeLanes = 0;
+		size_t nextRay = 0;
+
+		auto retireLanes = [&](uint32_t retiredLanes, bool hit)
+		{
+			activeLanes &= ~retiredLanes;
+
+			for (uint32_t lanes = retiredLanes; lanes != 0; lanes &= lanes - 1)
+			{
+				size_t lane = CountTrailingZeros(lanes);
+				size_t ray = laneRays[lane];
+
+				if (hit)
+				{
+					p_outHitResults[ray].point = p_origins[ray] + p_directions[ray] * t[lane];// the center until the normal is known
+					p_outHitResults[ray].distance = t[lane];
+					hitRays.push_back(ray);
+				}
+
+				p_outHits[ray] = hit;
+
+				if (p_outStats != nullptr)
+					p_outStats[ray] = { uint32_t(iterations[lane]), evaluations[lane] };
+			}
+		};
+
+		while (true)
+		{
+			// refill the retired lanes, a ray without an iteration misses right away like in the single version
+			for (uint32_t freeLanes = ~activeLanes & allLanes; freeLanes != 0 && nextRay < rayCount; freeLanes &= freeLanes - 1)
+			{
+				for (; nextRay < rayCount && (options.maxIterations == 0 || !(p_maxDistances[nextRay] > 0.f)); nextRay++)
+				{
+					p_outHits[nextRay] = false;
+
+					if (p_outStats != nullptr)
+						p_outStats[nextRay] = { 0, 0 };
+				}
+
+				if (nextRay == rayCount)
+					break;
+
+				size_t lane = CountTrailingZeros(freeLanes);
+				originX[lane] = p_origins[nextRay].x;
+				originY[lane] = p_origins[nextRay].y;
+				originZ[lane] = p_origins[nextRay].z;
+				directionX[lane] = p_directions[nextRay].x;
+				directionY[lane] = p_directions[nextRay].y;
+				directionZ[lane] = p_directions[nextRay].z;
+				t[lane] = step[lane] = previousDistance[lane] = distance[lane] = 0.f;
+				radius[lane] = p_radii != nullptr ? p_radii[nextRay] : 0.f;
+				maxDistance[lane] = p_maxDistances[nextRay];
+				iterations[lane] = 0.f;
+				evaluations[lane] = 0;
+				laneRays[lane] = nextRay++;
+				activeLanes |= 1u << lane;
+			}
+
+			if (activeLanes == 0)
+				break;
+
+			Float8 packedT = Float8::Load(t);
+			Float8 packedDistance = Float8::Load(distance);
+			Float8 packedMaxDistance = Float8::Load(maxDistance);
+
+			// the distance sphere reaching past the end means nothing is hit before it
+			Float8 packedNextStep = RelaxedStep(Float8::Load(step), Float8::Load(previousDistance), packedDistance, stepScale);
+			packedNextStep = Select(packedT + packedNextStep >= packedMaxDistance, packedDistance, packedNextStep);
+			packedNextStep.Store(nextStep);
+
+			retireLanes(uint32_t(MoveMask(packedT + packedDistance >= packedMaxDistance)) & activeLanes, false);
+			if (activeLanes == 0)
+				continue;
+
+			evaluateLanes(activeLanes);
+
+			// a gap between the two distance spheres may hide the surface, those lanes take the safe step instead
+			Float8 packedNextDistance = Float8::Load(nextDistance);
+			Float8 fallback = (packedNextStep > packedDistance) & (packedNextStep > packedDistance + packedNextDistance);
+			uint32_t fallbackLanes = uint32_t(MoveMask(fallback)) & activeLanes;
+
+			if (fallbackLanes != 0)
+			{
+				packedNextStep = Select(fallback, packedDistance, packedNextStep);
+				packedNextStep.Store(nextStep);
+				evaluateLanes(fallbackLanes);
+				packedNextDistance = Float8::Load(nextDistance);
+			}
+
+			Float8 nextT = packedT + packedNextStep;
+			Float8 nextIterations = Float8::Load(iterations) + one;
+			nextT.Store(t);
+			packedNextStep.Store(step);
+			packedDistance.Store(previousDistance);
+			packedNextDistance.Store(distance);
+			nextIterations.Store(iterations);
+
+			uint32_t hitLanes = uint32_t(MoveMask(packedNextDistance < hitDistance + hitDistanceScale * nextT)) & activeLanes;
+			retireLanes(hitLanes, true);
+			retireLanes(uint32_t(MoveMask(nextIterations >= iterationCap)) & activeLanes, false);
+		}
+
+		// the normals of all hits in one more batch
+		const size_t hitCount = hitRays.size();
+		if (hitCount == 0)
+			return 0;
+
+		if (p_outStats != nullptr)
+		{
+			for (size_t ray : hitRays)
+				p_outStats[ray].evaluationCount += uint32_t(NormalEvaluationCount(sdf));
+		}
+
+		if (sdf.HasGradient())
+		{
+			std::vector<glm::vec3> hitPoints(hitCount);
+			std::vector<float> hitDistances(hitCount);
+			std::vector<glm::vec3> gradients(hitCount);
+
+			for (size_t i = 0; i < hitCount; i++)
+				hitPoints[i] = p_outHitResults[hitRays[i]].point;
+
+			sdf.EvaluateGradients(hitPoints.data(), hitDistances.data(), gradients.data(), hitCount);
+
+			for (size_t i = 0; i < hitCount; i++)
+				p_outHitResults[hitRays[i]].normal = glm::normalize(gradients[i]);
+		}
+		else
+		{
+			std::vector<glm::vec3> taps(hitCount * normalTapCount);
+			std::vector<float> tapDistances(hitCount * normalTapCount);
+
+			for (size_t i = 0; i < hitCount; i++)
+				GetNormalTaps(p_outHitResults[hitRays[i]].point, &taps[i * normalTapCount]);
+
+			sdf.Evaluate(taps.data(), tapDistances.data(), taps.size());
+
+			for (size_t i = 0; i < hitCount; i++)
+				p_outHitResults[hitRays[i]].normal = NormalFromTaps(&tapDistances[i * normalTapCount]);
+		}
+
+		if (p_radii != nullptr)
+		{
+			for (size_t ray : hitRays)
+				p_outHitResults[ray].point -= p_outHitResults[ray].normal * p_radii[ray];
+		}
+
+		return hitCount;
+	}
+
+
+	// lower bound of the sdf along the segment a b, between two samples a length apart the sdf stays above
+	// (d0 + d1 - length) / 2, intervals whose bound is further than the tolerance below the smallest sample are
+	// split, the tolerance shrinks with the distance to the surface so the steps of a cast stay proportional to it
+	static float SegmentDistanceBound(
+		const SDF& sdf,
+		const glm::vec3& a,
+		const glm::vec3& b,
+		float radius,
+		float hitDistance,
+		glm::vec3& outClosestPoint,
+		float& outClosestDistance,
+		uint32_t& inoutEvaluationCount)
+	{
+		struct Interval
+		{
+			float s0, d0;
+			float s1, d1;
+		};
+
+		constexpr size_t maxSampleCount = 64;
+		constexpr size_t maxIntervalCount = 128;
+
+		float length = glm::distance(a, b);
+		glm::vec3 direction = length > 0.f ? (b - a) / length : glm::vec3(0.f);
+		const float minIntervalLength = glm::max(hitDistance, 1e-4f);
+
+		// the first samples are a radius apart, like the query points of the world test
+		size_t sampleCount = glm::clamp(size_t(glm::ceil(length / glm::max(radius, 1e-4f))) + 1, size_t(2), maxSampleCount);
+		glm::vec3 points[maxSampleCount];
+		float distances[maxSampleCount];
+		float along[maxSampleCount];
+
+		for (size_t i = 0; i < sampleCount; i++)
+		{
+			along[i] = length * float(i) / float(sampleCount - 1);
+			points[i] = a + direction * along[i];
+		}
+
+		sdf.Evaluate(points, distances, sampleCount);
+		inoutEvaluationCount += uint32_t(sampleCount);
+
+		Interval intervals[maxIntervalCount];
+		size_t intervalCount = 0;
+		outClosestPoint = points[0];
+		outClosestDistance = distances[0];
+
+		for (size_t i = 0; i < sampleCount; i++)
+		{
+			if (distances[i] < outClosestDistance)
+			{
+				outClosestPoint = points[i];
+				outClosestDistance = distances[i];
+			}
+
+			if (i + 1 < sampleCount)
+				intervals[intervalCount++] = { along[i], distances[i], along[i + 1], distances[i + 1] };
+		}
+
+		float bound = outClosestDistance;
+
+		while (intervalCount > 0)
+		{
+			Interval interval = intervals[--intervalCount];
+			float intervalLength = interval.s1 - interval.s0;
+			float intervalBound = glm::min(glm::min(interval.d0, interval.d1), 0.5f * (interval.d0 + interval.d1 - intervalLength));
+			float tolerance = glm::max(hitDistance, 0.5f * (outClosestDistance - radius));
+
+			if (intervalBound >= outClosestDistance - tolerance || intervalLength < minIntervalLength || intervalCount + 2 > maxIntervalCount)
+			{
+				bound = glm::min(bound, intervalBound);
+				continue;
+			}
+
+			float s = 0.5f * (interval.s0 + interval.s1);
+			glm::vec3 point = a + direction * s;
+			float distance = sdf(point);
+			inoutEvaluationCount++;
+
+			if (distance < outClosestDistance)
+			{
+				outClosestPoint = point;
+				outClosestDistance = distance;
+			}
+
+			intervals[intervalCount++] = { interval.s0, interval.d0, s, distance };
+			intervals[intervalCount++] = { s, distance, interval.s1, interval.d1 };
+		}
+
+		return bound;
+	}
+
+	static bool TraceCapsule(
+		const SDF& sdf,
+		const ShapeCast& cast,
+		HitResult& outHitResult,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		float t = 0.f;
+		uint32_t iterationCount = 0;
+		uint32_t evaluationCount = 0;
+		glm::vec3 closestPoint(0.f);
+		float closestDistance = 0.f;
+		bool hit = false;
+
+		while (iterationCount < options.maxIterations && t < cast.maxDistance)
+		{
+			glm::vec3 shift = cast.direction * t;
+			float gap = SegmentDistanceBound(sdf, cast.a + shift, cast.b + shift, cast.radius, options.hitDistance, closestPoint, closestDistance, evaluationCount) - cast.radius;
+			iterationCount++;
+
+			if (gap < options.hitDistance + options.hitDistanceScale * t)
+			{
+				hit = true;
+				break;
+			}
+
+			if (t + gap >= cast.maxDistance)
+				break;
+
+			t += gap;
+		}
+
+		if (hit)
+		{
+			outHitResult.normal = CalcNormal(sdf, closestPoint);
+			outHitResult.point = closestPoint - outHitResult.normal * closestDistance;
+			outHitResult.distance = t;
+			evaluationCount += uint32_t(NormalEvaluationCount(sdf));
+		}
+
+		if (p_outStats != nullptr)
+			*p_outStats = { iterationCount, evaluationCount };
+
+		return hit;
+	}
+
+	bool RaycastSDF(
+		const SDF& sdf,
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		HitResult& outHitResult,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		return TraceSphere(sdf, origin, 0.f, direction, maxDistance, outHitResult, options, p_outStats);
+	}
+
+	size_t RaycastSDF(
+		const SDF& sdf,
+		const glm::vec3* p_origins,
+		const glm::vec3* p_directions,
+		const float* p_maxDistances,
+		size_t rayCount,
+		HitResult* p_outHitResults,
+		bool* p_outHits,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		return TraceSpheres(sdf, p_origins, nullptr, p_directions, p_maxDistances, rayCount, p_outHitResults, p_outHits, options, p_outStats);
+	}
+
+	bool ShapeCastSDF(
+		const SDF& sdf,
+		const ShapeCast& cast,
+		HitResult& outHitResult,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		if (cast.a == cast.b)
+			return TraceSphere(sdf, cast.a, cast.radius, cast.direction, cast.maxDistance, outHitResult, options, p_outStats);
+
+		return TraceCapsule(sdf, cast, outHitResult, options, p_outStats);
+	}
+
+	size_t ShapeCastSDF(
+		const SDF& sdf,
+		const ShapeCast* p_casts,
+		size_t castCount,
+		HitResult* p_outHitResults,
+		bool* p_outHits,
+		const RaycastOptions& options,
+		RaycastStats* p_outStats)
+	{
+		std::vector<size_t> sphereCasts;
+		std::vector<glm::vec3> origins;
+		std::vector<float> radii;
+		std::vector<glm::vec3> directions;
+		std::vector<float> maxDistances;
+		size_t hitCount = 0;
+
+		for (size_t i = 0; i < castCount; i++)
+		{
+			const ShapeCast& cast = p_casts[i];
+
+			if (cast.a != cast.b)
+			{
+				p_outHits[i] = TraceCapsule(sdf, cast, p_outHitResults[i], options, p_outStats != nullptr ? &p_outStats[i] : nullptr);
+				hitCount += p_outHits[i] ? 1 : 0;
+				continue;
+			}
+
+			sphereCasts.push_back(i);
+			origins.push_back(cast.a);
+			radii.push_back(cast.radius);
+			directions.push_back(cast.direction);
+			maxDistances.push_back(cast.maxDistance);
+		}
+
+		if (sphereCasts.empty())
+			return hitCount;
+
+		const size_t sphereCount = sphereCasts.size();
+		std::vector<HitResult> hitResults(sphereCount);
+		std::unique_ptr<bool[]> hits(new bool[sphereCount]);
+		std::vector<RaycastStats> stats(p_outStats != nullptr ? sphereCount : 0);
+
+		hitCount += TraceSpheres(
+			sdf,
+			origins.data(),
+			radii.data(),
+			directions.data(),
+			maxDistances.data(),
+			sphereCount,
+			hitResults.data(),
+			hits.get(),
+			options,
+			p_outStats != nullptr ? stats.data() : nullptr);
+
+		for (size_t i = 0; i < sphereCount; i++)
+		{
+			size_t cast = sphereCasts[i];
+			p_outHits[cast] = hits[i];
+
+			if (hits[i])
+				p_outHitResults[cast] = hitResults[i];
+
+			if (p_outStats != nullptr)
+				p_outStats[cast] = stats[i];
+		}
+
+		return hitCount;
+	}
+}
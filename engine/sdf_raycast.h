@@ -0,0 +1,86 @@
+#pragma once
+#include "sdf.h"
+#include "hit_result.h"
+#include <cstdint>
+
+namespace Engine
+{
+	// how a ray is traced, a ray hits when the sdf drops below hitDistance + hitDistanceScale * t
+	struct RaycastOptions
+	{
+		float hitDistance;
+		float hitDistanceScale;// grows the hit distance along the ray like a pixel footprint, zero for a fixed one
+		size_t maxIterations;
+		// over-relaxation of the steps, like the cone pass shader, the next step extrapolates the surface as a
+		// plane through the last two distances and falls back to the safe step when the two distance spheres
+		// do not overlap, zero gives plain sphere tracing
+		float stepScale;
+
+		RaycastOptions();
+	};
+
+	struct RaycastStats
+	{
+		uint32_t iterationCount;
+		uint32_t evaluationCount;// sdf evaluations, the rejected over-relaxed steps and the normal included
+	};
+
+	// a sphere or capsule moved along a direction, the capsule is the segment a b grown by the radius and a
+	// sphere has both ends at its center
+	struct ShapeCast
+	{
+		glm::vec3 a;
+		glm::vec3 b;
+		float radius;
+		glm::vec3 direction;
+		float maxDistance;
+	};
+
+	ShapeCast MakeSphereCast(const glm::vec3& center, float radius, const glm::vec3& direction, float maxDistance);
+	ShapeCast MakeCapsuleCast(const glm::vec3& a, const glm::vec3& b, float radius, const glm::vec3& direction, float maxDistance);
+
+	bool RaycastSDF(
+		const SDF& sdf,
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		HitResult& outHitResult,
+		const RaycastOptions& options = RaycastOptions(),
+		RaycastStats* p_outStats = nullptr);
+
+	// traces the rays 8 at a time, every step moves all lanes of the packet with one batched sdf evaluation
+	// of the lanes still marching, a lane whose ray hit or ran out is refilled with the next ray right away
+	// p_outHits tells which results were written, returns the number of hits
+	size_t RaycastSDF(
+		const SDF& sdf,
+		const glm::vec3* p_origins,
+		const glm::vec3* p_directions,
+		const float* p_maxDistances,
+		size_t rayCount,
+		HitResult* p_outHitResults,
+		bool* p_outHits,
+		const RaycastOptions& options = RaycastOptions(),
+		RaycastStats* p_outStats = nullptr);
+
+	// the hit point is on the sdf surface, the distance is how far the shape moved before touching it
+	// a sphere traces the sdf offset by its radius, so it costs the same as a ray, a capsule steps by a lower
+	// bound of the sdf along its segment, sampled a radius apart and refined where the bound is loose, so a
+	// capsule moving flat over a flat surface samples its segment finely near the end, capsules do not take
+	// over-relaxed steps
+	bool ShapeCastSDF(
+		const SDF& sdf,
+		const ShapeCast& cast,
+		HitResult& outHitResult,
+		const RaycastOptions& options = RaycastOptions(),
+		RaycastStats* p_outStats = nullptr);
+
+	// the spheres are traced in packets like RaycastSDF, the capsules one by one
+	size_t ShapeCastSDF(
+		const SDF& sdf,
+		const ShapeCast* p_casts,
+		size_t castCount,
+		HitResult* p_outHitResults,
+		bool* p_outHits,
+		const RaycastOptions& options = RaycastOptions(),
+		RaycastStats* p_outStats = nullptr);
+}
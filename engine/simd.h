@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ENGINE_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENGINE_SIMD_SSE
+#endif
+
+namespace Engine
+{
+	// 8 float lanes, one avx2 register, two sse registers or a plain array as fallback
+	// comparisons return lanes with all bits set where true, combine them with & and |
+	struct Float8
+	{
+		static constexpr size_t width = 8;
+
+#if defined(ENGINE_SIMD_AVX2)
+		__m256 v;
+#elif defined(ENGINE_SIMD_SSE)
+		__m128 lo;
+		__m128 hi;
+#else
+		float lanes[8];
+#endif
+
+		static Float8 Load(const float* p_values);
+		static Float8 Set(float value);
+		static Float8 Zero();
+		void Store(float* p_values) const;
+	};
+
+#if defined(ENGINE_SIMD_AVX2)
+
+	inline Float8 Float8::Load(const float* p_values) { return { _mm256_loadu_ps(p_values) }; }
+	inline Float8 Float8::Set(float value) { return { _mm256_set1_ps(value) }; }
+	inline Float8 Float8::Zero() { return { _mm256_setzero_ps() }; }
+	inline void Float8::Store(float* p_values) const { _mm256_storeu_ps(p_values, v); }
+
+	inline Float8 operator+(const Float8& a, const Float8& b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline Float8 operator-(const Float8& a, const Float8& b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline Float8 operator*(const Float8& a, const Float8& b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	inline Float8 operator/(const Float8& a, const Float8& b) { return { _mm256_div_ps(a.v, b.v) }; }
+	inline Float8 operator&(const Float8& a, const Float8& b) { return { _mm256_and_ps(a.v, b.v) }; }
+	inline Float8 operator|(const Float8& a, const Float8& b) { return { _mm256_or_ps(a.v, b.v) }; }
+	inline Float8 operator<(const Float8& a, const Float8& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+	inline Float8 operator>(const Float8& a, const Float8& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+	inline Float8 operator<=(const Float8& a, const Float8& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+	inline Float8 operator>=(const Float8& a, const Float8& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+	inline Float8 Min(const Float8& a, const Float8& b) { return { _mm256_min_ps(a.v, b.v) }; }
+	inline Float8 Max(const Float8& a, const Float8& b) { return { _mm256_max_ps(a.v, b.v) }; }
+	inline Float8 Sqrt(const Float8& a) { return { _mm256_sqrt_ps(a.v) }; }
+	inline Float8 Select(const Float8& mask, const Float8& whenTrue, const Float8& whenFalse) { return { _mm256_blendv_ps(whenFalse.v, whenTrue.v, mask.v) }; }
+	inline int MoveMask(const Float8& mask) { return _mm256_movemask_ps(mask.v); }
+
+#elif defined(ENGINE_SIMD_SSE)
+
+	inline __m128 SelectSse(__m128 mask, __m128 whenTrue, __m128 whenFalse) { return _mm_or_ps(_mm_and_ps(mask, whenTrue), _mm_andnot_ps(mask, whenFalse)); }
+
+	inline Float8 Float8::Load(const float* p_values) { return { _mm_loadu_ps(p_values), _mm_loadu_ps(p_values + 4) }; }
+	inline Float8 Float8::Set(float value) { return { _mm_set1_ps(value), _mm_set1_ps(value) }; }
+	inline Float8 Float8::Zero() { return { _mm_setzero_ps(), _mm_setzero_ps() }; }
+	inline void Float8::Store(float* p_values) const { _mm_storeu_ps(p_values, lo); _mm_storeu_ps(p_values + 4, hi); }
+
+	inline Float8 operator+(const Float8& a, const Float8& b) { return { _mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi) }; }
+	inline Float8 operator-(const Float8& a, const Float8& b) { return { _mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi) }; }
+	inline Float8 operator*(const Float8& a, const Float8& b) { return { _mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi) }; }
+	inline Float8 operator/(const Float8& a, const Float8& b) { return { _mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi) }; }
+	inline Float8 operator&(const Float8& a, const Float8& b) { return { _mm_and_ps(a.lo, b.lo), _mm_and_ps(a.hi, b.hi) }; }
+	inline Float8 operator|(const Float8& a, const Float8& b) { return { _mm_or_ps(a.lo, b.lo), _mm_or_ps(a.hi, b.hi) }; }
+	inline Float8 operator<(const Float8& a, const Float8& b) { return { _mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi) }; }
+	inline Float8 operator>(const Float8& a, const Float8& b) { return { _mm_cmpgt_ps(a.lo, b.lo), _mm_cmpgt_ps(a.hi, b.hi) }; }
+	inline Float8 operator<=(const Float8& a, const Float8& b) { return { _mm_cmple_ps(a.lo, b.lo), _mm_cmple_ps(a.hi, b.hi) }; }
+	inline Float8 operator>=(const Float8& a, const Float8& b) { return { _mm_cmpge_ps(a.lo, b.lo), _mm_cmpge_ps(a.hi, b.hi) }; }
+	inline Float8 Min(const Float8& a, const Float8& b) { return { _mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi) }; }
+	inline Float8 Max(const Float8& a, const Float8& b) { return { _mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi) }; }
+	inline Float8 Sqrt(const Float8& a) { return { _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) }; }
+	inline Float8 Select(const Float8& mask, const Float8& whenTrue, const Float8& whenFalse) { return { SelectSse(mask.lo, whenTrue.lo, whenFalse.lo), SelectSse(mask.hi, whenTrue.hi, whenFalse.hi) }; }
+	inline int MoveMask(const Float8& mask) { return _mm_movemask_ps(mask.lo) | (_mm_movemask_ps(mask.hi) << 4); }
+
+#else
+
+	inline float MaskLane(bool test)
+	{
+		uint32_t bits = test ? 0xFFFFFFFFu : 0u;
+		float lane;
+		std::memcpy(&lane, &bits, sizeof(float));
+		return lane;
+	}
+
+	inline uint32_t LaneBits(float lane)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &lane, sizeof(float));
+		return bits;
+	}
+
+#define ENGINE_FLOAT8_LANEWISE(expression) Float8 r; for (size_t i = 0; i < 8; i++) r.lanes[i] = (expression); return r;
+
+	inline Float8 Float8::Load(const float* p_values) { Float8 r; std::memcpy(r.lanes, p_values, sizeof(r.lanes)); return r; }
+	inline Float8 Float8::Set(float value) { ENGINE_FLOAT8_LANEWISE(value) }
+	inline Float8 Float8::Zero() { ENGINE_FLOAT8_LANEWISE(0.f) }
+	inline void Float8::Store(float* p_values) const { std::memcpy(p_values, lanes, sizeof(lanes)); }
+
+	inline Float8 operator+(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(a.lanes[i] + b.lanes[i]) }
+	inline Float8 operator-(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(a.lanes[i] - b.lanes[i]) }
+	inline Float8 operator*(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(a.lanes[i] * b.lanes[i]) }
+	inline Float8 operator/(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(a.lanes[i] / b.lanes[i]) }
+	inline Float8 operator&(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(MaskLane((LaneBits(a.lanes[i]) & LaneBits(b.lanes[i])) != 0)) }
+	inline Float8 operator|(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(MaskLane((LaneBits(a.lanes[i]) | LaneBits(b.lanes[i])) != 0)) }
+	inline Float8 operator<(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(MaskLane(a.lanes[i] < b.lanes[i])) }
+	inline Float8 operator>(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(MaskLane(a.lanes[i] > b.lanes[i])) }
+	inline Float8 operator<=(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(MaskLane(a.lanes[i] <= b.lanes[i])) }
+	inline Float8 operator>=(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(MaskLane(a.lanes[i] >= b.lanes[i])) }
+	inline Float8 Min(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(a.lanes[i] < b.lanes[i] ? a.lanes[i] : b.lanes[i]) }
+	inline Float8 Max(const Float8& a, const Float8& b) { ENGINE_FLOAT8_LANEWISE(a.lanes[i] > b.lanes[i] ? a.lanes[i] : b.lanes[i]) }
+	inline Float8 Sqrt(const Float8& a) { ENGINE_FLOAT8_LANEWISE(std::sqrt(a.lanes[i])) }
+	inline Float8 Select(const Float8& mask, const Float8& whenTrue, const Float8& whenFalse) { ENGINE_FLOAT8_LANEWISE(LaneBits(mask.lanes[i]) != 0 ? whenTrue.lanes[i] : whenFalse.lanes[i]) }
+	inline int MoveMask(const Float8& mask) { int bits = 0; for (size_t i = 0; i < 8; i++) bits |= (LaneBits(mask.lanes[i]) >> 31) << i; return bits; }
+
+#undef ENGINE_FLOAT8_LANEWISE
+
+#endif
+
+	// index of the lowest set bit, bits must not be zero
+	inline int CountTrailingZeros(uint32_t bits)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, bits);
+		return int(index);
+#else
+		return __builtin_ctz(bits);
+#endif
+	}
+}
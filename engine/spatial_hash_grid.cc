@@ -0,0 +1,220 @@
+#include "spatial_hash_grid.h"
+#include <algorithm>
+#include <glm.hpp>
+
+namespace Engine
+{
+	SpatialHashGrid::SpatialHashGrid() :
+		currentCellSize(1.f),
+		inverseCellSize(1.f),
+		bucketMask(0),
+		cellSize(0.f)
+	{}
+
+	float SpatialHashGrid::CalculateCellSize()
+	{
+		extents.clear();
+		for (size_t i = 0; i < proxyAabbs.size(); i++)
+		{
+			if (!proxyIsActive[i] || proxyAabbs[i].min.x > proxyAabbs[i].max.x)
+				continue;
+
+			glm::vec3 size = proxyAabbs[i].max - proxyAabbs[i].min;
+			extents.push_back(glm::max(size.x, glm::max(size.y, size.z)));
+		}
+
+		if (extents.empty())
+			return 1.f;
+
+		std::nth_element(extents.begin(), extents.begin() + extents.size() / 2, extents.end());
+		float median = extents[extents.size() / 2];
+
+		float largest = median;
+		for (size_t i = extents.size() / 2; i < extents.size(); i++)
+		{
+			if (extents[i] <= 2.f * median)
+				largest = glm::max(largest, extents[i]);
+		}
+
+		return largest;
+	}
+
+	glm::ivec3 SpatialHashGrid::CellOf(const glm::vec3& point) const
+	{
+		return glm::ivec3(glm::floor(point * inverseCellSize));
+	}
+
+	uint32_t SpatialHashGrid::BucketOf(const glm::ivec3& cell) const
+	{
+		uint32_t hash =
+			(uint32_t(cell.x) * 73856093u) ^
+			(uint32_t(cell.y) * 19349663u) ^
+			(uint32_t(cell.z) * 83492791u);
+
+		return hash & bucketMask;
+	}
+
+	void SpatialHashGrid::AddProxy(uint32_t proxyId, const AABB& aabb)
+	{
+		if (proxyId >= proxyAabbs.size())
+		{
+			proxyAabbs.resize(proxyId + 1);
+			proxyIsActive.resize(proxyId + 1, false);
+		}
+
+		proxyAabbs[proxyId] = aabb;
+		proxyIsActive[proxyId] = true;
+	}
+
+	void SpatialHashGrid::RemoveProxy(uint32_t proxyId)
+	{
+		if (proxyId < proxyIsActive.size())
+			proxyIsActive[proxyId] = false;
+	}
+
+	void SpatialHashGrid::UpdateProxy(uint32_t proxyId, const AABB& aabb)
+	{
+		proxyAabbs[proxyId] = aabb;
+	}
+
+	void SpatialHashGrid::Update()
+	{
+		currentCellSize = (cellSize > 0.f) ? cellSize : CalculateCellSize();
+		if (!(currentCellSize > 0.f))
+			currentCellSize = 1.f;
+
+		inverseCellSize = 1.f / currentCellSize;
+
+		size_t activeCount = 0;
+		for (bool isActive : proxyIsActive)
+			activeCount += isActive ? 1 : 0;
+
+		// twice as many buckets as proxies keeps collisions between distinct cells rare
+		uint32_t bucketCount = 64;
+		while (bucketCount < 2 * activeCount)
+			bucketCount <<= 1;
+
+		bucketMask = bucketCount - 1;
+
+		// counting sort of the proxies into the buckets of their min corner cells, first count then scatter,
+		// the buckets are hashed once and kept for the scatter
+		bucketStarts.assign(bucketCount + 1, 0);
+		entryBuckets.clear();
+		largeEntries.clear();
+
+		for (size_t i = 0; i < proxyAabbs.size(); i++)
+		{
+			const AABB& aabb = proxyAabbs[i];
+			if (!proxyIsActive[i] || aabb.min.x > aabb.max.x)
+				continue;
+
+			glm::vec3 size = aabb.max - aabb.min;
+			if (glm::max(size.x, glm::max(size.y, size.z)) > currentCellSize)
+			{
+				largeEntries.push_back({ aabb, glm::ivec3(0), uint32_t(i) });
+				continue;
+			}
+
+			uint32_t bucket = BucketOf(CellOf(aabb.min));
+			entryBuckets.push_back(bucket);
+			bucketStarts[bucket + 1]++;
+		}
+
+		for (uint32_t i = 0; i < bucketCount; i++)
+			bucketStarts[i + 1] += bucketStarts[i];
+
+		entries.resize(bucketStarts[bucketCount]);
+		bucketFill.assign(bucketStarts.begin(), bucketStarts.end() - 1);
+
+		size_t entryIndex = 0;
+		for (size_t i = 0; i < proxyAabbs.size(); i++)
+		{
+			const AABB& aabb = proxyAabbs[i];
+			if (!proxyIsActive[i] || aabb.min.x > aabb.max.x)
+				continue;
+
+			glm::vec3 size = aabb.max - aabb.min;
+			if (glm::max(size.x, glm::max(size.y, size.z)) > currentCellSize)
+				continue;
+
+			entries[bucketFill[entryBuckets[entryIndex++]]++] = { aabb, CellOf(aabb.min), uint32_t(i) };
+		}
+
+		// spelled out rather than calling AabbOverlaps, which is not inlined across files
+		auto overlaps = [](const AABB& a, const AABB& b)
+		{
+			return
+				a.min.x <= b.max.x && a.max.x >= b.min.x &&
+				a.min.y <= b.max.y && a.max.y >= b.min.y &&
+				a.min.z <= b.max.z && a.max.z >= b.min.z;
+		};
+
+		// the neighbours ahead of a cell, each pair of neighbouring cells is visited from one side only
+		static const glm::ivec3 forwardNeighbours[13] = {
+			{ 1, -1, -1 }, { 1, -1, 0 }, { 1, -1, 1 }, { 1, 0, -1 }, { 1, 0, 0 }, { 1, 0, 1 }, { 1, 1, -1 }, { 1, 1, 0 }, { 1, 1, 1 },
+			{ 0, 1, -1 }, { 0, 1, 0 }, { 0, 1, 1 },
+			{ 0, 0, 1 }
+		};
+
+		pairs.clear();
+
+		for (uint32_t bucket = 0; bucket < bucketCount; bucket++)
+		{
+			uint32_t start = bucketStarts[bucket];
+			uint32_t end = bucketStarts[bucket + 1];
+
+			for (uint32_t i = start; i < end; i++)
+			{
+				const Entry& entry1 = entries[i];
+
+				// distinct cells hashed into one bucket do not pair
+				for (uint32_t j = i + 1; j < end; j++)
+				{
+					const Entry& entry2 = entries[j];
+					if (entry1.cell == entry2.cell && overlaps(entry1.aabb, entry2.aabb))
+						pairs.push_back(PairFromKey(MakePairKey(entry1.proxyId, entry2.proxyId)));
+				}
+
+				for (const glm::ivec3& offset : forwardNeighbours)
+				{
+					glm::ivec3 cell = entry1.cell + offset;
+					uint32_t neighbourBucket = BucketOf(cell);
+
+					for (uint32_t j = bucketStarts[neighbourBucket]; j < bucketStarts[neighbourBucket + 1]; j++)
+					{
+						const Entry& entry2 = entries[j];
+						if (entry2.cell == cell && overlaps(entry1.aabb, entry2.aabb))
+							pairs.push_back(PairFromKey(MakePairKey(entry1.proxyId, entry2.proxyId)));
+					}
+				}
+			}
+		}
+
+		for (size_t i = 0; i < largeEntries.size(); i++)
+		{
+			const Entry& large = largeEntries[i];
+
+			for (size_t j = i + 1; j < largeEntries.size(); j++)
+			{
+				if (overlaps(large.aabb, largeEntries[j].aabb))
+					pairs.push_back(PairFromKey(MakePairKey(large.proxyId, largeEntries[j].proxyId)));
+			}
+
+			for (const Entry& entry : entries)
+			{
+				if (overlaps(large.aabb, entry.aabb))
+					pairs.push_back(PairFromKey(MakePairKey(large.proxyId, entry.proxyId)));
+			}
+		}
+	}
+
+	float SpatialHashGrid::GetCurrentCellSize() const
+	{
+		return currentCellSize;
+	}
+
+	const std::vector<BroadphasePair>& SpatialHashGrid::GetPairs() const
+	{
+		return pairs;
+	}
+}
@@ -0,0 +1,306 @@
+#include "sweep_and_prune.h"
+#include "simd.h"
+#include <algorithm>
+
+namespace Engine
+{
+	uint64_t MakePairKey(uint32_t firstId, uint32_t secondId)
+	{
+		if (firstId > secondId)
+			std::swap(firstId, secondId);
+
+		return (uint64_t(firstId) << 32) | uint64_t(secondId);
+	}
+
+	BroadphasePair PairFromKey(uint64_t key)
+	{
+		return { uint32_t(key >> 32), uint32_t(key & 0xFFFFFFFF) };
+	}
+
+	bool SweepAndPrune::EndpointLess(const Endpoint& lhs, const Endpoint& rhs)
+	{
+		// start points are placed before end points with equal value so touching aabbs overlap
+		return lhs.value < rhs.value || (lhs.value == rhs.value && !lhs.isMax && rhs.isMax);
+	}
+
+	SweepAndPrune::SweepAndPrune() :
+		sweepAxis(0),
+		needsFullSort(false),
+		hasRemovedEndpoints(false),
+		adaptiveSweepAxis(true)
+	{}
+
+	void SweepAndPrune::RemoveEndpoints()
+	{
+		endpoints.erase(
+			std::remove_if(endpoints.begin(), endpoints.end(), [this](const Endpoint& endpoint) { return proxyIsRemoved[endpoint.proxyId]; }),
+			endpoints.end()
+		);
+
+		std::fill(proxyIsRemoved.begin(), proxyIsRemoved.end(), false);
+		hasRemovedEndpoints = false;
+	}
+
+	void SweepAndPrune::ChooseSweepAxis()
+	{
+		glm::vec3 sum(0.f);
+		glm::vec3 sumSquared(0.f);
+		float count = 0.f;
+
+		for (size_t i = 0; i < proxyAabbs.size(); i++)
+		{
+			if (!proxyIsActive[i])
+				continue;
+
+			glm::vec3 center = 0.5f * (proxyAabbs[i].min + proxyAabbs[i].max);
+			sum += center;
+			sumSquared += center * center;
+			count += 1.f;
+		}
+
+		if (count < 2.f)
+			return;
+
+		glm::vec3 mean = sum / count;
+		glm::vec3 variance = sumSquared / count - mean * mean;
+
+		size_t bestAxis = 0;
+		for (size_t axis = 1; axis < 3; axis++)
+		{
+			if (variance[axis] > variance[bestAxis])
+				bestAxis = axis;
+		}
+
+		// require a clear win before switching, since a switch costs a full sort
+		if (bestAxis != sweepAxis && variance[bestAxis] > 1.2f * variance[sweepAxis])
+		{
+			sweepAxis = bestAxis;
+			needsFullSort = true;
+		}
+	}
+
+	void SweepAndPrune::SortEndpoints()
+	{
+		// refresh endpoint values from the latest aabbs
+		for (Endpoint& endpoint : endpoints)
+		{
+			const AABB& aabb = proxyAabbs[endpoint.proxyId];
+			endpoint.value = endpoint.isMax ? aabb.max[sweepAxis] : aabb.min[sweepAxis];
+		}
+
+		// newly added endpoints can be anywhere, so fall back to a full sort once
+		if (needsFullSort)
+		{
+			std::sort(endpoints.begin(), endpoints.end(), EndpointLess);
+			needsFullSort = false;
+			return;
+		}
+
+		// insertion sort, the order from the previous step is almost correct so few elements move
+		for (size_t i = 1; i < endpoints.size(); i++)
+		{
+			Endpoint endpoint = endpoints[i];
+			size_t j = i;
+
+			while (j > 0 && EndpointLess(endpoint, endpoints[j - 1]))
+			{
+				endpoints[j] = endpoints[j - 1];
+				j--;
+			}
+
+			endpoints[j] = endpoint;
+		}
+	}
+
+	void SweepAndPrune::Sweep()
+	{
+		const size_t secondaryAxis1 = (sweepAxis + 1) % 3;
+		const size_t secondaryAxis2 = (sweepAxis + 2) % 3;
+
+		pairKeys.clear();
+		activeSet.clear();
+		activeMin1.clear();
+		activeMax1.clear();
+		activeMin2.clear();
+		activeMax2.clear();
+
+		// move plane from min to max and find overlaps in the axis direction
+		for (const Endpoint& endpoint : endpoints)
+		{
+			if (endpoint.isMax)
+			{
+				// swap and pop the proxy out of the active set, an inverted aabb (not yet updated) is never in it
+				uint32_t index = activeSetIndex[endpoint.proxyId];
+				if (index >= activeSet.size() || activeSet[index] != endpoint.proxyId)
+					continue;
+
+				uint32_t lastId = activeSet.back();
+				activeSet[index] = lastId;
+				activeMin1[index] = activeMin1.back();
+				activeMax1[index] = activeMax1.back();
+				activeMin2[index] = activeMin2.back();
+				activeMax2[index] = activeMax2.back();
+				activeSetIndex[lastId] = index;
+
+				activeSet.pop_back();
+				activeMin1.pop_back();
+				activeMax1.pop_back();
+				activeMin2.pop_back();
+				activeMax2.pop_back();
+				continue;
+			}
+
+			const AABB& aabb = proxyAabbs[endpoint.proxyId];
+			const float min1 = aabb.min[secondaryAxis1];
+			const float max1 = aabb.max[secondaryAxis1];
+			const float min2 = aabb.min[secondaryAxis2];
+			const float max2 = aabb.max[secondaryAxis2];
+			const size_t activeCount = activeSet.size();
+
+			// perform aabb vs aabb check along the remaining axis, 8 active proxies at a time
+			Float8 packedMin1 = Float8::Set(min1);
+			Float8 packedMax1 = Float8::Set(max1);
+			Float8 packedMin2 = Float8::Set(min2);
+			Float8 packedMax2 = Float8::Set(max2);
+			size_t i = 0;
+
+			for (; i + Float8::width <= activeCount; i += Float8::width)
+			{
+				Float8 overlaps =
+					(Float8::Load(&activeMin1[i]) <= packedMax1) & (Float8::Load(&activeMax1[i]) >= packedMin1) &
+					(Float8::Load(&activeMin2[i]) <= packedMax2) & (Float8::Load(&activeMax2[i]) >= packedMin2);
+
+				uint32_t laneBits = uint32_t(MoveMask(overlaps));
+				while (laneBits != 0)
+				{
+					size_t lane = size_t(CountTrailingZeros(laneBits));
+					laneBits &= laneBits - 1;
+					pairKeys.push_back(MakePairKey(activeSet[i + lane], endpoint.proxyId));
+				}
+			}
+
+			for (; i < activeCount; i++)
+			{
+				if (activeMin1[i] <= max1 && activeMax1[i] >= min1 &&
+					activeMin2[i] <= max2 && activeMax2[i] >= min2)
+				{
+					pairKeys.push_back(MakePairKey(activeSet[i], endpoint.proxyId));
+				}
+			}
+
+			activeSetIndex[endpoint.proxyId] = uint32_t(activeCount);
+			activeSet.push_back(endpoint.proxyId);
+			activeMin1.push_back(min1);
+			activeMax1.push_back(max1);
+			activeMin2.push_back(min2);
+			activeMax2.push_back(max2);
+		}
+
+		// sorted keys give a deterministic pair order and allow a linear diff against the previous step
+		std::sort(pairKeys.begin(), pairKeys.end());
+	}
+
+	void SweepAndPrune::DiffPairs()
+	{
+		pairs.clear();
+		addedPairs.clear();
+		removedPairs.clear();
+
+		size_t i = 0;
+		size_t j = 0;
+
+		while (i < pairKeys.size() || j < previousPairKeys.size())
+		{
+			if (j == previousPairKeys.size() || (i < pairKeys.size() && pairKeys[i] < previousPairKeys[j]))
+			{
+				addedPairs.push_back(PairFromKey(pairKeys[i]));
+				pairs.push_back(PairFromKey(pairKeys[i]));
+				i++;
+			}
+			else if (i == pairKeys.size() || previousPairKeys[j] < pairKeys[i])
+			{
+				removedPairs.push_back(PairFromKey(previousPairKeys[j]));
+				j++;
+			}
+			else
+			{
+				pairs.push_back(PairFromKey(pairKeys[i]));
+				i++;
+				j++;
+			}
+		}
+
+		std::swap(pairKeys, previousPairKeys);
+	}
+
+	void SweepAndPrune::AddProxy(uint32_t proxyId, const AABB& aabb)
+	{
+		if (proxyId >= proxyAabbs.size())
+		{
+			proxyAabbs.resize(proxyId + 1);
+			proxyIsActive.resize(proxyId + 1, false);
+			proxyIsRemoved.resize(proxyId + 1, false);
+			activeSetIndex.resize(proxyId + 1, 0);
+		}
+
+		// the old endpoints of a reused id have to go before the new ones are added
+		if (proxyIsRemoved[proxyId])
+			RemoveEndpoints();
+
+		proxyAabbs[proxyId] = aabb;
+		proxyIsActive[proxyId] = true;
+
+		// new endpoints are appended and moved into place by the next sort
+		endpoints.push_back({ aabb.min[sweepAxis], proxyId, false });
+		endpoints.push_back({ aabb.max[sweepAxis], proxyId, true });
+		needsFullSort = true;
+	}
+
+	void SweepAndPrune::RemoveProxy(uint32_t proxyId)
+	{
+		if (proxyId >= proxyIsActive.size() || !proxyIsActive[proxyId])
+			return;
+
+		proxyIsActive[proxyId] = false;
+		proxyIsRemoved[proxyId] = true;
+		hasRemovedEndpoints = true;
+	}
+
+	void SweepAndPrune::UpdateProxy(uint32_t proxyId, const AABB& aabb)
+	{
+		proxyAabbs[proxyId] = aabb;
+	}
+
+	void SweepAndPrune::Update()
+	{
+		if (hasRemovedEndpoints)
+			RemoveEndpoints();
+
+		if (adaptiveSweepAxis)
+			ChooseSweepAxis();
+
+		SortEndpoints();
+		Sweep();
+		DiffPairs();
+	}
+
+	size_t SweepAndPrune::GetSweepAxis() const
+	{
+		return sweepAxis;
+	}
+
+	const std::vector<BroadphasePair>& SweepAndPrune::GetPairs() const
+	{
+		return pairs;
+	}
+
+	const std::vector<BroadphasePair>& SweepAndPrune::GetAddedPairs() const
+	{
+		return addedPairs;
+	}
+
+	const std::vector<BroadphasePair>& SweepAndPrune::GetRemovedPairs() const
+	{
+		return removedPairs;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "collider.h"
+#include <vector>
+#include <cstdint>
+
+namespace Engine
+{
+	struct BroadphasePair
+	{
+		uint32_t firstId;
+		uint32_t secondId;
+	};
+
+	uint64_t MakePairKey(uint32_t firstId, uint32_t secondId);
+	BroadphasePair PairFromKey(uint64_t key);
+
+	// persistent sweep and prune, endpoints are kept sorted between updates and re-sorted with
+	// insertion sort which is close to linear when proxies only move a little each step
+	// the sweep axis follows the largest variance of the aabb centers, and the active set is
+	// stored as packed arrays so the remaining axes are tested against 8 active proxies at once
+	// only the endpoint sort carries over between updates, the pairs are swept again every update and their
+	// sorted keys diffed against the previous ones for the added and removed pairs, so an update costs
+	// O(N + P log P) even when nothing moved, the endpoints are kept on the sweep axis only, so pairs can
+	// not be updated from the swaps of the sort, which miss proxies moving into overlap on the other axes
+	class SweepAndPrune final
+	{
+	private:
+		struct Endpoint
+		{
+			float value;
+			uint32_t proxyId;
+			bool isMax;
+		};
+
+		size_t sweepAxis;
+		bool needsFullSort;
+		bool hasRemovedEndpoints;
+		std::vector<AABB> proxyAabbs;
+		std::vector<bool> proxyIsActive;
+		std::vector<bool> proxyIsRemoved;// endpoints of removed proxies are dropped in one pass by the next update
+		std::vector<Endpoint> endpoints;
+
+		std::vector<uint32_t> activeSet;
+		std::vector<uint32_t> activeSetIndex;// proxy id -> index in active set
+		std::vector<float> activeMin1;// active set aabbs on the secondary axes
+		std::vector<float> activeMax1;
+		std::vector<float> activeMin2;
+		std::vector<float> activeMax2;
+
+		std::vector<uint64_t> pairKeys;
+		std::vector<uint64_t> previousPairKeys;
+		std::vector<BroadphasePair> pairs;
+		std::vector<BroadphasePair> addedPairs;
+		std::vector<BroadphasePair> removedPairs;
+
+		static bool EndpointLess(const Endpoint& lhs, const Endpoint& rhs);
+
+		void RemoveEndpoints();
+		void ChooseSweepAxis();
+		void SortEndpoints();
+		void Sweep();
+		void DiffPairs();
+
+	public:
+		bool adaptiveSweepAxis;
+
+		SweepAndPrune();
+
+		void AddProxy(uint32_t proxyId, const AABB& aabb);
+		void RemoveProxy(uint32_t proxyId);
+		void UpdateProxy(uint32_t proxyId, const AABB& aabb);
+		void Update();
+
+		size_t GetSweepAxis() const;
+		const std::vector<BroadphasePair>& GetPairs() const;
+		const std::vector<BroadphasePair>& GetAddedPairs() const;
+		const std::vector<BroadphasePair>& GetRemovedPairs() const;
+	};
+}
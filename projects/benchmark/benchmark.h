@@ -0,0 +1,23 @@
+#pragma once
+#include <chrono>
+
+class Stopwatch
+{
+private:
+	std::chrono::high_resolution_clock::time_point start;
+
+public:
+	Stopwatch() :
+		start(std::chrono::high_resolution_clock::now())
+	{}
+
+	double ElapsedMilliseconds() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+};
+
+void RunBroadphaseBenchmark();
+void RunJobSystemBenchmark();
+void RunSdfCacheBenchmark();
+void RunRaycastBenchmark();
@@ -0,0 +1,87 @@
+#include "benchmark.h"
+#include "sweep_and_prune.h"
+#include "spatial_hash_grid.h"
+#include <random>
+#include <cstdio>
+
+struct BroadphaseScene
+{
+	std::vector<Engine::AABB> aabbs;
+	std::vector<glm::vec3> velocities;
+
+	void Init(size_t bodyCount)
+	{
+		// unit radius bodies at a constant density, spread out on a wide level like the test world
+		std::mt19937 rng(1234);
+		float side = 4.f * std::cbrt(float(bodyCount));
+		std::uniform_real_distribution<float> position(0.f, side);
+		std::uniform_real_distribution<float> velocity(-0.05f, 0.05f);
+
+		aabbs.resize(bodyCount);
+		velocities.resize(bodyCount);
+
+		for (size_t i = 0; i < bodyCount; i++)
+		{
+			glm::vec3 center(position(rng), position(rng) * 0.25f, position(rng));
+			aabbs[i].min = center - glm::vec3(1.f);
+			aabbs[i].max = center + glm::vec3(1.f);
+			velocities[i] = glm::vec3(velocity(rng), velocity(rng), velocity(rng));
+		}
+	}
+
+	void Step()
+	{
+		for (size_t i = 0; i < aabbs.size(); i++)
+		{
+			aabbs[i].min += velocities[i];
+			aabbs[i].max += velocities[i];
+		}
+	}
+};
+
+template<typename BROADPHASE>
+void MeasureBroadphase(const char* name, size_t bodyCount, size_t stepCount)
+{
+	BroadphaseScene scene;
+	scene.Init(bodyCount);
+
+	BROADPHASE broadphase;
+	for (size_t i = 0; i < bodyCount; i++)
+		broadphase.AddProxy(uint32_t(i), scene.aabbs[i]);
+
+	// the first update pays for the initial sort and allocations
+	Stopwatch firstUpdate;
+	broadphase.Update();
+	double firstMs = firstUpdate.ElapsedMilliseconds();
+
+	Stopwatch steps;
+	size_t pairCount = 0;
+
+	for (size_t step = 0; step < stepCount; step++)
+	{
+		scene.Step();
+
+		for (size_t i = 0; i < bodyCount; i++)
+			broadphase.UpdateProxy(uint32_t(i), scene.aabbs[i]);
+
+		broadphase.Update();
+		pairCount += broadphase.GetPairs().size();
+	}
+
+	double stepMs = steps.ElapsedMilliseconds() / stepCount;
+	std::printf("%-18s %8zu bodies   first %9.3f ms   step %9.3f ms   %8zu pairs/step\n",
+		name, bodyCount, firstMs, stepMs, pairCount / stepCount);
+}
+
+void RunBroadphaseBenchmark()
+{
+	std::printf("broadphase benchmark\n");
+
+	for (size_t bodyCount : { 1000, 10000, 100000 })
+	{
+		size_t stepCount = (bodyCount >= 100000) ? 10 : 60;
+
+		MeasureBroadphase<Engine::SweepAndPrune>("sweep and prune", bodyCount, stepCount);
+		MeasureBroadphase<Engine::SpatialHashGrid>("spatial hash grid", bodyCount, stepCount);
+	}
+}
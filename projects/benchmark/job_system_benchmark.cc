@@ -0,0 +1,92 @@
+#include "benchmark.h"
+#include "job_system.h"
+#include <cstdio>
+
+static void MeasureSpawn(Engine::JobSystem& jobSystem, size_t jobCount)
+{
+	// every job is pushed to the main thread queue, so the workers only get them by stealing
+	std::atomic<size_t> executed(0);
+
+	Stopwatch stopwatch;
+	Engine::JobCounter counter;
+
+	for (size_t i = 0; i < jobCount; i++)
+		jobSystem.Run([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }, &counter);
+
+	jobSystem.Wait(counter);
+	double ms = stopwatch.ElapsedMilliseconds();
+
+	printf("  spawn + steal  %8zu jobs  %8.3f ms  %7.1f ns/job\n", executed.load(), ms, ms * 1e6 / double(jobCount));
+}
+
+static void MeasureNested(Engine::JobSystem& jobSystem, size_t parentCount, size_t childCount)
+{
+	// every parent spawns its children into its own queue, idle threads steal from the busy ones
+	std::atomic<size_t> executed(0);
+
+	Stopwatch stopwatch;
+	Engine::JobCounter parents;
+
+	for (size_t i = 0; i < parentCount; i++)
+	{
+		jobSystem.Run([&jobSystem, &executed, childCount]()
+		{
+			Engine::JobCounter children;
+			for (size_t j = 0; j < childCount; j++)
+				jobSystem.Run([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }, &children);
+
+			jobSystem.Wait(children);
+		}, &parents);
+	}
+
+	jobSystem.Wait(parents);
+	double ms = stopwatch.ElapsedMilliseconds();
+
+	printf("  nested         %8zu jobs  %8.3f ms  %7.1f ns/job\n", executed.load(), ms, ms * 1e6 / double(parentCount * childCount));
+}
+
+static void MeasureParallelFor(Engine::JobSystem& jobSystem, size_t count, size_t batchSize)
+{
+	std::vector<float> values(count, 1.f);
+
+	Stopwatch stopwatch;
+	jobSystem.ParallelFor(count, batchSize, [&values](size_t i) { values[i] = values[i] * 0.5f + 1.f; });
+	double ms = stopwatch.ElapsedMilliseconds();
+
+	printf("  parallel for   %8zu items %8.3f ms  batch %zu\n", count, ms, batchSize);
+}
+
+static void MeasureDependencies(Engine::JobSystem& jobSystem, size_t chainLength)
+{
+	// a chain of jobs where each one waits for the previous one, measures the release latency
+	std::vector<Engine::JobCounter> counters(chainLength);
+
+	Stopwatch stopwatch;
+	jobSystem.Run([]() {}, &counters[0]);
+	for (size_t i = 1; i < chainLength; i++)
+		jobSystem.RunAfter(counters[i - 1], []() {}, &counters[i]);
+
+	jobSystem.Wait(counters[chainLength - 1]);
+	double ms = stopwatch.ElapsedMilliseconds();
+
+	printf("  dependency     %8zu jobs  %8.3f ms  %7.1f ns/job\n", chainLength, ms, ms * 1e6 / double(chainLength));
+}
+
+void RunJobSystemBenchmark()
+{
+	size_t hardwareThreads = std::thread::hardware_concurrency();
+
+	for (size_t workerCount : { size_t(0), hardwareThreads > 1 ? hardwareThreads - 1 : size_t(0) })
+	{
+		Engine::JobSystem jobSystem;
+		jobSystem.Init(workerCount);
+
+		printf("job system, %zu threads\n", jobSystem.GetThreadCount());
+
+		MeasureSpawn(jobSystem, 100000);
+		MeasureNested(jobSystem, 100, 1000);
+		MeasureParallelFor(jobSystem, 1000000, 64);
+		MeasureParallelFor(jobSystem, 1000000, 4096);
+		MeasureDependencies(jobSystem, 10000);
+	}
+}
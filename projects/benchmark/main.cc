@@ -0,0 +1,21 @@
+#include "benchmark.h"
+#include <string>
+
+int main(int argc, char** argv)
+{
+	std::string filter = (argc > 1) ? argv[1] : "";
+
+	if (filter.empty() || filter == "broadphase")
+		RunBroadphaseBenchmark();
+
+	if (filter.empty() || filter == "jobs")
+		RunJobSystemBenchmark();
+
+	if (filter.empty() || filter == "sdf_cache")
+		RunSdfCacheBenchmark();
+
+	if (filter.empty() || filter == "raycast")
+		RunRaycastBenchmark();
+
+	return 0;
+}
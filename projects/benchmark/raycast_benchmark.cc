@@ -0,0 +1,208 @@
+#include "benchmark.h"
+#include "physics_world.h"
+#include <memory>
+#include <random>
+#include <thread>
+#include <cstdio>
+
+// rolling hills with a few rocks, the hills are scaled down so the distance stays a lower bound
+static float Terrain(const glm::vec3& p)
+{
+	float height = 1.5f * (glm::sin(p.x * 0.3f) + glm::cos(p.z * 0.25f));
+	float hills = (p.y - height) * 0.7f;
+	float rock = glm::length(glm::vec3(glm::mod(p.x, 16.f) - 8.f, p.y - 2.f, glm::mod(p.z, 16.f) - 8.f)) - 2.f;
+	return glm::min(hills, rock);
+}
+
+static void TerrainDistances(const void*, const glm::vec3* p_points, float* p_outDistances, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		p_outDistances[i] = Terrain(p_points[i]);
+}
+
+static float TerrainDistance(const void*, const glm::vec3& p)
+{
+	return Terrain(p);
+}
+
+void RunRaycastBenchmark()
+{
+	Engine::SDF terrain(nullptr, TerrainDistance, TerrainDistances);
+
+	// a view over the terrain and ground probes below bodies, like the line of sight and IsOnGround queries
+	const size_t viewRayCount = 256 * 256;
+	const size_t probeCount = 16384;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> horizontal(-100.f, 100.f);
+
+	std::vector<glm::vec3> origins;
+	std::vector<glm::vec3> directions;
+	std::vector<float> maxDistances;
+
+	for (size_t y = 0; y < 256; y++)
+	{
+		for (size_t x = 0; x < 256; x++)
+		{
+			glm::vec3 direction(float(x) / 255.f - 0.5f, -0.1f - 0.4f * float(y) / 255.f, 1.f);
+			origins.push_back(glm::vec3(0.f, 8.f, -60.f));
+			directions.push_back(glm::normalize(direction));
+			maxDistances.push_back(150.f);
+		}
+	}
+
+	for (size_t i = 0; i < probeCount; i++)
+	{
+		origins.push_back(glm::vec3(horizontal(rng), 6.f, horizontal(rng)));
+		directions.push_back(glm::vec3(0.f, -1.f, 0.f));
+		maxDistances.push_back(4.f);
+	}
+
+	const size_t rayCount = origins.size();
+	std::vector<Engine::HitResult> packetHits(rayCount);
+	std::unique_ptr<bool[]> packetHitFlags(new bool[rayCount]);
+	std::vector<Engine::RaycastStats> stats(rayCount);
+
+	size_t hardwareThreads = std::thread::hardware_concurrency();
+	Engine::JobSystem jobSystem;
+	jobSystem.Init(hardwareThreads > 1 ? hardwareThreads - 1 : 0);
+
+	Engine::PhysicsWorld serialWorld;
+	serialWorld.Init(terrain, { 0.f, 0.f });
+	Engine::PhysicsWorld parallelWorld;
+	parallelWorld.Init(terrain, { 0.f, 0.f }, &jobSystem);
+
+	// plain sphere tracing as the reference, then the over-relaxed steps and a hit distance that grows with the
+	// distance like a pixel footprint
+	Engine::RaycastOptions plain;
+	plain.stepScale = 0.f;
+	Engine::RaycastOptions relaxed;
+	Engine::RaycastOptions footprint;
+	footprint.hitDistanceScale = 0.002f;
+
+	struct Variant
+	{
+		const char* p_name;
+		Engine::RaycastOptions options;
+		std::vector<Engine::HitResult> hits;
+		std::vector<char> hitFlags;
+		double ms;
+	};
+
+	Variant variants[] = {
+		{ "plain", plain, {}, {}, 0.0 },
+		{ "relaxed", relaxed, {}, {}, 0.0 },
+		{ "footprint", footprint, {}, {}, 0.0 }
+	};
+	const Variant& reference = variants[0];
+
+	printf("raycast, %zu rays\n", rayCount);
+
+	for (Variant& variant : variants)
+	{
+		variant.hits.resize(rayCount);
+		variant.hitFlags.resize(rayCount);
+
+		Stopwatch single;
+		size_t hitCount = 0;
+		for (size_t i = 0; i < rayCount; i++)
+		{
+			variant.hitFlags[i] = serialWorld.RaycastWorld(origins[i], directions[i], maxDistances[i], variant.hits[i], variant.options, &stats[i]);
+			hitCount += variant.hitFlags[i] ? 1 : 0;
+		}
+		variant.ms = single.ElapsedMilliseconds();
+
+		uint64_t iterationCount = 0;
+		uint64_t evaluationCount = 0;
+		for (const Engine::RaycastStats& rayStats : stats)
+		{
+			iterationCount += rayStats.iterationCount;
+			evaluationCount += rayStats.evaluationCount;
+		}
+
+		size_t mismatches = 0;
+		float maxError = 0.f;
+		for (size_t i = 0; i < rayCount; i++)
+		{
+			if (variant.hitFlags[i] != reference.hitFlags[i])
+				mismatches++;
+			else if (variant.hitFlags[i])
+				maxError = glm::max(maxError, glm::abs(variant.hits[i].distance - reference.hits[i].distance));
+		}
+
+		printf("  %-10s     %8.3f ms  %zu hits  %5.1f iterations  %5.1f evaluations per ray  %.1fx  mismatches %zu  max error %.4f\n",
+			variant.p_name, variant.ms, hitCount, double(iterationCount) / double(rayCount), double(evaluationCount) / double(rayCount),
+			reference.ms / variant.ms, mismatches, maxError);
+	}
+
+	const Variant& single = variants[1];
+
+	// the packets take the same steps, so they should agree with the single rays
+	for (Engine::PhysicsWorld* p_world : { &serialWorld, &parallelWorld })
+	{
+		Stopwatch packets;
+		size_t hitCount = p_world->RaycastWorld(origins.data(), directions.data(), maxDistances.data(), rayCount, packetHits.data(), packetHitFlags.get(), relaxed);
+		double packetMs = packets.ElapsedMilliseconds();
+
+		size_t mismatches = 0;
+		float maxError = 0.f;
+		for (size_t i = 0; i < rayCount; i++)
+		{
+			if (bool(single.hitFlags[i]) != packetHitFlags[i])
+				mismatches++;
+			else if (packetHitFlags[i])
+				maxError = glm::max(maxError, glm::abs(packetHits[i].distance - single.hits[i].distance));
+		}
+
+		printf("  packets        %8.3f ms  %zu hits  %.1fx  %zu job threads  mismatches %zu  max error %.5f\n",
+			packetMs, hitCount, single.ms / packetMs, p_world == &parallelWorld ? jobSystem.GetThreadCount() : size_t(0), mismatches, maxError);
+	}
+
+	// the ground probes again as sphere and capsule casts, like a character controller checking its feet
+	std::vector<Engine::ShapeCast> casts;
+	for (size_t i = viewRayCount; i < rayCount; i++)
+	{
+		if (i % 2 == 0)
+			casts.push_back(Engine::MakeSphereCast(origins[i], 0.4f, directions[i], maxDistances[i]));
+		else
+			casts.push_back(Engine::MakeCapsuleCast(origins[i], origins[i] + glm::vec3(0.f, 0.f, 1.5f), 0.4f, directions[i], maxDistances[i]));
+	}
+
+	const size_t castCount = casts.size();
+	std::vector<Engine::HitResult> castHits(castCount);
+	std::unique_ptr<bool[]> castHitFlags(new bool[castCount]);
+	std::vector<Engine::RaycastStats> castStats(castCount);
+
+	printf("shape cast, %zu casts, half of them capsules\n", castCount);
+
+	Stopwatch singleCasts;
+	size_t castHitCount = 0;
+	for (size_t i = 0; i < castCount; i++)
+		castHitCount += serialWorld.ShapeCastWorld(casts[i], castHits[i], relaxed, &castStats[i]) ? 1 : 0;
+	double singleCastMs = singleCasts.ElapsedMilliseconds();
+
+	uint64_t sphereEvaluationCount = 0;
+	uint64_t capsuleEvaluationCount = 0;
+	for (size_t i = 0; i < castCount; i++)
+		(i % 2 == 0 ? sphereEvaluationCount : capsuleEvaluationCount) += castStats[i].evaluationCount;
+
+	printf("  single         %8.3f ms  %zu hits  %5.1f evaluations per sphere  %5.1f per capsule\n",
+		singleCastMs, castHitCount, double(sphereEvaluationCount) / double(castCount / 2), double(capsuleEvaluationCount) / double(castCount / 2));
+
+	for (Engine::PhysicsWorld* p_world : { &serialWorld, &parallelWorld })
+	{
+		std::vector<Engine::HitResult> batchHits(castCount);
+		Stopwatch batch;
+		size_t hitCount = p_world->ShapeCastWorld(casts.data(), castCount, batchHits.data(), castHitFlags.get(), relaxed);
+		double batchMs = batch.ElapsedMilliseconds();
+
+		float maxError = 0.f;
+		for (size_t i = 0; i < castCount; i++)
+		{
+			if (castHitFlags[i])
+				maxError = glm::max(maxError, glm::abs(batchHits[i].distance - castHits[i].distance));
+		}
+
+		printf("  batch          %8.3f ms  %zu hits  %.1fx  %zu job threads  max error %.5f\n",
+			batchMs, hitCount, singleCastMs / batchMs, p_world == &parallelWorld ? jobSystem.GetThreadCount() : size_t(0), maxError);
+	}
+}
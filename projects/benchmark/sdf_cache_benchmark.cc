@@ -0,0 +1,287 @@
+#include "benchmark.h"
+#include "sdf_brick_cache.h"
+#include "program_handle.h"
+#include <random>
+#include <thread>
+#include <cstdio>
+
+static float benchmarkTime = 0.f;
+
+// a vec4 of the dual program, the engine duals have the layout of the ones the program computes with
+struct DualVec4
+{
+	Engine::Dual x;
+	Engine::Dual y;
+	Engine::Dual z;
+	Engine::Dual w;
+};
+
+static_assert(sizeof(Engine::Dual) == sizeof(Tolo::Dual), "the natives read the program's duals as engine duals");
+
+namespace ToloFunctions
+{
+	void vec3_operator_minus(Tolo::VirtualMachine& vm)
+	{
+		glm::vec3 a = Tolo::Pop<glm::vec3>(vm);
+		glm::vec3 b = Tolo::Pop<glm::vec3>(vm);
+		Tolo::PushStruct<glm::vec3>(vm, a - b);
+	}
+
+	void vec3_length(Tolo::VirtualMachine& vm)
+	{
+		glm::vec3 v = Tolo::Pop<glm::vec3>(vm);
+		Tolo::Push<Tolo::Float>(vm, glm::length(v));
+	}
+
+	void float_cos(Tolo::VirtualMachine& vm)
+	{
+		float a = Tolo::Pop<float>(vm);
+		Tolo::Push<float>(vm, glm::cos(a));
+	}
+
+	void vec4_union(Tolo::VirtualMachine& vm)
+	{
+		glm::vec4 a = Tolo::Pop<glm::vec4>(vm);
+		glm::vec4 b = Tolo::Pop<glm::vec4>(vm);
+		Tolo::PushStruct<glm::vec4>(vm, a.w < b.w ? a : b);
+	}
+
+	void float_time(Tolo::VirtualMachine& vm)
+	{
+		Tolo::Push<float>(vm, benchmarkTime);
+	}
+
+	void vec3_operator_minus_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 a = Tolo::Pop<Engine::DualVec3>(vm);
+		Engine::DualVec3 b = Tolo::Pop<Engine::DualVec3>(vm);
+		Tolo::PushStruct<Engine::DualVec3>(vm, a - b);
+	}
+
+	void vec3_length_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 v = Tolo::Pop<Engine::DualVec3>(vm);
+		Tolo::PushStruct<Engine::Dual>(vm, Engine::Length(v));
+	}
+
+	void float_cos_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::Dual a = Tolo::Pop<Engine::Dual>(vm);
+		Tolo::PushStruct<Engine::Dual>(vm, Engine::Cos(a));
+	}
+
+	void vec4_union_dual(Tolo::VirtualMachine& vm)
+	{
+		DualVec4 a = Tolo::Pop<DualVec4>(vm);
+		DualVec4 b = Tolo::Pop<DualVec4>(vm);
+		Tolo::PushStruct<DualVec4>(vm, a.w.value < b.w.value ? a : b);
+	}
+
+	void float_time_dual(Tolo::VirtualMachine& vm)
+	{
+		Tolo::PushStruct<Engine::Dual>(vm, Engine::Dual::Constant(benchmarkTime));
+	}
+}
+
+static void InitProgram(Tolo::ProgramHandle& program)
+{
+	program.AddStruct({ "vec3", { {"float", "x"}, {"float", "y"}, {"float", "z"} } });
+	program.AddStruct({ "vec4", { {"float", "x"}, {"float", "y"}, {"float", "z"}, {"float", "w"} } });
+	program.AddFunction({ "vec3", "operator-", {"vec3", "vec3"}, ToloFunctions::vec3_operator_minus, false, ToloFunctions::vec3_operator_minus_dual });
+	program.AddFunction({ "float", "length", {"vec3"}, ToloFunctions::vec3_length, false, ToloFunctions::vec3_length_dual });
+	program.AddFunction({ "float", "cos", {"float"}, ToloFunctions::float_cos, false, ToloFunctions::float_cos_dual });
+	program.AddFunction({ "vec4", "Union", {"vec4", "vec4"}, ToloFunctions::vec4_union, false, ToloFunctions::vec4_union_dual });
+	program.AddFunction({ "float", "Time", {}, ToloFunctions::float_time, true, ToloFunctions::float_time_dual });
+}
+
+static void ProgramDistances(const void* p_program, const glm::vec3* p_points, float* p_outDistances, size_t count)
+{
+	thread_local Tolo::ExecutionStack stack;
+	const Tolo::ProgramHandle& program = *static_cast<const Tolo::ProgramHandle*>(p_program);
+
+	for (size_t i = 0; i < count; i++)
+		p_outDistances[i] = program.ExecuteOn<glm::vec4>(stack, p_points[i]).w;
+}
+
+static float ProgramDistance(const void* p_program, const glm::vec3& p)
+{
+	float distance;
+	ProgramDistances(p_program, &p, &distance, 1);
+	return distance;
+}
+
+static float DualProgramGradient(const void* p_dualProgram, const glm::vec3& p, glm::vec3& outGradient)
+{
+	thread_local Tolo::ExecutionStack stack;
+	const Tolo::ProgramHandle& dualProgram = *static_cast<const Tolo::ProgramHandle*>(p_dualProgram);
+
+	Engine::Dual distance = dualProgram.ExecuteOn<DualVec4>(stack, Engine::DualVec3::Variable(p)).w;
+	outGradient = distance.gradient;
+	return distance.value;
+}
+
+static float DualProgramDistance(const void* p_dualProgram, const glm::vec3& p)
+{
+	glm::vec3 gradient;
+	return DualProgramGradient(p_dualProgram, p, gradient);
+}
+
+static double MeasureQueries(const Engine::SDF& sdf, const std::vector<glm::vec3>& points, std::vector<float>& outDistances)
+{
+	Stopwatch stopwatch;
+	sdf.Evaluate(points.data(), outDistances.data(), points.size());
+	return stopwatch.ElapsedMilliseconds();
+}
+
+void RunSdfCacheBenchmark()
+{
+	Tolo::ProgramHandle program("assets/tolo/sdf_benchmark.tolo", 1024, "Sdf");
+	Tolo::ProgramHandle staticProgram("assets/tolo/sdf_benchmark.tolo", 1024, "Sdf");
+	Tolo::ProgramHandle dualProgram("assets/tolo/sdf_benchmark.tolo", 4096, "Sdf");
+	bool hasStaticPart = false;
+
+	try
+	{
+		InitProgram(program);
+		program.Compile();
+		InitProgram(staticProgram);
+		hasStaticPart = staticProgram.CompileStaticPart();
+		InitProgram(dualProgram);
+		dualProgram.CompileDual();
+	}
+	catch (const Tolo::Error& error)
+	{
+		error.Print();
+		printf("sdf cache: could not compile the benchmark program, run from the bin directory\n");
+		return;
+	}
+
+	Engine::SDF exact(&program, ProgramDistance, ProgramDistances);
+
+	// points within a meter and a half of the surface, where bodies resting on the world query it
+	const size_t queryCount = 200000;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> horizontal(-20.f, 20.f);
+	std::uniform_real_distribution<float> vertical(-2.f, 6.f);
+
+	std::vector<glm::vec3> points;
+	while (points.size() < queryCount)
+	{
+		glm::vec3 p(horizontal(rng), vertical(rng), horizontal(rng));
+		if (glm::abs(exact(p)) < 1.5f)
+			points.push_back(p);
+	}
+
+	std::vector<float> exactDistances(queryCount);
+	std::vector<float> cachedDistances(queryCount);
+
+	// bricks are filled by all threads, queries run on one
+	size_t hardwareThreads = std::thread::hardware_concurrency();
+	Engine::JobSystem jobSystem;
+	jobSystem.Init(hardwareThreads > 1 ? hardwareThreads - 1 : 0);
+
+	double exactMs = MeasureQueries(exact, points, exactDistances);
+	printf("sdf cache, %zu queries near the surface\n", queryCount);
+	printf("  program        %8.3f ms  %7.1f ns/query\n", exactMs, exactMs * 1e6 / double(queryCount));
+
+	// the gradient of every query, from one run of the dual program or from the four taps of the program
+	{
+		const size_t gradientCount = queryCount / 4;
+		Engine::SDF dual(&dualProgram, DualProgramDistance, nullptr, DualProgramGradient);
+		std::vector<glm::vec3> tapGradients(gradientCount);
+		std::vector<glm::vec3> dualGradients(gradientCount);
+		std::vector<float> dualDistances(gradientCount);
+
+		Stopwatch taps;
+		exact.EvaluateGradients(points.data(), cachedDistances.data(), tapGradients.data(), gradientCount);
+		double tapsMs = taps.ElapsedMilliseconds();
+
+		Stopwatch duals;
+		dual.EvaluateGradients(points.data(), dualDistances.data(), dualGradients.data(), gradientCount);
+		double dualsMs = duals.ElapsedMilliseconds();
+
+		float maxDistanceError = 0.f;
+		float maxNormalError = 0.f;
+		for (size_t i = 0; i < gradientCount; i++)
+		{
+			maxDistanceError = glm::max(maxDistanceError, glm::abs(dualDistances[i] - exactDistances[i]));
+			maxNormalError = glm::max(maxNormalError, glm::distance(glm::normalize(dualGradients[i]), glm::normalize(tapGradients[i])));
+		}
+
+		printf("  gradient taps  %8.3f ms  %7.1f ns/query\n", tapsMs, tapsMs * 1e6 / double(gradientCount));
+		printf("  gradient dual  %8.3f ms  %7.1f ns/query  %.1fx  distance error %.6f  normal difference to the taps %.4f\n",
+			dualsMs, dualsMs * 1e6 / double(gradientCount), tapsMs / dualsMs, maxDistanceError, maxNormalError);
+	}
+
+	for (float voxelSize : { 0.25f, 0.125f })
+	{
+		Engine::SdfBrickCache cache;
+		cache.Init(exact, voxelSize, 2.f, 16384, &jobSystem);
+		Engine::SDF cached = cache.GetSDF();
+
+		// the first pass misses everywhere and queues the bricks, which the update fills
+		double coldMs = MeasureQueries(cached, points, cachedDistances);
+
+		Stopwatch fill;
+		cache.Update();
+		double fillMs = fill.ElapsedMilliseconds();
+
+		uint64_t missesBefore = cache.GetMissCount();
+		double warmMs = MeasureQueries(cached, points, cachedDistances);
+		uint64_t warmMisses = cache.GetMissCount() - missesBefore;
+
+		float maxError = 0.f;
+		for (size_t i = 0; i < queryCount; i++)
+			maxError = glm::max(maxError, glm::abs(cachedDistances[i] - exactDistances[i]));
+
+		printf("  voxel %.3f    cold %8.3f ms  fill %8.3f ms  %zu bricks, %zu threads\n", voxelSize, coldMs, fillMs, cache.GetBrickCount(), jobSystem.GetThreadCount());
+		printf("                 warm %8.3f ms  %7.1f ns/query  %.1fx  misses %llu  max error %.4f\n",
+			warmMs, warmMs * 1e6 / double(queryCount), exactMs / warmMs, (unsigned long long)warmMisses, maxError);
+	}
+
+	if (!program.IsTimeDependent() || !hasStaticPart)
+		return;
+
+	// the ball moves with the time, only the bricks around it are sampled again on each update
+	Engine::SDF staticPart(&staticProgram, ProgramDistance, ProgramDistances);
+
+	Engine::SdfBrickCache cache;
+	cache.Init(exact, 0.25f, 2.f, 16384, &jobSystem);
+	cache.SetStaticPart(staticPart, 2.f);
+	Engine::SDF cached = cache.GetSDF();
+
+	MeasureQueries(cached, points, cachedDistances);
+	cache.Update();
+
+	const size_t frameCount = 10;
+	double refreshMs = 0.0;
+	double refillMs = 0.0;
+	float maxError = 0.f;
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		benchmarkTime += 0.1f;
+
+		MeasureQueries(cached, points, cachedDistances);
+		Stopwatch refresh;
+		cache.Update();
+		refreshMs += refresh.ElapsedMilliseconds();
+
+		MeasureQueries(exact, points, exactDistances);
+		MeasureQueries(cached, points, cachedDistances);
+		for (size_t i = 0; i < queryCount; i++)
+			maxError = glm::max(maxError, glm::abs(cachedDistances[i] - exactDistances[i]));
+
+		// what a cache without the static part has to do to follow the source
+		Engine::SdfBrickCache fullCache;
+		fullCache.Init(exact, 0.25f, 2.f, 16384, &jobSystem);
+		MeasureQueries(fullCache.GetSDF(), points, cachedDistances);
+		Stopwatch refill;
+		fullCache.Update();
+		refillMs += refill.ElapsedMilliseconds();
+	}
+
+	printf("  animated       %zu of %zu bricks animated\n", cache.GetAnimatedBrickCount(), cache.GetBrickCount());
+	printf("                 update %8.3f ms  full refill %8.3f ms  %.1fx  max error %.4f\n",
+		refreshMs / double(frameCount), refillMs / double(frameCount), refillMs / refreshMs, maxError);
+}
@@ -8,9 +8,12 @@
 #include "game_object.h"
 #include "transform.h"
 #include "script_component.h"
+#include <thread>
 
 static float totalTime = 0.f;
-App_SetupTest* p_currentApp = nullptr;
+// how far the branch tips of the tree sway, the time only enters as cos(Time), so they move at most
+// this far per second as well
+static constexpr float treeSway = 2.f;
 
 
 float Box(const glm::vec3& p, const glm::vec3& b)
@@ -80,9 +83,141 @@ glm::vec2 Tree(glm::vec3 p)
 	return glm::vec2(itr / 7.f, d);
 }
 
-float WorldSDF(const glm::vec3& p)
+// the same shapes on duals for the gradient of the world, the vectors of the dual program have the layout of these
+struct DualVec2
 {
-	return p_currentApp->p_worldSdfProgram->Execute<glm::vec4>(p).w;
+	Engine::Dual x;
+	Engine::Dual y;
+};
+
+struct DualVec4
+{
+	Engine::Dual x;
+	Engine::Dual y;
+	Engine::Dual z;
+	Engine::Dual w;
+};
+
+static_assert(sizeof(Engine::Dual) == sizeof(Tolo::Dual), "the natives read the program's duals as engine duals");
+
+Engine::Dual DualBox(const Engine::DualVec3& p, const glm::vec3& b)
+{
+	Engine::DualVec3 q = Engine::DualVec3{ Engine::Abs(p.x), Engine::Abs(p.y), Engine::Abs(p.z) } - b;
+	Engine::Dual zero = Engine::Dual::Constant(0.f);
+	Engine::Dual outside = Engine::Length({ Engine::Max(q.x, zero), Engine::Max(q.y, zero), Engine::Max(q.z, zero) });
+	return outside + Engine::Min(Engine::Max(q.x, Engine::Max(q.y, q.z)), zero);
+}
+
+Engine::DualVec3 DualRepXZ(const Engine::DualVec3& p, const glm::vec2& s)
+{
+	// the repetition moves whole cells, which does not change the gradient
+	glm::vec2 q = s * glm::round(glm::vec2(p.x.value, p.z.value) / s);
+	return p - glm::vec3(q.x, 0.f, q.y);
+}
+
+Engine::DualVec3 DualRotX(const Engine::DualVec3& p, float k)
+{
+	Engine::Dual k0 = Engine::Atan2(p.y, p.z);
+	Engine::Dual r = Engine::Sqrt(p.y * p.y + p.z * p.z);
+	return { p.x, r * Engine::Sin(k0 + k), r * Engine::Cos(k0 + k) };
+}
+
+Engine::DualVec3 DualFold(const Engine::DualVec3& p, const glm::vec3& n)
+{
+	return p - n * (2.f * Engine::Min(Engine::Dual::Constant(0.f), Engine::Dot(p, n)));
+}
+
+Engine::Dual DualCapsule(const Engine::DualVec3& p, const glm::vec3& a, const glm::vec3& b, float r)
+{
+	Engine::DualVec3 pa = p - a;
+	glm::vec3 ba = b - a;
+	Engine::Dual h = Engine::Clamp(Engine::Dot(pa, ba) / glm::dot(ba, ba), 0.f, 1.f);
+	return Engine::Length(pa - ba * h) - r;
+}
+
+DualVec2 DualTree(Engine::DualVec3 p)
+{
+	glm::vec2 dim = glm::vec2(1.f, 8.f);
+	Engine::Dual d = DualCapsule(p, glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f, 1.f + dim.y, 0.f), dim.x);
+	glm::vec3 scale = glm::vec3(1.f);
+	glm::vec3 change = glm::vec3(0.7f, 0.68f, 0.7f);
+	float itr = 0.f;
+
+	glm::vec3 n1 = normalize(glm::vec3(1.f, 0.f, 1.f + 0.1 * glm::cos(totalTime)));
+	glm::vec3 n2 = glm::vec3(n1.x, 0.f, -n1.z);
+	glm::vec3 n3 = glm::vec3(-n1.x, 0.f, n1.z);
+
+	for (int i = 0; i < 7; i++)
+	{
+		p = DualFold(p, n1);
+		p = DualFold(p, n2);
+		p = DualFold(p, n3);
+
+		p.y = p.y - scale.y * dim.y;
+		p.z = Engine::Abs(p.z);
+		p = DualRotX(p, 3.1415f * 0.25f);
+		scale *= change;
+
+		Engine::Dual d2 = DualCapsule(p, glm::vec3(0.f), glm::vec3(0.f, dim.y * scale.y, 0.), scale.x * dim.x);
+
+		if (d2.value < d.value)
+		{
+			d = d2;
+			itr = (float)i;
+		}
+	}
+
+	return { Engine::Dual::Constant(itr / 7.f), d };
+}
+
+void WorldBatchSDF(const void* p_app, const glm::vec3* p_points, float* p_outDistances, size_t count)
+{
+	// called from the job system threads, each thread runs the program on its own stack, which is
+	// looked up once for the whole batch
+	thread_local Tolo::ExecutionStack stack;
+	Tolo::ProgramHandle* p_program = static_cast<const App_SetupTest*>(p_app)->p_worldSdfProgram;
+
+	for (size_t i = 0; i < count; i++)
+		p_outDistances[i] = p_program->ExecuteOn<glm::vec4>(stack, p_points[i]).w;
+}
+
+void WorldStaticBatchSDF(const void* p_app, const glm::vec3* p_points, float* p_outDistances, size_t count)
+{
+	// a stack of its own, sharing one with the full program would copy the code on every switch
+	thread_local Tolo::ExecutionStack stack;
+	Tolo::ProgramHandle* p_program = static_cast<const App_SetupTest*>(p_app)->p_worldSdfStaticProgram;
+
+	for (size_t i = 0; i < count; i++)
+		p_outDistances[i] = p_program->ExecuteOn<glm::vec4>(stack, p_points[i]).w;
+}
+
+float WorldStaticSDF(const void* p_app, const glm::vec3& p)
+{
+	float distance;
+	WorldStaticBatchSDF(p_app, &p, &distance, 1);
+	return distance;
+}
+
+float WorldSDF(const void* p_app, const glm::vec3& p)
+{
+	float distance;
+	WorldBatchSDF(p_app, &p, &distance, 1);
+	return distance;
+}
+
+float WorldGradientSDF(const void* p_app, const glm::vec3& p, glm::vec3& outGradient)
+{
+	// one run of the dual program instead of the four normal taps, the taps are left for a world that
+	// calls a native without a dual version
+	thread_local Tolo::ExecutionStack stack;
+	Tolo::ProgramHandle* p_program = static_cast<const App_SetupTest*>(p_app)->p_worldSdfDualProgram;
+
+	if (p_program == nullptr)
+		return Engine::SDF(p_app, WorldSDF, WorldBatchSDF).Gradient(p, outGradient);
+
+	Engine::Dual distance = p_program->ExecuteOn<DualVec4>(stack, Engine::DualVec3::Variable(p)).w;
+	outGradient = distance.gradient;
+	return distance.value;
 }
 
 namespace ToloFunctions
@@ -125,6 +260,116 @@ namespace ToloFunctions
 		float a = Tolo::Pop<float>(vm);
 		Tolo::Push<float>(vm, glm::sin(a));
 	}
+
+	void vec3_operator_plus_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 a = Tolo::Pop<Engine::DualVec3>(vm);
+		Engine::DualVec3 b = Tolo::Pop<Engine::DualVec3>(vm);
+		Tolo::PushStruct<Engine::DualVec3>(vm, a + b);
+	}
+
+	void vec3_operator_minus_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 a = Tolo::Pop<Engine::DualVec3>(vm);
+		Engine::DualVec3 b = Tolo::Pop<Engine::DualVec3>(vm);
+		Tolo::PushStruct<Engine::DualVec3>(vm, a - b);
+	}
+
+	void vec3_operator_negate_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 a = Tolo::Pop<Engine::DualVec3>(vm);
+		Tolo::PushStruct<Engine::DualVec3>(vm, -a);
+	}
+
+	void vec3_operator_mult_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 a = Tolo::Pop<Engine::DualVec3>(vm);
+		Engine::Dual b = Tolo::Pop<Engine::Dual>(vm);
+		Tolo::PushStruct<Engine::DualVec3>(vm, a * b);
+	}
+
+	void vec3_length_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 v = Tolo::Pop<Engine::DualVec3>(vm);
+		Tolo::PushStruct<Engine::Dual>(vm, Engine::Length(v));
+	}
+
+	void float_sin_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::Dual a = Tolo::Pop<Engine::Dual>(vm);
+		Tolo::PushStruct<Engine::Dual>(vm, Engine::Sin(a));
+	}
+
+	void float_cos_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::Dual a = Tolo::Pop<Engine::Dual>(vm);
+		Tolo::PushStruct<Engine::Dual>(vm, Engine::Cos(a));
+	}
+
+	void vec4_union_dual(Tolo::VirtualMachine& vm)
+	{
+		DualVec4 a = Tolo::Pop<DualVec4>(vm);
+		DualVec4 b = Tolo::Pop<DualVec4>(vm);
+		Tolo::PushStruct<DualVec4>(vm, a.w.value < b.w.value ? a : b);
+	}
+
+	void vec4_cut_dual(Tolo::VirtualMachine& vm)
+	{
+		DualVec4 a = Tolo::Pop<DualVec4>(vm);
+		DualVec4 b = Tolo::Pop<DualVec4>(vm);
+		b.w = -b.w;
+		Tolo::PushStruct<DualVec4>(vm, a.w.value > b.w.value ? a : b);
+	}
+
+	void vec4_intersect_dual(Tolo::VirtualMachine& vm)
+	{
+		DualVec4 a = Tolo::Pop<DualVec4>(vm);
+		DualVec4 b = Tolo::Pop<DualVec4>(vm);
+		Tolo::PushStruct<DualVec4>(vm, a.w.value > b.w.value ? a : b);
+	}
+
+	void vec4_smooth_union_dual(Tolo::VirtualMachine& vm)
+	{
+		DualVec4 a = Tolo::Pop<DualVec4>(vm);
+		DualVec4 b = Tolo::Pop<DualVec4>(vm);
+		Engine::Dual k = Tolo::Pop<Engine::Dual>(vm);
+
+		Engine::Dual h = Engine::Clamp(0.5f + 0.5f * (b.w - a.w) / k, 0.f, 1.f);
+		DualVec4 d = {
+			b.x + (a.x - b.x) * h,
+			b.y + (a.y - b.y) * h,
+			b.z + (a.z - b.z) * h,
+			b.w + (a.w - b.w) * h
+		};
+		d.w = d.w - k * h * (1.f - h);
+		Tolo::PushStruct<DualVec4>(vm, d);
+	}
+
+	void box_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 p = Tolo::Pop<Engine::DualVec3>(vm);
+		Engine::DualVec3 b = Tolo::Pop<Engine::DualVec3>(vm);
+		Tolo::PushStruct<Engine::Dual>(vm, DualBox(p, glm::vec3(b.x.value, b.y.value, b.z.value)));
+	}
+
+	void tree_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 p = Tolo::Pop<Engine::DualVec3>(vm);
+		Tolo::PushStruct<DualVec2>(vm, DualTree(p));
+	}
+
+	void rep_xz_dual(Tolo::VirtualMachine& vm)
+	{
+		Engine::DualVec3 p = Tolo::Pop<Engine::DualVec3>(vm);
+		Engine::Dual x = Tolo::Pop<Engine::Dual>(vm);
+		Engine::Dual y = Tolo::Pop<Engine::Dual>(vm);
+		Tolo::PushStruct<Engine::DualVec3>(vm, DualRepXZ(p, glm::vec2(x.value, y.value)));
+	}
+
+	void time_dual(Tolo::VirtualMachine& vm)
+	{
+		Tolo::PushStruct<Engine::Dual>(vm, Engine::Dual::Constant(totalTime));
+	}
 }
 
 void InitSdfProgram(Tolo::ProgramHandle& program)
@@ -153,17 +398,17 @@ void InitSdfProgram(Tolo::ProgramHandle& program)
 			{"float", "w"}
 		}
 	});
-	program.AddFunction({ "vec3", "operator+", {"vec3", "vec3"}, ToloFunctions::vec3_operator_plus});
-	program.AddFunction({ "vec3", "operator-", {"vec3", "vec3"}, ToloFunctions::vec3_operator_minus});
-	program.AddFunction({ "vec3", "operator-", {"vec3"}, ToloFunctions::vec3_operator_negate});
-	program.AddFunction({ "vec3", "operator*", {"vec3", "float"}, ToloFunctions::vec3_operator_mult});
-	program.AddFunction({ "float", "length", {"vec3"}, ToloFunctions::vec3_length});
-	program.AddFunction({ "float", "sin", {"float"}, ToloFunctions::float_sin});
+	program.AddFunction({ "vec3", "operator+", {"vec3", "vec3"}, ToloFunctions::vec3_operator_plus, false, ToloFunctions::vec3_operator_plus_dual });
+	program.AddFunction({ "vec3", "operator-", {"vec3", "vec3"}, ToloFunctions::vec3_operator_minus, false, ToloFunctions::vec3_operator_minus_dual });
+	program.AddFunction({ "vec3", "operator-", {"vec3"}, ToloFunctions::vec3_operator_negate, false, ToloFunctions::vec3_operator_negate_dual });
+	program.AddFunction({ "vec3", "operator*", {"vec3", "float"}, ToloFunctions::vec3_operator_mult, false, ToloFunctions::vec3_operator_mult_dual });
+	program.AddFunction({ "float", "length", {"vec3"}, ToloFunctions::vec3_length, false, ToloFunctions::vec3_length_dual });
+	program.AddFunction({ "float", "sin", {"float"}, ToloFunctions::float_sin, false, ToloFunctions::float_sin_dual });
 	program.AddFunction({ "float", "cos", {"float"}, [](Tolo::VirtualMachine& vm)
 		{
 			float a = Tolo::Pop<float>(vm);
 			Tolo::Push<float>(vm, glm::cos(a));
-		}
+		}, false, ToloFunctions::float_cos_dual
 	});
 	program.AddFunction({ "vec4", "Union", {"vec4", "vec4"}, [](Tolo::VirtualMachine& vm)
 		{
@@ -174,7 +419,7 @@ void InitSdfProgram(Tolo::ProgramHandle& program)
 				Tolo::PushStruct<glm::vec4>(vm, a);
 			else
 				Tolo::PushStruct<glm::vec4>(vm, b);
-		} 
+		}, false, ToloFunctions::vec4_union_dual
 	});
 	program.AddFunction({ "vec4", "Cut", {"vec4", "vec4"}, [](Tolo::VirtualMachine& vm)
 		{
@@ -186,7 +431,7 @@ void InitSdfProgram(Tolo::ProgramHandle& program)
 				Tolo::PushStruct<glm::vec4>(vm, a);
 			else
 				Tolo::PushStruct<glm::vec4>(vm, b);
-		}
+		}, false, ToloFunctions::vec4_cut_dual
 	});
 	program.AddFunction({ "vec4", "Intersect", {"vec4", "vec4"}, [](Tolo::VirtualMachine& vm)
 		{
@@ -197,7 +442,7 @@ void InitSdfProgram(Tolo::ProgramHandle& program)
 				Tolo::PushStruct<glm::vec4>(vm, a);
 			else
 				Tolo::PushStruct<glm::vec4>(vm, b);
-		}
+		}, false, ToloFunctions::vec4_intersect_dual
 	});
 	program.AddFunction({ "vec4", "SmoothUnion", {"vec4", "vec4", "float"}, [](Tolo::VirtualMachine& vm)
 		{
@@ -208,20 +453,21 @@ void InitSdfProgram(Tolo::ProgramHandle& program)
 			float h = glm::clamp(0.5f + 0.5f * (b.w - a.w) / k, 0.f, 1.f);
 			glm::vec4 d = glm::mix(b, a, h);
 			Tolo::PushStruct<glm::vec4>(vm, glm::vec4(glm::vec3(d), d.w - (k * h * (1.f - h))));
-		}
+		}, false, ToloFunctions::vec4_smooth_union_dual
 	});
 	program.AddFunction({ "float", "Box", {"vec3", "vec3"}, [](Tolo::VirtualMachine& vm)
 		{
 			glm::vec3 p = Tolo::Pop<glm::vec3>(vm);
 			glm::vec3 b = Tolo::Pop<glm::vec3>(vm);
 			Tolo::Push<float>(vm, Box(p, b));
-		}
+		}, false, ToloFunctions::box_dual
 	});
+	// the tree sways with the time
 	program.AddFunction({ "vec2", "Tree", {"vec3"}, [](Tolo::VirtualMachine& vm)
 		{
 			glm::vec3 p = Tolo::Pop<glm::vec3>(vm);
 			Tolo::PushStruct<glm::vec2>(vm, Tree(p));
-		}
+		}, true, ToloFunctions::tree_dual
 	});
 	program.AddFunction({ "vec3", "RepXZ", {"vec3", "float", "float"}, [](Tolo::VirtualMachine& vm)
 		{
@@ -229,12 +475,12 @@ void InitSdfProgram(Tolo::ProgramHandle& program)
 			float x = Tolo::Pop<float>(vm);
 			float y = Tolo::Pop<float>(vm);
 			Tolo::PushStruct<glm::vec3>(vm, RepXZ(p, glm::vec2(x, y)));
-		}
+		}, false, ToloFunctions::rep_xz_dual
 	});
 	program.AddFunction({ "float", "Time", {}, [](Tolo::VirtualMachine& vm)
 		{
 			Tolo::Push<float>(vm, totalTime);
-		}
+		}, true, ToloFunctions::time_dual
 	});
 }
 
@@ -243,25 +489,71 @@ void App_SetupTest::ReloadWorldSdf()
 	Engine::Info("compiling sdf object");
 
 	Tolo::ProgramHandle* p_newProgram = nullptr;
+	Tolo::ProgramHandle* p_newStaticProgram = nullptr;
+	Tolo::ProgramHandle* p_newDualProgram = nullptr;
 	std::string sdfCode;
 	try
 	{
 		p_newProgram = new Tolo::ProgramHandle(sdfFileWatchers[0].filePath, 1024, "Sdf");
 		InitSdfProgram(*p_newProgram);
 		p_newProgram->Compile(sdfCode);
+
+		// the cache only samples the animated parts of the world again, which it finds with the static part
+		if (p_newProgram->IsTimeDependent())
+		{
+			p_newStaticProgram = new Tolo::ProgramHandle(sdfFileWatchers[0].filePath, 1024, "Sdf");
+			InitSdfProgram(*p_newStaticProgram);
+
+			if (!p_newStaticProgram->CompileStaticPart())
+			{
+				delete p_newStaticProgram;
+				p_newStaticProgram = nullptr;
+				Engine::Info("sdf object has no static part, physics samples all of it again every frame");
+			}
+		}
 	}
 	catch (const Tolo::Error& error)
 	{
 		delete p_newProgram;
+		delete p_newStaticProgram;
 		error.Print();
 		Engine::Info("failed to compile sdf object, keeping old version");
 		return;
 	}
 
+	// the gradients of the world come from one run of this, the duals make every value four times as large
+	try
+	{
+		p_newDualProgram = new Tolo::ProgramHandle(sdfFileWatchers[0].filePath, 4096, "Sdf");
+		InitSdfProgram(*p_newDualProgram);
+		p_newDualProgram->CompileDual();
+	}
+	catch (const Tolo::Error& error)
+	{
+		delete p_newDualProgram;
+		p_newDualProgram = nullptr;
+		error.Print();
+		Engine::Info("sdf object has no dual version, physics normals fall back to the taps");
+	}
+
 	sdfRenderer.Reload(sdfCode);
 
 	delete p_worldSdfProgram;
+	delete p_worldSdfStaticProgram;
+	delete p_worldSdfDualProgram;
 	p_worldSdfProgram = p_newProgram;
+	p_worldSdfStaticProgram = p_newStaticProgram;
+	p_worldSdfDualProgram = p_newDualProgram;
+
+	if (p_worldSdfStaticProgram != nullptr)
+		worldSdfCache.SetStaticPart(Engine::SDF(this, WorldStaticSDF, WorldStaticBatchSDF), treeSway);
+	else if (p_worldSdfProgram->IsTimeDependent())
+		worldSdfCache.SetAllAnimated();
+	else
+		worldSdfCache.SetStaticPart(Engine::SDF(), 0.f);
+
+	// the distances the bodies measured to the old world say nothing about the new one
+	physicsWorld.InvalidateWorldDistances();
 }
 
 void App_SetupTest::UpdateSdfFileWatcher()
@@ -278,12 +570,15 @@ void App_SetupTest::UpdateSdfFileWatcher()
 
 
 App_SetupTest::App_SetupTest() :
-	p_worldSdfProgram(nullptr)
+	p_worldSdfProgram(nullptr),
+	p_worldSdfStaticProgram(nullptr),
+	p_worldSdfDualProgram(nullptr)
 {}
 
 void App_SetupTest::Init()
 {
-	p_currentApp = this;
+	size_t hardwareThreads = std::thread::hardware_concurrency();
+	jobSystem.Init(hardwareThreads > 1 ? hardwareThreads - 1 : 0);
 
 	window.Init(1200, 800, "setup_test");
 	//window.Init(800, 600, "setup_test");
@@ -296,8 +591,14 @@ void App_SetupTest::Init()
 	sdfRenderer.Init(window.Width(), window.Height());
 	ReloadWorldSdf();
 
-	physicsWorld.Init(WorldSDF, { 0.3f, 0.4f });
+	// physics queries go through a cache of the program around the surface, 0.25 m voxels within 2 m
+	worldSdfCache.Init(Engine::SDF(this, WorldSDF, WorldBatchSDF, WorldGradientSDF), 0.25f, 2.f, 4096, &jobSystem);
+	physicsWorld.Init(worldSdfCache.GetSDF(), { 0.3f, 0.4f }, &jobSystem);
 	physicsWorld.gravity = glm::vec3(0.f, -9.82f, 0.f);
+	physicsWorld.worldSurfaceSpeed = treeSway;
+	// the interpolated world is steeper than an sdf and a little off around the tree, the sweeps allow for both
+	physicsWorld.worldLipschitzBound = Engine::SdfBrickCache::lipschitzBound;
+	physicsWorld.ccdTolerance = worldSdfCache.GetErrorBound();
 
 	for (size_t i = 0; i < spheres.size(); i++)
 	{
@@ -305,13 +606,15 @@ void App_SetupTest::Init()
 		float radius = 1.f;
 
 		Engine::Rigidbody& rb = spheres[i].rb;
-		rb.centerOfMass = glm::vec3(0.f + glm::cos(float(i)), 20.f + i * 3.f, 30.f);
+		rb = physicsWorld.CreateRigidbody();
+		rb.SetCenterOfMass(glm::vec3(0.f + glm::cos(float(i)), 20.f + i * 3.f, 30.f));
 		rb.SetMass(mass);
 		rb.SetInertiaTensor(Engine::Rigidbody::SphereInertiaTensor(radius, mass));
+		rb.SetContinuousCollision(true);
 
 		spheres[i].collider.radius = radius;
 
-		physicsWorld.AddObject(&spheres[i].collider, &rb, { 0.8f, 0.4f });
+		physicsWorld.AddObject(&spheres[i].collider, rb, { 0.8f, 0.4f });
 	}
 
 	for (size_t i = 0; i < capsules.size(); i++)
@@ -321,21 +624,23 @@ void App_SetupTest::Init()
 		float height = 2.f;
 
 		Engine::Rigidbody& rb = capsules[i].rb;
-		rb.centerOfMass = glm::vec3(0.f + glm::cos(float(i)), 20.f + i * 4.f, 10.f);
+		rb = physicsWorld.CreateRigidbody();
+		rb.SetCenterOfMass(glm::vec3(0.f + glm::cos(float(i)), 20.f + i * 4.f, 10.f));
 		rb.SetMass(mass);
 		rb.SetInertiaTensor(Engine::Rigidbody::CylinderInertiaTensor(radius, height + radius, mass));
-		rb.angularDamping = 0.9f;
+		rb.SetAngularDamping(0.9f);
+		rb.SetContinuousCollision(true);
 
 		capsules[i].collider.radius = radius;
 		capsules[i].collider.height = height;
 
-		physicsWorld.AddObject(&capsules[i].collider, &rb, { 0.8f, 0.4f });
+		physicsWorld.AddObject(&capsules[i].collider, rb, { 0.8f, 0.4f });
 	}
 
 	player.AddToPhysicsWorld(physicsWorld);
 	player.rigidbody.SetMass(100.f);
 	player.rigidbody.SetInertiaTensor(Engine::Rigidbody::CylinderInertiaTensor(1.f, 2.f, 100.f));
-	player.rigidbody.centerOfMass = glm::vec3(4.f, 4.f, 0.f);
+	player.rigidbody.SetCenterOfMass(glm::vec3(4.f, 4.f, 0.f));
 	player.rigidbody.SetLockRotation(true);
 	player.camera.Init(70.f, (float)window.Width() / window.Height(), 0.3f, 500.f);
 
@@ -440,11 +745,13 @@ void App_SetupTest::UpdateLoop()
 		if (IP.GetKey(GLFW_KEY_END).WasPressed())
 			break;
 
+		worldSdfCache.Update();
 		physicsWorld.Update(fixedDeltaTime);
 
 		for (Engine::Collision& collision : physicsWorld.collisions)
 		{
-			if (glm::length2(collision.impulse) * collision.p_object->p_rigidbody->inverseMass > 300.f)
+			Engine::PhysicsObject* p_object = physicsWorld.GetPhysicsObject(collision.object);
+			if (glm::length2(collision.impulse) * p_object->rigidbody.GetInverseMass() > 300.f)
 			{
 				particles.push_back(glm::vec4(collision.hitPoint + glm::vec3(0.1f, 0.f, 0.f), 0.1f));
 				particles.push_back(glm::vec4(collision.hitPoint - glm::vec3(0.f, 0.1f, 0.f), 0.f));
@@ -512,8 +819,8 @@ void App_SetupTest::UpdateLoop()
 
 		for (size_t i = 0; i < spheres.size(); i++)
 		{
-			glm::mat4 M = glm::mat4(glm::mat3_cast(spheres[i].rb.rotation) * glm::mat3(spheres[i].collider.radius));
-			M[3] = glm::vec4(spheres[i].rb.centerOfMass, 1.f);
+			glm::mat4 M = glm::mat4(glm::mat3_cast(spheres[i].rb.GetRotation()) * glm::mat3(spheres[i].collider.radius));
+			M[3] = glm::vec4(spheres[i].rb.GetCenterOfMass(), 1.f);
 			glm::mat4 MVP = VP * M;
 			glm::mat3 N = glm::transpose(glm::inverse(glm::mat3(M)));
 			glm::vec3 color(1.f, 0.9f, 0.9f);
@@ -530,13 +837,13 @@ void App_SetupTest::UpdateLoop()
 		capsuleMesh.Bind();
 		for (size_t i = 0; i < capsules.size(); i++)
 		{
-			glm::mat4 M = glm::mat4(glm::mat3_cast(capsules[i].rb.rotation) * glm::mat3(
+			glm::mat4 M = glm::mat4(glm::mat3_cast(capsules[i].rb.GetRotation()) * glm::mat3(
 				capsules[i].collider.radius, 0.f, 0.f,
 				0.f, capsules[i].collider.height/2.f, 0.f,
 				0.f, 0.f, capsules[i].collider.radius
 			));
 
-			M[3] = glm::vec4(capsules[i].rb.centerOfMass, 1.f);
+			M[3] = glm::vec4(capsules[i].rb.GetCenterOfMass(), 1.f);
 			glm::mat4 MVP = VP * M;
 			glm::mat3 N = glm::transpose(glm::inverse(glm::mat3(M)));
 			glm::vec3 color(0.9f, 1.f, 1.f);
@@ -600,5 +907,6 @@ void App_SetupTest::UpdateLoop()
 
 void App_SetupTest::Deinit()
 {
+	jobSystem.Deinit();
 	window.Deinit();
 }
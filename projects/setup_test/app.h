@@ -5,6 +5,8 @@
 #include "shader.h"
 #include "sdf_renderer.h"
 #include "file_watcher.h"
+#include "job_system.h"
+#include "sdf_brick_cache.h"
 
 class App_SetupTest
 {
@@ -22,7 +24,11 @@ public:
 	};
 
 	Engine::Window window;
+	Engine::JobSystem jobSystem;
 	Tolo::ProgramHandle* p_worldSdfProgram;
+	Tolo::ProgramHandle* p_worldSdfStaticProgram;// the world without its time-varying parts, null when it has none
+	Tolo::ProgramHandle* p_worldSdfDualProgram;// the world on duals for its gradient, null when a native has no dual version
+	Engine::SdfBrickCache worldSdfCache;
 	Engine::FileWatcher sdfFileWatchers[3];
 	SdfRenderer sdfRenderer;
 	Engine::PhysicsWorld physicsWorld;
@@ -14,12 +14,13 @@ Player::Player() :
 
 glm::vec3 Player::GetCameraPos()
 {
-	return rigidbody.centerOfMass + glm::vec3(0.f, collider.height * 0.5f, 0.f);
+	return rigidbody.GetCenterOfMass() + glm::vec3(0.f, collider.height * 0.5f, 0.f);
 }
 
 void Player::AddToPhysicsWorld(PhysicsWorld& physicsWorld)
 {
-	physicsWorld.AddObject(&collider, &rigidbody, { 0.1f, 0.8f });
+	rigidbody = physicsWorld.CreateRigidbody();
+	physicsWorld.AddObject(&collider, rigidbody, { 0.1f, 0.8f }, { collisionCategory, CollisionFilter::E_All });
 	p_physicsWorld = &physicsWorld;
 }
 
@@ -27,7 +28,7 @@ bool Player::IsOnGround()
 {
 	HitResult hit;
 	return p_physicsWorld->RaycastWorld(
-		rigidbody.centerOfMass, 
+		rigidbody.GetCenterOfMass(),
 		glm::vec3(0.f, -1.f, 0.f), 
 		collider.height * 0.5f + collider.radius + 0.3f,
 		hit
@@ -63,15 +64,16 @@ void Player::Update(float deltaTime)
 	glm::vec3 planarRight= glm::normalize(glm::vec3(cameraTransform[0].x, 0.f, cameraTransform[0].z));
 	glm::vec3 planarForward = glm::normalize(glm::vec3(cameraTransform[2].x, 0.f, cameraTransform[2].z));
 
-	float velY = rigidbody.linearVelocity.y;
+	float velY = rigidbody.GetLinearVelocity().y;
 	glm::vec3 move = planarRight * axis.x + planarForward * axis.y;
 
-	rigidbody.linearVelocity = ClampMagnitude(move, 1.f) * movementSpeed + glm::vec3(0.f, velY, 0.f);
+	rigidbody.SetLinearVelocity(ClampMagnitude(move, 1.f) * movementSpeed + glm::vec3(0.f, velY, 0.f));
 
 	if (IP.GetKey(GLFW_KEY_SPACE).WasPressed()&& IsOnGround())
 	{
-		rigidbody.linearVelocity.y = glm::sqrt(2.f * 9.82f * jumpHeight);
-		rigidbody.centerOfMass.y += 0.4f;
+		glm::vec3 velocity = rigidbody.GetLinearVelocity();
+		rigidbody.SetLinearVelocity(glm::vec3(velocity.x, glm::sqrt(2.f * 9.82f * jumpHeight), velocity.z));
+		rigidbody.SetCenterOfMass(rigidbody.GetCenterOfMass() + glm::vec3(0.f, 0.4f, 0.f));
 		collider.worldMatrix[3].y += 0.4f;
 	}
 
@@ -107,21 +109,26 @@ void Player::Update(float deltaTime)
 
 	glm::vec3 camForward = cameraTransform[2];
 
-	static Engine::PhysicsObject* p_obj = nullptr;
+	static Engine::PhysicsObjectHandle heldObject = { 0, 0 };
 	static glm::mat4 relativeTransform(1.f);
 	float holdDistance = 10.f;
 
+	// the held object may have been removed from the world since the last frame
+	Engine::PhysicsObject* p_obj = p_physicsWorld->GetPhysicsObject(heldObject);
+
 	if (mouse.leftButton.WasPressed() || IP.GetKey(GLFW_KEY_KP_0).WasPressed())
 	{
 		if (p_obj != nullptr)
 		{
-			p_obj->p_rigidbody->AddImpulse(camForward * 8000.f);
+			p_obj->rigidbody.AddImpulse(camForward * 8000.f);
 			p_obj = nullptr;
+			heldObject = { 0, 0 };
 		}
 		else
 		{
 			Engine::HitResult hit;
-			p_obj = p_physicsWorld->RaycastObjects(camPos, camForward, 100.f, hit, &collider);
+			heldObject = p_physicsWorld->RaycastObjects(camPos, camForward, 100.f, hit, &collider);
+			p_obj = p_physicsWorld->GetPhysicsObject(heldObject);
 
 			if (p_obj != nullptr)
 			{
@@ -135,10 +142,10 @@ void Player::Update(float deltaTime)
 	if (p_obj != nullptr)
 	{
 		glm::mat4 objTransform = cameraTransform * relativeTransform;
-		glm::vec3 toGoal = glm::vec3(objTransform[3]) - p_obj->p_rigidbody->centerOfMass;
+		glm::vec3 toGoal = glm::vec3(objTransform[3]) - p_obj->rigidbody.GetCenterOfMass();
 		float springConstant = 10000.f;
-		p_obj->p_rigidbody->AddForce(toGoal * springConstant);
-		p_obj->p_rigidbody->linearVelocity *= 0.8f;
-		p_obj->p_rigidbody->rotation = glm::quat_cast(glm::mat3(objTransform));
+		p_obj->rigidbody.AddForce(toGoal * springConstant);
+		p_obj->rigidbody.SetLinearVelocity(p_obj->rigidbody.GetLinearVelocity() * 0.8f);
+		p_obj->rigidbody.SetRotation(glm::quat_cast(glm::mat3(objTransform)));
 	}
 }
\ No newline at end of file
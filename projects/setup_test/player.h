@@ -12,6 +12,8 @@ private:
 	glm::vec3 GetCameraPos();
 
 public:
+	static constexpr uint32_t collisionCategory = 1u << 1;// objects leave this out of their mask to pass through the player
+
 	Camera camera;
 	glm::mat4 cameraTransform;
 	Rigidbody rigidbody;
@@ -10,6 +10,14 @@ namespace Tolo
 	typedef float Float;
 	typedef unsigned long long Ptr;
 
+	// a float together with its gradient with respect to the arguments of main, every float of a program
+	// compiled with ProgramHandle::CompileDual is one of these
+	struct Dual
+	{
+		Float value;
+		Float gradient[3];
+	};
+
 	enum class OpCode : Char
 	{
 		//					Next instruction	Stack before		Stack after
@@ -32,7 +32,8 @@ namespace Tolo
 	{}
 
 	NativeFunctionInfo::NativeFunctionInfo() :
-		functionPtr(0)
+		functionPtr(0),
+		dualFunctionPtr(0)
 	{}
 
 	StructInfo::StructInfo()
@@ -143,6 +144,18 @@ namespace Tolo
 		currentExpectedReturnType = "void";
 	}
 
+	void Parser::UseDualFloats()
+	{
+		typeNameToSize["float"] = sizeof(Dual);
+
+		// the bit operations reinterpret the bits of a float, which has no meaning for a dual
+		for (OpCode& opCode : typeNameOperators["float"])
+		{
+			if (opCode >= OpCode::Bit_32_And && opCode <= OpCode::Bit_32_RightShift)
+				opCode = OpCode::INVALID;
+		}
+	}
+
 	bool Parser::HasBody(LexNode* p_lexNode, Int& outBodyStartIndex, Int& outBodyEndIndex)
 	{
 		switch (p_lexNode->type)
@@ -541,7 +554,7 @@ namespace Tolo
 			p_callNativeOp->argumentLoads.push_back(ParseNextExpression(p_lexNode->children[1]));
 			currentExpectedReturnType = oldRetType;
 
-			p_callNativeOp->functionPtrLoad = new ELoadConstPtr(funcInfo.functionPtr);
+			p_callNativeOp->functionPtrLoad = LoadNativeFunctionPtr(funcInfo, "operator" + opName, p_lexNode->token.line);
 
 			return p_callNativeOp;
 		}
@@ -635,7 +648,7 @@ namespace Tolo
 			ECallNativeFunction* p_callNativeOp = new ECallNativeFunction(funcInfo.returnTypeName);
 			p_callNativeOp->argumentLoads.push_back(p_lhs);
 			p_callNativeOp->argumentLoads.push_back(ParseNextExpression(p_lexNode->children[1]));
-			p_callNativeOp->functionPtrLoad = new ELoadConstPtr(funcInfo.functionPtr);
+			p_callNativeOp->functionPtrLoad = LoadNativeFunctionPtr(funcInfo, "operator" + opName, p_lexNode->token.line);
 
 			currentExpectedReturnType = "char";
 
@@ -721,7 +734,7 @@ namespace Tolo
 
 			ECallNativeFunction* p_callNativeOp = new ECallNativeFunction(funcInfo.returnTypeName);
 			p_callNativeOp->argumentLoads.push_back(p_val);
-			p_callNativeOp->functionPtrLoad = new ELoadConstPtr(funcInfo.functionPtr);
+			p_callNativeOp->functionPtrLoad = LoadNativeFunctionPtr(funcInfo, "operator" + opName, p_lexNode->token.line);
 
 			return p_callNativeOp;
 		}
@@ -858,6 +871,17 @@ namespace Tolo
 		return p_call;
 	}
 
+	Expression* Parser::LoadNativeFunctionPtr(const NativeFunctionInfo& info, const std::string& functionName, Int line)
+	{
+		Affirm(
+			info.functionPtr != 0,
+			"native function '%s' at line %i has no dual version",
+			functionName.c_str(), line
+		);
+
+		return new ELoadConstPtr(info.functionPtr);
+	}
+
 	Expression* Parser::ParseNativeFunctionCall(LexNode* p_lexNode)
 	{
 		const std::string& funcName = p_lexNode->token.text;
@@ -871,7 +895,7 @@ namespace Tolo
 		NativeFunctionInfo& info = nativeFunctions[funcName];
 
 		ECallNativeFunction* p_call = new ECallNativeFunction(info.returnTypeName);
-		p_call->functionPtrLoad = new ELoadConstPtr(info.functionPtr);
+		p_call->functionPtrLoad = LoadNativeFunctionPtr(info, funcName, p_lexNode->token.line);
 
 		std::string oldRetType = currentExpectedReturnType;
 		Affirm(
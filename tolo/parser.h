@@ -36,6 +36,7 @@ namespace Tolo
 	{
 		std::string returnTypeName;
 		Ptr functionPtr;
+		Ptr dualFunctionPtr;// the same function on duals, zero when there is none
 		std::vector<std::string> parameterTypeNames;
 
 		NativeFunctionInfo();
@@ -69,6 +70,10 @@ namespace Tolo
 
 		Parser();
 
+		// floats are compiled as Dual, see ProgramHandle::CompileDual, the native function pointers have to
+		// be the dual versions already
+		void UseDualFloats();
+
 		bool HasBody(LexNode* p_lexNode, Int& outBodyStartIndex, Int& outBodyEndIndex);
 
 		void FlattenNode(LexNode* p_lexNode, std::vector<LexNode*>& outNodes);
@@ -111,6 +116,8 @@ namespace Tolo
 
 		Expression* ParseUserFunctionCall(LexNode* p_lexNode);
 
+		Expression* LoadNativeFunctionPtr(const NativeFunctionInfo& info, const std::string& functionName, Int line);
+
 		Expression* ParseNativeFunctionCall(LexNode* p_lexNode);
 
 		Expression* ParseVariableDefinition(LexNode* p_lexNode);
@@ -1,26 +1,37 @@
 #include "program_handle.h"
 #include "tokenizer.h"
 #include "lexer.h"
+#include "time_dependence.h"
 #include "file_io.h"
+#include <atomic>
+#include <cstring>
 
 namespace Tolo
 {
+	static std::atomic<Ptr> nextProgramId(1);
+
 	FunctionHandle::FunctionHandle() :
-		p_function(nullptr)
+		p_function(nullptr),
+		isTimeVarying(false),
+		p_dualFunction(nullptr)
 	{}
 
-	FunctionHandle::FunctionHandle(const std::string& _returnTypeName, const std::string& _functionName, const std::vector<std::string>& _parameterTypeNames, native_func_t _p_function) :
+	FunctionHandle::FunctionHandle(const std::string& _returnTypeName, const std::string& _functionName, const std::vector<std::string>& _parameterTypeNames, native_func_t _p_function, bool _isTimeVarying, native_func_t _p_dualFunction) :
 		p_function(_p_function),
 		returnTypeName(_returnTypeName),
 		functionName(_functionName),
-		parameterTypeNames(_parameterTypeNames)
+		parameterTypeNames(_parameterTypeNames),
+		isTimeVarying(_isTimeVarying),
+		p_dualFunction(_p_dualFunction)
 	{}
 
 	FunctionHandle::FunctionHandle(const FunctionHandle& rhs) :
 		p_function(rhs.p_function),
 		returnTypeName(rhs.returnTypeName),
 		functionName(rhs.functionName),
-		parameterTypeNames(rhs.parameterTypeNames)
+		parameterTypeNames(rhs.parameterTypeNames),
+		isTimeVarying(rhs.isTimeVarying),
+		p_dualFunction(rhs.p_dualFunction)
 	{}
 
 	FunctionHandle& FunctionHandle::operator=(const FunctionHandle& rhs)
@@ -29,6 +40,8 @@ namespace Tolo
 		returnTypeName = rhs.returnTypeName;
 		functionName = rhs.functionName;
 		parameterTypeNames = rhs.parameterTypeNames;
+		isTimeVarying = rhs.isTimeVarying;
+		p_dualFunction = rhs.p_dualFunction;
 		return *this;
 	}
 
@@ -54,12 +67,21 @@ namespace Tolo
 	}
 
 
-	ProgramHandle::ProgramHandle(const std::string& _codePath, Ptr stackSize, const std::string& _mainFunctionName) :
+	ExecutionStack::ExecutionStack() :
+		programId(0)
+	{}
+
+
+	ProgramHandle::ProgramHandle(const std::string& _codePath, Ptr _stackSize, const std::string& _mainFunctionName) :
 		codePath(_codePath),
+		stackSize(_stackSize),
+		programId(0),
 		mainFunctionName(_mainFunctionName),
 		codeStart(0),
 		codeEnd(0),
-		mainReturnValueSize(0)
+		mainReturnValueSize(0),
+		isTimeDependent(false),
+		hasDualFloats(false)
 	{
 		p_stack = (Char*)std::malloc(stackSize);
 
@@ -83,8 +105,12 @@ namespace Tolo
 
 		NativeFunctionInfo& info = nativeFunctions[function.functionName];
 		info.functionPtr = reinterpret_cast<Ptr>(function.p_function);
+		info.dualFunctionPtr = reinterpret_cast<Ptr>(function.p_dualFunction);
 		info.returnTypeName = function.returnTypeName;
 		info.parameterTypeNames = function.parameterTypeNames;
+
+		if (function.isTimeVarying)
+			timeVaryingNatives.insert(function.functionName);
 	}
 
 	void ProgramHandle::AddNativeOperator(const FunctionHandle& function)
@@ -119,10 +145,22 @@ namespace Tolo
 
 		NativeFunctionInfo& info = opFunctions[opName];
 		info.functionPtr = reinterpret_cast<Ptr>(function.p_function);
+		info.dualFunctionPtr = reinterpret_cast<Ptr>(function.p_dualFunction);
 		info.returnTypeName = function.returnTypeName;
 		info.parameterTypeNames = function.parameterTypeNames;
 	}
 
+	void ProgramHandle::PrepareStack(ExecutionStack& stack) const
+	{
+		if (stack.programId == programId)
+			return;
+
+		// the code lives at the bottom of the stack, so a copy of it makes the stack independent
+		stack.memory.resize(stackSize);
+		std::memcpy(stack.memory.data(), p_stack, codeEnd);
+		stack.programId = programId;
+	}
+
 	void ProgramHandle::AddFunction(const FunctionHandle& function)
 	{
 		static std::set<std::string> operators
@@ -167,15 +205,9 @@ namespace Tolo
 		}
 	}
 
-	void ProgramHandle::AddStruct(const StructHandle& _struct)
+	void ProgramHandle::LayOutStruct(const StructHandle& _struct, std::map<std::string, Int>& inoutTypeNameToSize, std::map<std::string, StructInfo>& outTypeNameToStructInfo)
 	{
-		Affirm(
-			typeNameToStructInfo.count(_struct.typeName) == 0,
-			"struct '%s' is already defined",
-			_struct.typeName.c_str()
-		);
-
-		StructInfo& info = typeNameToStructInfo[_struct.typeName];
+		StructInfo& info = outTypeNameToStructInfo[_struct.typeName];
 		
 		Int propertyOffset = 0;
 		for (auto& prop : _struct.properties)
@@ -187,7 +219,7 @@ namespace Tolo
 			);
 
 			Affirm(
-				typeNameToSize.count(prop.first) != 0,
+				inoutTypeNameToSize.count(prop.first) != 0,
 				"type name '%s' in struct '%s' is not defined",
 				prop.first.c_str(), _struct.typeName.c_str()
 			);
@@ -200,13 +232,25 @@ namespace Tolo
 
 			info.propNameToVarInfo[prop.second] = VariableInfo(prop.first, propertyOffset);
 			info.propNames.push_back(prop.second);
-			propertyOffset += typeNameToSize[prop.first];
+			propertyOffset += inoutTypeNameToSize[prop.first];
 		}
 
-		typeNameToSize[_struct.typeName] = propertyOffset;
+		inoutTypeNameToSize[_struct.typeName] = propertyOffset;
 	}
 
-	void ProgramHandle::Compile(std::string& outCode)
+	void ProgramHandle::AddStruct(const StructHandle& _struct)
+	{
+		Affirm(
+			typeNameToStructInfo.count(_struct.typeName) == 0,
+			"struct '%s' is already defined",
+			_struct.typeName.c_str()
+		);
+
+		LayOutStruct(_struct, typeNameToSize, typeNameToStructInfo);
+		structs.push_back(_struct);
+	}
+
+	bool ProgramHandle::Build(std::string& outCode, bool staticPartOnly, bool dualFloats)
 	{
 		ReadTextFile(codePath, outCode);
 
@@ -220,6 +264,34 @@ namespace Tolo
 		std::vector<LexNode*> lexNodes;
 		lexer.Lex(tokens, lexNodes);
 
+		TimeDependence timeDependence;
+		timeDependence.timeVaryingNatives = timeVaryingNatives;
+		for (auto& e : nativeFunctions)
+			timeDependence.nativeParameterTypeNames[e.first] = e.second.parameterTypeNames;
+
+		timeDependence.Analyze(lexNodes);
+		isTimeDependent = timeDependence.timeDependentFunctions.count(mainFunctionName) != 0;
+
+		if (staticPartOnly)
+		{
+			bool hasStaticPart = false;
+			for (auto e : lexNodes)
+			{
+				if (e->type == LexNode::Type::FunctionDefinition && e->children[0]->token.text == mainFunctionName)
+					hasStaticPart = timeDependence.CutStaticPart(e);
+			}
+
+			if (!hasStaticPart)
+			{
+				for (auto e : lexNodes)
+					delete e;
+
+				return false;
+			}
+
+			isTimeDependent = false;
+		}
+
 		Parser parser;
 		parser.nativeFunctions = nativeFunctions;
 		parser.typeNameToStructInfo = typeNameToStructInfo;
@@ -231,6 +303,30 @@ namespace Tolo
 			parser.typeNameToSize[e.first] = typeNameToSize[e.first];
 		}
 
+		// the floats grow, so the structs are laid out again, and the natives are called in their dual versions
+		if (dualFloats)
+		{
+			parser.UseDualFloats();
+
+			std::map<std::string, Int> dualTypeNameToSize = typeNameToSize;
+			dualTypeNameToSize["float"] = sizeof(Dual);
+			parser.typeNameToStructInfo.clear();
+			for (const StructHandle& _struct : structs)
+			{
+				LayOutStruct(_struct, dualTypeNameToSize, parser.typeNameToStructInfo);
+				parser.typeNameToSize[_struct.typeName] = dualTypeNameToSize[_struct.typeName];
+			}
+
+			for (auto& e : parser.nativeFunctions)
+				e.second.functionPtr = e.second.dualFunctionPtr;
+
+			for (auto& typeOperators : parser.typeNameToNativeOpFuncs)
+			{
+				for (auto& e : typeOperators.second)
+					e.second.functionPtr = e.second.dualFunctionPtr;
+			}
+		}
+
 		std::vector<Expression*> expressions;
 		parser.Parse(lexNodes, expressions);
 
@@ -277,6 +373,15 @@ namespace Tolo
 			delete e;
 
 		codeEnd = cb.codeLength;
+		programId = nextProgramId++;
+		hasDualFloats = dualFloats;
+
+		return true;
+	}
+
+	void ProgramHandle::Compile(std::string& outCode)
+	{
+		Build(outCode, false, false);
 	}
 
 	void ProgramHandle::Compile()
@@ -285,6 +390,33 @@ namespace Tolo
 		Compile(outCode);
 	}
 
+	bool ProgramHandle::CompileStaticPart(std::string& outCode)
+	{
+		return Build(outCode, true, false);
+	}
+
+	bool ProgramHandle::CompileStaticPart()
+	{
+		std::string outCode;
+		return CompileStaticPart(outCode);
+	}
+
+	void ProgramHandle::CompileDual(std::string& outCode)
+	{
+		Build(outCode, false, true);
+	}
+
+	void ProgramHandle::CompileDual()
+	{
+		std::string outCode;
+		CompileDual(outCode);
+	}
+
+	bool ProgramHandle::IsTimeDependent() const
+	{
+		return isTimeDependent;
+	}
+
 	const std::string& ProgramHandle::GetCodePath() const
 	{
 		return codePath;
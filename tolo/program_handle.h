@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 
 namespace Tolo
 {
@@ -25,9 +26,11 @@ namespace Tolo
 		std::string returnTypeName;
 		std::string functionName;
 		std::vector<std::string> parameterTypeNames;
+		bool isTimeVarying;// the result changes between calls with the same arguments, like a clock
+		native_func_t p_dualFunction;// the same function with every float a Dual, for ProgramHandle::CompileDual
 
 		FunctionHandle();
-		FunctionHandle(const std::string& _returnTypeName, const std::string& _functionName, const std::vector<std::string>& _parameterTypeNames, native_func_t _p_function);
+		FunctionHandle(const std::string& _returnTypeName, const std::string& _functionName, const std::vector<std::string>& _parameterTypeNames, native_func_t _p_function, bool _isTimeVarying = false, native_func_t _p_dualFunction = nullptr);
 		FunctionHandle(const FunctionHandle& rhs);
 		FunctionHandle& operator=(const FunctionHandle& rhs);
 	};
@@ -43,18 +46,33 @@ namespace Tolo
 		StructHandle& operator=(const StructHandle& rhs);
 	};
 
+	// a private copy of a compiled program and its stack, so several threads can execute the same program
+	struct ExecutionStack
+	{
+		std::vector<Char> memory;
+		Ptr programId;
+
+		ExecutionStack();
+	};
+
 	class ProgramHandle
 	{
 	private:
 		std::string codePath;
 		Char* p_stack;
+		Ptr stackSize;
+		Ptr programId;
 		std::string mainFunctionName;
 		Ptr codeStart;
 		Ptr codeEnd;
 		Int mainReturnValueSize;
+		bool isTimeDependent;
+		bool hasDualFloats;
+		std::set<std::string> timeVaryingNatives;
 		std::map<std::string, Int> typeNameToSize;
 		std::map<std::string, NativeFunctionInfo> nativeFunctions;
 		std::map<std::string, StructInfo> typeNameToStructInfo;
+		std::vector<StructHandle> structs;// in the order they were added, a dual build lays them out again
 		std::map<std::string, std::map<std::string, NativeFunctionInfo>> typeNameToPrimitiveOpFuncs;
 
 		ProgramHandle() = delete;
@@ -65,8 +83,28 @@ namespace Tolo
 
 		void AddNativeOperator(const FunctionHandle& function);
 
+		void PrepareStack(ExecutionStack& stack) const;
+
+		static void LayOutStruct(const StructHandle& _struct, std::map<std::string, Int>& inoutTypeNameToSize, std::map<std::string, StructInfo>& outTypeNameToStructInfo);
+
+		bool Build(std::string& outCode, bool staticPartOnly, bool dualFloats);
+
+		template<typename... ARGUMENTS>
+		void RunOn(Char* p_targetStack, const ARGUMENTS&... arguments) const
+		{
+			Ptr argByteOffset = codeStart;
+			bool writeSuccess = (WriteValue(p_targetStack, argByteOffset, arguments) && ...);
+
+			Affirm(
+				writeSuccess && argByteOffset == 0,
+				"argument list provided to 'main'-function does not match the size of parameter list"
+			);
+
+			RunProgram(p_targetStack, codeStart, codeEnd, hasDualFloats);
+		}
+
 	public:
-		ProgramHandle(const std::string& _codePath, Ptr stackSize, const std::string& _mainFunctionName = "main");
+		ProgramHandle(const std::string& _codePath, Ptr _stackSize, const std::string& _mainFunctionName = "main");
 
 		~ProgramHandle();
 
@@ -78,6 +116,24 @@ namespace Tolo
 
 		void Compile();
 
+		// compiles only the part of the main function that does not depend on time-varying native functions,
+		// see TimeDependence::CutStaticPart, returns false and compiles nothing when the program has no such part
+		// a cache of the program can keep the samples where both versions agree and only refresh the others
+		bool CompileStaticPart(std::string& outCode);
+
+		bool CompileStaticPart();
+
+		// compiles the program with every float carried as a Dual, so one run gives the values and their
+		// gradients with respect to the float arguments of main, which are passed with their own gradient set
+		// to the unit axis they stand for, the calls go to the dual versions of the native functions and a
+		// program calling one that has none fails to compile, the float bit operations are not available
+		void CompileDual(std::string& outCode);
+
+		void CompileDual();
+
+		// whether the compiled main function depends on a time-varying native function
+		bool IsTimeDependent() const;
+
 		template<typename RETURN_TYPE, typename... ARGUMENTS>
 		std::enable_if_t<std::is_same<RETURN_TYPE, void>::value>
 		Execute(const ARGUMENTS&... arguments)
@@ -87,37 +143,51 @@ namespace Tolo
 				"requested return type does not match size of 'main'-function's return type"
 			);
 
-			Ptr argByteOffset = codeStart;
-			bool writeSuccess = (WriteValue(p_stack, argByteOffset, arguments) && ...);
+			RunOn(p_stack, arguments...);
+		}
 
+		template<typename RETURN_TYPE, typename... ARGUMENTS>
+		std::enable_if_t<!std::is_same<RETURN_TYPE, void>::value, RETURN_TYPE>
+		Execute(const ARGUMENTS&... arguments)
+		{
 			Affirm(
-				writeSuccess && argByteOffset == 0,
-				"argument list provided to 'main'-function does not match the size of parameter list"
+				mainReturnValueSize == sizeof(RETURN_TYPE),
+				"requested return type does not match size of 'main'-function's return type"
 			);
 
-			RunProgram(p_stack, codeStart, codeEnd);
+			RunOn(p_stack, arguments...);
+
+			return *(RETURN_TYPE*)(p_stack + codeEnd);
 		}
 
+		// same as Execute but runs on the given stack, which is refreshed if it holds another program
+		// safe to call from several threads at once as long as each thread uses its own stack
 		template<typename RETURN_TYPE, typename... ARGUMENTS>
-		std::enable_if_t<!std::is_same<RETURN_TYPE, void>::value, RETURN_TYPE>
-		Execute(const ARGUMENTS&... arguments)
+		std::enable_if_t<std::is_same<RETURN_TYPE, void>::value>
+		ExecuteOn(ExecutionStack& stack, const ARGUMENTS&... arguments) const
 		{
 			Affirm(
-				mainReturnValueSize == sizeof(RETURN_TYPE),
+				mainReturnValueSize == 0,
 				"requested return type does not match size of 'main'-function's return type"
 			);
 
-			Ptr argByteOffset = codeStart;
-			bool writeSuccess = (WriteValue(p_stack, argByteOffset, arguments) && ...);
+			PrepareStack(stack);
+			RunOn(stack.memory.data(), arguments...);
+		}
 
+		template<typename RETURN_TYPE, typename... ARGUMENTS>
+		std::enable_if_t<!std::is_same<RETURN_TYPE, void>::value, RETURN_TYPE>
+		ExecuteOn(ExecutionStack& stack, const ARGUMENTS&... arguments) const
+		{
 			Affirm(
-				writeSuccess && argByteOffset == 0,
-				"argument list provided to 'main'-function does not match the size of parameter list"
+				mainReturnValueSize == sizeof(RETURN_TYPE),
+				"requested return type does not match size of 'main'-function's return type"
 			);
 
-			RunProgram(p_stack, codeStart, codeEnd);
+			PrepareStack(stack);
+			RunOn(stack.memory.data(), arguments...);
 
-			return *(RETURN_TYPE*)(p_stack + codeEnd);
+			return *(RETURN_TYPE*)(stack.memory.data() + codeEnd);
 		}
 
 		const std::string& GetCodePath() const;
@@ -0,0 +1,270 @@
+#include "time_dependence.h"
+
+namespace Tolo
+{
+	static bool IsFunctionNode(const LexNode* p_node)
+	{
+		return p_node->type == LexNode::Type::FunctionDefinition || p_node->type == LexNode::Type::OperatorDefinition;
+	}
+
+	static std::string FunctionNameOf(const LexNode* p_function)
+	{
+		if (p_function->type == LexNode::Type::OperatorDefinition)
+			return "operator" + p_function->children[0]->token.text;
+
+		return p_function->children[0]->token.text;
+	}
+
+	// the name and the parameter type and name pairs come first, the body follows
+	static size_t BodyStartOf(const LexNode* p_function)
+	{
+		size_t i = 1;
+		while (i < p_function->children.size() && p_function->children[i]->type == LexNode::Type::Identifier)
+			i++;
+
+		return i;
+	}
+
+	static bool ContainsReturn(const LexNode* p_node)
+	{
+		if (p_node->type == LexNode::Type::Return)
+			return true;
+
+		for (auto e : p_node->children)
+		{
+			if (ContainsReturn(e))
+				return true;
+		}
+
+		return false;
+	}
+
+	TimeDependence::TimeDependence() :
+		hasTimeDependentOperator(false)
+	{}
+
+	void TimeDependence::Analyze(const std::vector<LexNode*>& lexNodes)
+	{
+		timeDependentFunctions.clear();
+		timeDependentVariables.clear();
+		hasTimeDependentOperator = false;
+
+		// marks only ever get added, so this ends once a pass over every function adds none
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+
+			for (auto p_function : lexNodes)
+			{
+				if (!IsFunctionNode(p_function))
+					continue;
+
+				const std::string functionName = FunctionNameOf(p_function);
+				std::set<std::string>& variables = timeDependentVariables[functionName];
+				bool returnsTimeDependent = timeDependentFunctions.count(functionName) != 0;
+
+				for (size_t i = BodyStartOf(p_function); i < p_function->children.size(); i++)
+					changed |= AnalyzeStatement(p_function->children[i], variables, false, returnsTimeDependent);
+
+				if (returnsTimeDependent && timeDependentFunctions.insert(functionName).second)
+				{
+					changed = true;
+
+					if (p_function->type == LexNode::Type::OperatorDefinition)
+						hasTimeDependentOperator = true;
+				}
+			}
+		}
+	}
+
+	bool TimeDependence::IsTimeDependent(const LexNode* p_node, const std::set<std::string>& variables) const
+	{
+		switch (p_node->type)
+		{
+		case LexNode::Type::NativeFunctionCall:
+			if (timeVaryingNatives.count(p_node->token.text) != 0)
+				return true;
+			break;
+		case LexNode::Type::UserFunctionCall:
+			if (timeDependentFunctions.count(p_node->token.text) != 0)
+				return true;
+			break;
+		case LexNode::Type::VariableLoad:
+		case LexNode::Type::PropertyLoad:
+			return variables.count(p_node->token.text) != 0;
+		case LexNode::Type::BinaryOperation:
+		case LexNode::Type::UnaryOperation:
+			if (hasTimeDependentOperator)
+				return true;
+			break;
+		default:
+			break;
+		}
+
+		// a call is assumed to depend on all of its arguments
+		for (auto e : p_node->children)
+		{
+			if (IsTimeDependent(e, variables))
+				return true;
+		}
+
+		return false;
+	}
+
+	bool TimeDependence::IsStaticStatement(const LexNode* p_node, const std::set<std::string>& variables) const
+	{
+		switch (p_node->type)
+		{
+		case LexNode::Type::VariableDefinition:
+			return variables.count(p_node->children[0]->token.text) == 0;
+		case LexNode::Type::VariableWrite:
+		case LexNode::Type::PropertyWrite:
+			return variables.count(p_node->token.text) == 0;
+		case LexNode::Type::IfSingle:
+		case LexNode::Type::IfChain:
+		case LexNode::Type::ElseIfSingle:
+		case LexNode::Type::ElseIfChain:
+		case LexNode::Type::While:
+			if (IsTimeDependent(p_node->children[0], variables))
+				return false;
+
+			for (size_t i = 1; i < p_node->children.size(); i++)
+			{
+				if (!IsStaticStatement(p_node->children[i], variables))
+					return false;
+			}
+			return true;
+		case LexNode::Type::Else:
+			for (auto e : p_node->children)
+			{
+				if (!IsStaticStatement(e, variables))
+					return false;
+			}
+			return true;
+		default:
+			break;
+		}
+
+		return !IsTimeDependent(p_node, variables);
+	}
+
+	bool TimeDependence::AnalyzeStatement(const LexNode* p_node, std::set<std::string>& variables, bool isTimeDependentFlow, bool& inoutReturnsTimeDependent)
+	{
+		bool changed = false;
+
+		switch (p_node->type)
+		{
+		case LexNode::Type::VariableDefinition:
+			if (isTimeDependentFlow || IsTimeDependent(p_node->children[1], variables))
+				changed = variables.insert(p_node->children[0]->token.text).second;
+			break;
+		case LexNode::Type::VariableWrite:
+		case LexNode::Type::PropertyWrite:
+			if (isTimeDependentFlow || IsTimeDependent(p_node->children.back(), variables))
+				changed = variables.insert(p_node->token.text).second;
+			break;
+		case LexNode::Type::Return:
+			if (!inoutReturnsTimeDependent && (isTimeDependentFlow || (!p_node->children.empty() && IsTimeDependent(p_node->children[0], variables))))
+			{
+				inoutReturnsTimeDependent = true;
+				changed = true;
+			}
+			break;
+		case LexNode::Type::IfSingle:
+		case LexNode::Type::IfChain:
+		case LexNode::Type::ElseIfSingle:
+		case LexNode::Type::ElseIfChain:
+		case LexNode::Type::While:
+		{
+			// whether the body runs depends on time, so does everything it writes, the else branches included
+			bool isBodyTimeDependent = isTimeDependentFlow || IsTimeDependent(p_node->children[0], variables);
+			for (size_t i = 1; i < p_node->children.size(); i++)
+				changed |= AnalyzeStatement(p_node->children[i], variables, isBodyTimeDependent, inoutReturnsTimeDependent);
+			break;
+		}
+		case LexNode::Type::Else:
+			for (auto e : p_node->children)
+				changed |= AnalyzeStatement(e, variables, isTimeDependentFlow, inoutReturnsTimeDependent);
+			break;
+		default:
+			break;
+		}
+
+		return changed;
+	}
+
+	bool TimeDependence::CutStaticPart(LexNode* p_function) const
+	{
+		const std::string functionName = FunctionNameOf(p_function);
+		if (timeDependentFunctions.count(functionName) == 0)
+			return true;
+
+		static const std::set<std::string> noVariables;
+		auto varIt = timeDependentVariables.find(functionName);
+		const std::set<std::string>& variables = varIt != timeDependentVariables.end() ? varIt->second : noVariables;
+
+		size_t bodyStart = BodyStartOf(p_function);
+		if (bodyStart == p_function->children.size())
+			return false;
+
+		LexNode* p_return = p_function->children.back();
+		if (p_return->type != LexNode::Type::Return || p_return->children.empty())
+			return false;
+
+		for (size_t i = bodyStart; i + 1 < p_function->children.size(); i++)
+		{
+			if (ContainsReturn(p_function->children[i]))
+				return false;
+		}
+
+		LexNode* p_combine = p_return->children[0];
+		while (p_combine->type == LexNode::Type::Parenthesis)
+			p_combine = p_combine->children[0];
+
+		if (p_combine->type != LexNode::Type::NativeFunctionCall)
+			return false;
+
+		auto paramIt = nativeParameterTypeNames.find(p_combine->token.text);
+		if (paramIt == nativeParameterTypeNames.end())
+			return false;
+
+		const std::vector<std::string>& parameterTypeNames = paramIt->second;
+		const std::string& returnTypeName = p_function->token.text;
+
+		size_t staticArgument = p_combine->children.size();
+		for (size_t i = 0; i < p_combine->children.size() && i < parameterTypeNames.size(); i++)
+		{
+			if (parameterTypeNames[i] == returnTypeName && !IsTimeDependent(p_combine->children[i], variables))
+			{
+				staticArgument = i;
+				break;
+			}
+		}
+
+		if (staticArgument == p_combine->children.size())
+			return false;
+
+		// the static statements never read a time dependent variable, so dropping the others leaves valid code
+		std::vector<LexNode*> children(p_function->children.begin(), p_function->children.begin() + bodyStart);
+		for (size_t i = bodyStart; i + 1 < p_function->children.size(); i++)
+		{
+			LexNode* p_statement = p_function->children[i];
+
+			if (IsStaticStatement(p_statement, variables))
+				children.push_back(p_statement);
+			else
+				delete p_statement;
+		}
+
+		LexNode* p_staticValue = p_combine->children[staticArgument];
+		p_combine->children.erase(p_combine->children.begin() + staticArgument);
+		delete p_return->children[0];
+		p_return->children[0] = p_staticValue;
+
+		children.push_back(p_return);
+		p_function->children.swap(children);
+
+		return true;
+	}
+}
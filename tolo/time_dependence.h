@@ -0,0 +1,40 @@
+#pragma once
+#include "lex_node.h"
+#include <set>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Tolo
+{
+	// finds the parts of a program that depend on time-varying native functions, a value depends on time when
+	// it is computed from a time-varying native call, from a user function or operator that depends on time,
+	// from a variable written with such a value or written inside a branch or loop whose condition does
+	// variables are tracked by name for the whole function, so the result is conservative
+	// runs on the lex nodes so the static part of a function can be cut out before parsing
+	struct TimeDependence
+	{
+		std::set<std::string> timeVaryingNatives;
+		std::map<std::string, std::vector<std::string>> nativeParameterTypeNames;
+
+		std::set<std::string> timeDependentFunctions;// user functions whose return value depends on time
+		std::map<std::string, std::set<std::string>> timeDependentVariables;// by user function
+		bool hasTimeDependentOperator;
+
+		TimeDependence();
+
+		void Analyze(const std::vector<LexNode*>& lexNodes);
+
+		bool IsTimeDependent(const LexNode* p_node, const std::set<std::string>& variables) const;
+
+		bool IsStaticStatement(const LexNode* p_node, const std::set<std::string>& variables) const;
+
+		// a statement changes the analysis when it marks a variable or the return value as time dependent
+		bool AnalyzeStatement(const LexNode* p_node, std::set<std::string>& variables, bool isTimeDependentFlow, bool& inoutReturnsTimeDependent);
+
+		// reduces a function that ends in 'return Combine(a, b, ...)' to 'return a', where a is the first static
+		// argument of the native combinator with the function's return type, time dependent statements are
+		// dropped, returns false and leaves the function alone when there is no such argument
+		bool CutStaticPart(LexNode* p_function) const;
+	};
+}
@@ -4,7 +4,7 @@
 
 namespace Tolo
 {
-	void RunProgram(Char* p_stack, Ptr codeStart, Ptr codeEnd)
+	void RunProgram(Char* p_stack, Ptr codeStart, Ptr codeEnd, bool dualFloats)
 	{
 		VirtualMachine vm{ codeEnd, codeStart, 0, p_stack };
 		void(*ops[])(VirtualMachine&)
@@ -80,6 +80,23 @@ namespace Tolo
 			Op_T_Bit_RightShift<Int>
 		};
 
+		// the compiler leaves out the float bit ops of a dual program, so these are all that change
+		if (dualFloats)
+		{
+			ops[size_t(OpCode::Load_Const_Float)] = Op_Load_Const_Dual;
+			ops[size_t(OpCode::Float_Equal)] = Op_T_Equal<Dual>;
+			ops[size_t(OpCode::Float_Less)] = Op_T_Less<Dual>;
+			ops[size_t(OpCode::Float_Greater)] = Op_T_Greater<Dual>;
+			ops[size_t(OpCode::Float_LessOrEqual)] = Op_T_LessOrEqual<Dual>;
+			ops[size_t(OpCode::Float_GreaterOrEqual)] = Op_T_GreaterOrEqual<Dual>;
+			ops[size_t(OpCode::Float_NotEqual)] = Op_T_NotEqual<Dual>;
+			ops[size_t(OpCode::Float_Add)] = Op_TU_Add<Dual, Dual>;
+			ops[size_t(OpCode::Float_Sub)] = Op_TU_Sub<Dual, Dual>;
+			ops[size_t(OpCode::Float_Mul)] = Op_T_Mul<Dual>;
+			ops[size_t(OpCode::Float_Div)] = Op_T_Div<Dual>;
+			ops[size_t(OpCode::Float_Negate)] = Op_T_Negate<Dual>;
+		}
+
 #ifdef DEBUG_VM
 		const char* debugOpNames[]
 		{
@@ -36,6 +36,54 @@ namespace Tolo
 
 	typedef void(*native_func_t)(VirtualMachine&);
 
+	// the float ops of a dual program run these through the same templates, comparisons only look at the value
+	inline Dual operator+(const Dual& a, const Dual& b)
+	{
+		return { a.value + b.value, { a.gradient[0] + b.gradient[0], a.gradient[1] + b.gradient[1], a.gradient[2] + b.gradient[2] } };
+	}
+
+	inline Dual operator-(const Dual& a, const Dual& b)
+	{
+		return { a.value - b.value, { a.gradient[0] - b.gradient[0], a.gradient[1] - b.gradient[1], a.gradient[2] - b.gradient[2] } };
+	}
+
+	inline Dual operator*(const Dual& a, const Dual& b)
+	{
+		return {
+			a.value * b.value,
+			{
+				a.gradient[0] * b.value + b.gradient[0] * a.value,
+				a.gradient[1] * b.value + b.gradient[1] * a.value,
+				a.gradient[2] * b.value + b.gradient[2] * a.value
+			}
+		};
+	}
+
+	inline Dual operator/(const Dual& a, const Dual& b)
+	{
+		Float denominator = b.value * b.value;
+		return {
+			a.value / b.value,
+			{
+				(a.gradient[0] * b.value - b.gradient[0] * a.value) / denominator,
+				(a.gradient[1] * b.value - b.gradient[1] * a.value) / denominator,
+				(a.gradient[2] * b.value - b.gradient[2] * a.value) / denominator
+			}
+		};
+	}
+
+	inline Dual operator-(const Dual& a)
+	{
+		return { -a.value, { -a.gradient[0], -a.gradient[1], -a.gradient[2] } };
+	}
+
+	inline bool operator==(const Dual& a, const Dual& b) { return a.value == b.value; }
+	inline bool operator!=(const Dual& a, const Dual& b) { return a.value != b.value; }
+	inline bool operator<(const Dual& a, const Dual& b) { return a.value < b.value; }
+	inline bool operator>(const Dual& a, const Dual& b) { return a.value > b.value; }
+	inline bool operator<=(const Dual& a, const Dual& b) { return a.value <= b.value; }
+	inline bool operator>=(const Dual& a, const Dual& b) { return a.value >= b.value; }
+
 	template<typename T>
 	void Set(VirtualMachine& vm, Ptr pos, T val)
 	{
@@ -103,6 +151,16 @@ namespace Tolo
 		vm.instructionPtr += sizeof(T);
 	}
 
+	// the code keeps plain float constants in a dual program, they do not depend on the arguments
+	inline void Op_Load_Const_Dual(VirtualMachine& vm)
+	{
+		vm.instructionPtr += sizeof(Char);
+
+		Push<Dual>(vm, { Get<Float>(vm, vm.instructionPtr), { 0.f, 0.f, 0.f } });
+
+		vm.instructionPtr += sizeof(Float);
+	}
+
 	inline void Op_Write_IP(VirtualMachine& vm)
 	{
 		vm.instructionPtr = Pop<Ptr>(vm);
@@ -332,5 +390,6 @@ namespace Tolo
 		vm.instructionPtr += sizeof(Char);
 	}
 
-	void RunProgram(Char* p_stack, Ptr codeStart, Ptr codeEnd);
+	// a dual program runs the float ops on Dual, see ProgramHandle::CompileDual
+	void RunProgram(Char* p_stack, Ptr codeStart, Ptr codeEnd, bool dualFloats = false);
 }
\ No newline at end of file